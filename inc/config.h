@@ -0,0 +1,144 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdbool.h>
+#include "extract.h"
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! scheduling priority class of an exec command */
+typedef enum priorityClass
+{
+    /*! bulk work which may wait behind all other work */
+    PRIORITY_LOW,
+
+    /*! default priority class */
+    PRIORITY_NORMAL,
+
+    /*! latency sensitive work, such as health checks */
+    PRIORITY_HIGH,
+
+    /*! number of priority classes */
+    PRIORITY_CLASSES
+
+} PriorityClass;
+
+/*! definition of a variable rendered by an exec command */
+typedef struct varDef
+{
+    /*! name of the variable */
+    const char *pName;
+
+    /*! rule which extracts the variable value from the command output */
+    ExtractDef extract;
+
+} VarDef;
+
+/*! definition of an exec command */
+typedef struct execDef
+{
+    /*! command sequence, or NULL for a group */
+    const char *pCmd;
+
+    /*! pre-tokenized argument vector used to execute the command without
+        a shell, or NULL if the command requires a shell */
+    char * const *ppArgv;
+
+    /*! name prefix of the members of a group, or NULL if the
+        definition is a command */
+    const char *pGroup;
+
+    /*! network interface which refreshes the output, or NULL */
+    const char *pNetIf;
+
+    /*! time to live of the cached output in seconds, or 0 */
+    int ttl;
+
+    /*! scheduling priority class of the command and its variables */
+    PriorityClass priority;
+
+    /*! true to hedge slow executions of the command with a second
+        execution */
+    bool hedge;
+
+    /*! number of times a transiently failed execution is retried */
+    int retries;
+
+    /*! delay in milliseconds before the first retry, or 0 for the
+        default.  The delay doubles for every further retry */
+    int retryDelay;
+
+    /*! time in milliseconds from the first execution after which no
+        further retries are started, or 0 for the default */
+    int retryBudget;
+
+    /*! maximum number of bytes of output kept from an execution, or 0
+        for the default */
+    int maxOutput;
+
+    /*! true to kill an execution which exceeds its maximum output size,
+        false to truncate its output */
+    bool killOnOverflow;
+
+    /*! files the output depends on */
+    const char * const *ppDepends;
+
+    /*! number of files the output depends on */
+    int nDepends;
+
+    /*! variables rendered by the command */
+    const VarDef *pVars;
+
+    /*! number of variables rendered by the command */
+    int nVars;
+
+} ExecDef;
+
+/*! opaque handle to a loaded configuration image */
+typedef struct configImage ConfigImage;
+
+/*! callback invoked for each exec command definition in an image */
+typedef int (*ConfigCallback)( const ExecDef *pDef, void *arg );
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+ConfigImage *CONFIG_Load( const char *filename );
+int CONFIG_LoadAll( char * const *ppFileNames, ConfigImage **ppImages, int n );
+int CONFIG_Iterate( ConfigImage *pImage, ConfigCallback cb, void *arg );
+int CONFIG_GetCounts( ConfigImage *pImage, size_t *pCmds, size_t *pVars );
+int CONFIG_Compile( const char *infile, const char *outfile );
+void CONFIG_Release( ConfigImage *pImage );
+
+#endif
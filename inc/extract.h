@@ -0,0 +1,121 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stddef.h>
+#include <regex.h>
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! type of extraction rule */
+typedef enum extractType
+{
+    /*! no extraction, the full output is used */
+    EXTRACT_NONE,
+
+    /*! extract a capture group of a regular expression */
+    EXTRACT_REGEX,
+
+    /*! extract a line, or a field within a line */
+    EXTRACT_LINE,
+
+    /*! extract the value of a key=value pair */
+    EXTRACT_KEY
+
+} ExtractType;
+
+/*! definition of an extraction rule, as read from the configuration */
+typedef struct extractDef
+{
+    /*! type of extraction */
+    ExtractType type;
+
+    /*! regular expression for EXTRACT_REGEX */
+    const char *pPattern;
+
+    /*! capture group for EXTRACT_REGEX, or -1 for the default group */
+    int group;
+
+    /*! one-based line number for EXTRACT_LINE */
+    int line;
+
+    /*! one-based field number for EXTRACT_LINE, or 0 for the whole line */
+    int field;
+
+    /*! key name for EXTRACT_KEY */
+    const char *pKey;
+
+    /*! separator for EXTRACT_LINE or EXTRACT_KEY, or NULL for the default */
+    const char *pSeparator;
+
+} ExtractDef;
+
+/*! rule which extracts a value from command output */
+typedef struct extractRule
+{
+    /*! type of extraction */
+    ExtractType type;
+
+    /*! compiled regular expression for EXTRACT_REGEX */
+    regex_t regex;
+
+    /*! capture group to extract for EXTRACT_REGEX */
+    int group;
+
+    /*! one-based line number for EXTRACT_LINE */
+    int line;
+
+    /*! one-based field number for EXTRACT_LINE, or 0 for the whole line */
+    int field;
+
+    /*! key name for EXTRACT_KEY */
+    char *pKey;
+
+    /*! field separator characters for EXTRACT_LINE (NULL for whitespace),
+        or the key/value separator for EXTRACT_KEY (NULL for "=") */
+    char *pSeparator;
+
+} ExtractRule;
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+ExtractRule *EXTRACT_Create( const ExtractDef *pDef );
+int EXTRACT_Apply( ExtractRule *pRule,
+                   const char *pData,
+                   size_t len,
+                   const char **ppValue,
+                   size_t *pValueLen );
+void EXTRACT_Free( ExtractRule *pRule );
+
+#endif
@@ -0,0 +1,64 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef SHMCACHE_H
+#define SHMCACHE_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! maximum number of bytes of output held by a shared cache entry */
+#define SHMCACHE_VALUE_SIZE 4056
+
+/*! opaque handle to a shared memory result cache */
+typedef struct shmCache ShmCache;
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+ShmCache *SHMCACHE_Open( const char *name, uint32_t nEntries );
+void SHMCACHE_Close( ShmCache *pCache );
+int SHMCACHE_Get( ShmCache *pCache,
+                  uint64_t key,
+                  char *buf,
+                  size_t *pLen,
+                  uint64_t *pExpires_ms );
+int SHMCACHE_Claim( ShmCache *pCache, uint64_t key, uint64_t lease_ms );
+void SHMCACHE_Release( ShmCache *pCache, uint64_t key );
+int SHMCACHE_Put( ShmCache *pCache,
+                  uint64_t key,
+                  const char *pData,
+                  size_t len,
+                  uint64_t expires_ms );
+
+#endif
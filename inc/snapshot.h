@@ -0,0 +1,74 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! cached command output held in a snapshot */
+typedef struct snapshotEntry
+{
+    /*! key identifying the command */
+    uint64_t key;
+
+    /*! time to live of the command's output in milliseconds */
+    uint64_t ttl_ms;
+
+    /*! monotonic time in milliseconds at which the output expires */
+    uint64_t expires_ms;
+
+    /*! pointer to the command output */
+    const char *pData;
+
+    /*! number of bytes of command output */
+    size_t len;
+
+} SnapshotEntry;
+
+/*! opaque handle to a snapshot being written */
+typedef struct snapshot Snapshot;
+
+/*! function called for each unexpired entry of a snapshot being loaded */
+typedef int (*SnapshotFn)( const SnapshotEntry *pEntry, void *arg );
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+Snapshot *SNAPSHOT_Create( const char *pFileName );
+int SNAPSHOT_Add( Snapshot *pSnapshot, const SnapshotEntry *pEntry );
+int SNAPSHOT_Commit( Snapshot *pSnapshot );
+int SNAPSHOT_Load( const char *pFileName, SnapshotFn fn, void *arg );
+
+#endif
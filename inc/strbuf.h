@@ -0,0 +1,62 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef STRBUF_H
+#define STRBUF_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! growable string */
+typedef struct stringBuffer
+{
+    /*! pointer to the string data */
+    char *pData;
+
+    /*! number of bytes used */
+    size_t len;
+
+    /*! allocated size of the string data */
+    size_t size;
+
+    /*! true if memory could not be allocated */
+    bool error;
+
+} StringBuffer;
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+void STRBUF_Append( StringBuffer *pBuf, const char *pData, size_t len );
+
+#endif
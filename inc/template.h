@@ -0,0 +1,55 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdbool.h>
+
+/*============================================================================
+        Public definitions
+============================================================================*/
+
+/*! maximum number of parameters in a template */
+#define TEMPLATE_MAX_PARAMS 8
+
+/*! opaque handle to a compiled execvar template */
+typedef struct template Template;
+
+/*============================================================================
+        Public function declarations
+============================================================================*/
+
+bool TEMPLATE_IsTemplate( const char *name );
+Template *TEMPLATE_Create( const char *pVarPattern, const char *pCmdPattern );
+const char *TEMPLATE_GetPrefix( Template *pTemplate );
+bool TEMPLATE_Match( Template *pTemplate, const char *varname );
+char *TEMPLATE_Expand( Template *pTemplate, const char *varname );
+void TEMPLATE_Free( Template *pTemplate );
+
+#endif
@@ -0,0 +1,1746 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup config config
+ * @brief Execvars configuration images
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file config.c
+
+    Configuration Images
+
+    The config module loads the execvars configuration into a flat,
+    relocatable configuration image, and presents each exec command
+    definition in the image to the caller.
+
+    A configuration image consists of a header followed by a command
+    table, a variable table, a reference table, and a string table.
+    Records refer to strings by their offset in the string table, and
+    to lists of strings (file dependencies and pre-tokenized argument
+    vectors) by their index in the reference table, so an image can be
+    written to a file and memory mapped read-only without relocation.
+    Identical strings are stored once.
+
+    Several configuration files (such as the fragments of a conf.d
+    directory) can be loaded in parallel with CONFIG_LoadAll.
+
+    A JSON configuration file is converted into an image in memory
+    when it is loaded, and the JSON document is released immediately.
+    An image can also be compiled into a binary configuration file
+    with CONFIG_Compile, which is memory mapped when it is loaded so
+    the configuration is shared with the page cache rather than copied
+    onto the heap.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include <tjson/json.h>
+#include "config.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! configuration image magic number ("EXVB") */
+#define IMAGE_MAGIC 0x42565845
+
+/*! configuration image format version */
+#define IMAGE_VERSION 6
+
+/*! number of buckets in the string intern table used while building */
+#define STRING_TABLE_SIZE 4096
+
+/*! maximum number of threads used to load configuration files */
+#define MAX_LOAD_THREADS 16
+
+/*! characters which require a command to be run by the shell */
+#define SHELL_CHARS "|&;<>()$`\\\"'*?[]#~=!{}\n"
+
+/*! configuration image header */
+typedef struct imageHeader
+{
+    /*! magic number identifying the image (and its byte order) */
+    uint32_t magic;
+
+    /*! image format version */
+    uint32_t version;
+
+    /*! total size of the image in bytes */
+    uint32_t size;
+
+    /*! number of command records */
+    uint32_t nCmds;
+
+    /*! offset of the command table */
+    uint32_t cmdOffset;
+
+    /*! number of variable records */
+    uint32_t nVars;
+
+    /*! offset of the variable table */
+    uint32_t varOffset;
+
+    /*! number of references */
+    uint32_t nRefs;
+
+    /*! offset of the reference table */
+    uint32_t refOffset;
+
+    /*! size of the string table in bytes */
+    uint32_t strSize;
+
+    /*! offset of the string table */
+    uint32_t strOffset;
+
+} ImageHeader;
+
+/*! exec command record.  String fields are string table offsets,
+    where offset 0 is the empty string used to indicate no value */
+typedef struct cmdRecord
+{
+    /*! command sequence */
+    uint32_t cmd;
+
+    /*! network interface */
+    uint32_t netif;
+
+    /*! time to live in seconds */
+    int32_t ttl;
+
+    /*! index of the first file dependency in the reference table */
+    uint32_t depends;
+
+    /*! number of file dependencies */
+    uint32_t nDepends;
+
+    /*! index of the NULL terminated argument vector in the reference table */
+    uint32_t argv;
+
+    /*! number of arguments, or 0 if the command requires a shell */
+    uint32_t argc;
+
+    /*! index of the first variable record */
+    uint32_t vars;
+
+    /*! number of variable records */
+    uint32_t nVars;
+
+    /*! name prefix of the members of a group, or 0 for a command */
+    uint32_t group;
+
+    /*! scheduling priority class */
+    int32_t priority;
+
+    /*! 1 to hedge slow executions, 0 otherwise */
+    uint32_t hedge;
+
+    /*! number of retries of a transiently failed execution */
+    int32_t retries;
+
+    /*! delay in milliseconds before the first retry, or 0 */
+    int32_t retryDelay;
+
+    /*! retry deadline in milliseconds, or 0 */
+    int32_t retryBudget;
+
+    /*! maximum output size in bytes, or 0 */
+    int32_t maxOutput;
+
+    /*! 1 to kill an execution which exceeds the maximum output size,
+        0 to truncate its output */
+    uint32_t killOnOverflow;
+
+} CmdRecord;
+
+/*! variable record */
+typedef struct varRecord
+{
+    /*! variable name */
+    uint32_t name;
+
+    /*! extraction rule type */
+    int32_t type;
+
+    /*! regular expression capture group */
+    int32_t group;
+
+    /*! line number */
+    int32_t line;
+
+    /*! field number */
+    int32_t field;
+
+    /*! regular expression */
+    uint32_t pattern;
+
+    /*! key name */
+    uint32_t key;
+
+    /*! separator */
+    uint32_t separator;
+
+} VarRecord;
+
+/*! loaded configuration image */
+struct configImage
+{
+    /*! pointer to the start of the image */
+    uint8_t *pBase;
+
+    /*! size of the image in bytes */
+    size_t size;
+
+    /*! true if the image is memory mapped, false if heap allocated */
+    bool mapped;
+
+    /*! pointer to the image header */
+    const ImageHeader *pHeader;
+
+    /*! pointer to the command table */
+    const CmdRecord *pCmds;
+
+    /*! pointer to the variable table */
+    const VarRecord *pVars;
+
+    /*! pointer to the string table */
+    const char *pStrings;
+
+    /*! reference table resolved to string pointers */
+    char **ppRefs;
+
+    /*! largest number of variables rendered by one command */
+    uint32_t maxVars;
+};
+
+/*! growable byte buffer */
+typedef struct byteBuffer
+{
+    /*! pointer to the buffer data */
+    uint8_t *pData;
+
+    /*! number of bytes used */
+    size_t len;
+
+    /*! allocated size of the buffer */
+    size_t size;
+
+} ByteBuffer;
+
+/*! interned string */
+typedef struct stringEntry
+{
+    /*! hash of the string */
+    uint32_t hash;
+
+    /*! offset of the string in the string table */
+    uint32_t offset;
+
+    /*! pointer to the next string in the same bucket */
+    struct stringEntry *pNext;
+
+} StringEntry;
+
+/*! state used while building a configuration image */
+typedef struct imageBuilder
+{
+    /*! string table */
+    ByteBuffer strings;
+
+    /*! command table */
+    ByteBuffer cmds;
+
+    /*! variable table */
+    ByteBuffer vars;
+
+    /*! reference table */
+    ByteBuffer refs;
+
+    /*! string intern table */
+    StringEntry *stringTable[STRING_TABLE_SIZE];
+
+    /*! true if memory could not be allocated */
+    bool error;
+
+} ImageBuilder;
+
+/*! work shared by the threads loading several configuration files */
+typedef struct loadJob
+{
+    /*! array of configuration file names */
+    char * const *ppFileNames;
+
+    /*! array to store the loaded configuration images in */
+    ConfigImage **ppImages;
+
+    /*! number of configuration files */
+    int n;
+
+    /*! index of the next configuration file to load */
+    int next;
+
+    /*! mutex protecting the next index */
+    pthread_mutex_t mutex;
+
+} LoadJob;
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static void *LoadThread( void *arg );
+static uint8_t *BuildImage( const char *filename, size_t *pSize );
+static int BuildCommand( JNode *pNode, void *arg );
+static int BuildDependency( JNode *pNode, void *arg );
+static int BuildOutput( JNode *pNode, void *arg );
+static int BuildVar( ImageBuilder *pBuilder, char *name, JNode *pRule );
+static int ParsePriority( const char *name, int32_t *pPriority );
+static void BuildArgv( ImageBuilder *pBuilder, const char *cmd, CmdRecord *pRec );
+static uint32_t AddString( ImageBuilder *pBuilder, const char *str );
+static void AddRef( ImageBuilder *pBuilder, uint32_t offset );
+static void Append( ImageBuilder *pBuilder,
+                    ByteBuffer *pBuf,
+                    const void *pData,
+                    size_t len );
+static uint8_t *FinishImage( ImageBuilder *pBuilder, size_t *pSize );
+static void FreeBuilder( ImageBuilder *pBuilder );
+static ConfigImage *OpenImage( uint8_t *pBase, size_t size, bool mapped );
+static int ValidateImage( ConfigImage *pImage );
+static bool ValidTable( size_t size, uint32_t offset, uint32_t n, size_t recsize );
+static const char *GetString( ConfigImage *pImage, uint32_t offset );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  CONFIG_Load                                                             */
+/*!
+    Load a configuration image
+
+    The CONFIG_Load function loads an execvars configuration file.  A
+    compiled binary configuration file is memory mapped read-only.  A
+    JSON configuration file is parsed and converted into an image in
+    memory, and the JSON document is freed.  In both cases the image
+    is validated before it is returned.
+
+    @param[in]
+        filename
+            pointer to the NUL terminated configuration file name
+
+    @retval pointer to the loaded configuration image
+    @retval NULL - the configuration could not be loaded
+
+============================================================================*/
+ConfigImage *CONFIG_Load( const char *filename )
+{
+    ConfigImage *pImage = NULL;
+    struct stat sb;
+    uint8_t *pBase;
+    size_t size;
+    uint32_t magic = 0;
+    int fd;
+
+    if( filename == NULL )
+    {
+        return NULL;
+    }
+
+    fd = open( filename, O_RDONLY | O_CLOEXEC );
+    if( fd == -1 )
+    {
+        syslog( LOG_ERR, "Unable to open %s: %s\n", filename, strerror( errno ) );
+        return NULL;
+    }
+
+    if( ( fstat( fd, &sb ) == 0 ) &&
+        ( (size_t)sb.st_size >= sizeof( ImageHeader ) ) &&
+        ( read( fd, &magic, sizeof( magic ) ) == sizeof( magic ) ) &&
+        ( magic == IMAGE_MAGIC ) )
+    {
+        /* compiled configuration: map it read-only */
+        pBase = mmap( NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( pBase != MAP_FAILED )
+        {
+            pImage = OpenImage( pBase, sb.st_size, true );
+        }
+    }
+    else
+    {
+        /* JSON configuration: convert it into an image */
+        pBase = BuildImage( filename, &size );
+        if( pBase != NULL )
+        {
+            pImage = OpenImage( pBase, size, false );
+        }
+    }
+
+    close( fd );
+
+    if( pImage == NULL )
+    {
+        syslog( LOG_ERR, "Invalid configuration %s\n", filename );
+    }
+
+    return pImage;
+}
+
+/*==========================================================================*/
+/*  CONFIG_LoadAll                                                          */
+/*!
+    Load several configuration images in parallel
+
+    The CONFIG_LoadAll function loads a set of configuration files using
+    one thread per online CPU (up to MAX_LOAD_THREADS), so the JSON
+    parsing of many configuration fragments is spread across cores.
+    If threads cannot be created, the remaining files are loaded by the
+    calling thread.
+
+    @param[in]
+        ppFileNames
+            array of pointers to the NUL terminated configuration file names
+
+    @param[out]
+        ppImages
+            array to store the loaded configuration images in.  An entry
+            is set to NULL if its configuration could not be loaded.
+
+    @param[in]
+        n
+            number of configuration files
+
+    @retval EOK - all configuration files were loaded
+    @retval EINVAL - invalid arguments, or a configuration file could
+                     not be loaded
+
+============================================================================*/
+int CONFIG_LoadAll( char * const *ppFileNames, ConfigImage **ppImages, int n )
+{
+    pthread_t threads[MAX_LOAD_THREADS];
+    LoadJob job;
+    long ncpu;
+    int nthreads = 0;
+    int result = EOK;
+    int i;
+
+    if( ( ppFileNames == NULL ) ||
+        ( ppImages == NULL ) ||
+        ( n < 0 ) )
+    {
+        return EINVAL;
+    }
+
+    job.ppFileNames = ppFileNames;
+    job.ppImages = ppImages;
+    job.n = n;
+    job.next = 0;
+    pthread_mutex_init( &job.mutex, NULL );
+
+    ncpu = sysconf( _SC_NPROCESSORS_ONLN );
+    while( ( nthreads < ncpu - 1 ) &&
+           ( nthreads < n - 1 ) &&
+           ( nthreads < MAX_LOAD_THREADS ) &&
+           ( pthread_create( &threads[nthreads],
+                             NULL,
+                             LoadThread,
+                             &job ) == 0 ) )
+    {
+        nthreads++;
+    }
+
+    /* the calling thread loads configuration files too */
+    LoadThread( &job );
+
+    for( i = 0; i < nthreads; i++ )
+    {
+        pthread_join( threads[i], NULL );
+    }
+
+    pthread_mutex_destroy( &job.mutex );
+
+    for( i = 0; i < n; i++ )
+    {
+        if( ppImages[i] == NULL )
+        {
+            result = EINVAL;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  CONFIG_Iterate                                                          */
+/*!
+    Iterate through the exec command definitions of an image
+
+    The CONFIG_Iterate function invokes a callback for every exec command
+    definition in a configuration image.  The strings referenced by the
+    definition remain valid until the image is released.
+
+    @param[in]
+        pImage
+            pointer to the configuration image
+
+    @param[in]
+        cb
+            callback to invoke for each exec command definition
+
+    @param[in]
+        arg
+            opaque argument passed to the callback
+
+    @retval EOK - all definitions were visited
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+int CONFIG_Iterate( ConfigImage *pImage, ConfigCallback cb, void *arg )
+{
+    int result = EINVAL;
+    const CmdRecord *pRec;
+    const VarRecord *pVarRec;
+    VarDef *pVars;
+    ExecDef def;
+    uint32_t i;
+    uint32_t j;
+
+    if( ( pImage != NULL ) &&
+        ( cb != NULL ) )
+    {
+        result = ENOMEM;
+
+        pVars = calloc( pImage->maxVars + 1, sizeof( VarDef ) );
+        if( pVars != NULL )
+        {
+            for( i = 0; i < pImage->pHeader->nCmds; i++ )
+            {
+                pRec = &pImage->pCmds[i];
+
+                def.pCmd = GetString( pImage, pRec->cmd );
+                def.ppArgv = ( pRec->argc > 0 ) ? &pImage->ppRefs[pRec->argv]
+                                                : NULL;
+                def.pNetIf = GetString( pImage, pRec->netif );
+                def.pGroup = GetString( pImage, pRec->group );
+                def.ttl = pRec->ttl;
+                def.priority = pRec->priority;
+                def.hedge = ( pRec->hedge != 0 );
+                def.retries = pRec->retries;
+                def.retryDelay = pRec->retryDelay;
+                def.retryBudget = pRec->retryBudget;
+                def.maxOutput = pRec->maxOutput;
+                def.killOnOverflow = ( pRec->killOnOverflow != 0 );
+                def.ppDepends = (const char * const *)&pImage->ppRefs[pRec->depends];
+                def.nDepends = pRec->nDepends;
+                def.pVars = pVars;
+                def.nVars = pRec->nVars;
+
+                for( j = 0; j < pRec->nVars; j++ )
+                {
+                    pVarRec = &pImage->pVars[pRec->vars + j];
+
+                    pVars[j].pName = GetString( pImage, pVarRec->name );
+                    pVars[j].extract.type = pVarRec->type;
+                    pVars[j].extract.pPattern = GetString( pImage, pVarRec->pattern );
+                    pVars[j].extract.group = pVarRec->group;
+                    pVars[j].extract.line = pVarRec->line;
+                    pVars[j].extract.field = pVarRec->field;
+                    pVars[j].extract.pKey = GetString( pImage, pVarRec->key );
+                    pVars[j].extract.pSeparator = GetString( pImage, pVarRec->separator );
+                }
+
+                cb( &def, arg );
+            }
+
+            free( pVars );
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  CONFIG_GetCounts                                                        */
+/*!
+    Get the number of definitions in an image
+
+    The CONFIG_GetCounts function gets the number of exec command and
+    variable definitions in a configuration image, so the registry can
+    be sized before the definitions are iterated.
+
+    @param[in]
+        pImage
+            pointer to the configuration image
+
+    @param[out]
+        pCmds
+            location to store the number of exec command definitions
+
+    @param[out]
+        pVars
+            location to store the number of variable definitions
+
+    @retval EOK - the counts were retrieved
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int CONFIG_GetCounts( ConfigImage *pImage, size_t *pCmds, size_t *pVars )
+{
+    int result = EINVAL;
+
+    if( ( pImage != NULL ) &&
+        ( pCmds != NULL ) &&
+        ( pVars != NULL ) )
+    {
+        *pCmds = pImage->pHeader->nCmds;
+        *pVars = pImage->pHeader->nVars;
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  CONFIG_Compile                                                          */
+/*!
+    Compile a JSON configuration into a binary configuration file
+
+    The CONFIG_Compile function converts a JSON configuration file into
+    a configuration image, and writes it to the output file.  The image
+    is written to a temporary file which is renamed over the output file,
+    so a running execvars service never maps a partially written image.
+
+    @param[in]
+        infile
+            pointer to the NUL terminated JSON configuration file name
+
+    @param[in]
+        outfile
+            pointer to the NUL terminated output file name
+
+    @retval EOK - the configuration was compiled
+    @retval EINVAL - invalid arguments or invalid configuration
+    @retval other - error writing the output file
+
+============================================================================*/
+int CONFIG_Compile( const char *infile, const char *outfile )
+{
+    int result = EINVAL;
+    uint8_t *pImage;
+    size_t size;
+    char tmpfile[PATH_MAX];
+    FILE *fp;
+
+    if( ( infile != NULL ) &&
+        ( outfile != NULL ) )
+    {
+        pImage = BuildImage( infile, &size );
+        if( ( pImage != NULL ) &&
+            ( (size_t)snprintf( tmpfile,
+                                sizeof( tmpfile ),
+                                "%s.tmp",
+                                outfile ) < sizeof( tmpfile ) ) )
+        {
+            result = EOK;
+
+            fp = fopen( tmpfile, "wb" );
+            if( ( fp == NULL ) ||
+                ( fwrite( pImage, 1, size, fp ) != size ) )
+            {
+                result = errno;
+            }
+
+            if( ( fp != NULL ) &&
+                ( fclose( fp ) != 0 ) &&
+                ( result == EOK ) )
+            {
+                result = errno;
+            }
+
+            if( ( result == EOK ) &&
+                ( rename( tmpfile, outfile ) != 0 ) )
+            {
+                result = errno;
+            }
+
+            if( result != EOK )
+            {
+                unlink( tmpfile );
+            }
+        }
+
+        free( pImage );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  CONFIG_Release                                                          */
+/*!
+    Release a configuration image
+
+    The CONFIG_Release function unmaps or frees a configuration image.
+    The strings of its definitions must no longer be referenced.
+
+    @param[in]
+        pImage
+            pointer to the configuration image to release
+
+    @return none
+
+============================================================================*/
+void CONFIG_Release( ConfigImage *pImage )
+{
+    if( pImage != NULL )
+    {
+        if( pImage->mapped == true )
+        {
+            munmap( pImage->pBase, pImage->size );
+        }
+        else
+        {
+            free( pImage->pBase );
+        }
+
+        free( pImage->ppRefs );
+        free( pImage );
+    }
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  LoadThread                                                              */
+/*!
+    Load configuration files
+
+    The LoadThread function loads configuration files from a shared
+    load job until there are none left.
+
+    @param[in]
+        arg
+            opaque pointer argument used for the LoadJob object
+
+    @retval NULL
+
+============================================================================*/
+static void *LoadThread( void *arg )
+{
+    LoadJob *pJob = (LoadJob *)arg;
+    int idx;
+
+    while( 1 )
+    {
+        pthread_mutex_lock( &pJob->mutex );
+        idx = pJob->next++;
+        pthread_mutex_unlock( &pJob->mutex );
+
+        if( idx >= pJob->n )
+        {
+            break;
+        }
+
+        pJob->ppImages[idx] = CONFIG_Load( pJob->ppFileNames[idx] );
+    }
+
+    return NULL;
+}
+
+/*==========================================================================*/
+/*  BuildImage                                                              */
+/*!
+    Build a configuration image from a JSON configuration file
+
+    The BuildImage function parses a JSON configuration file and converts
+    its "commands" array into a configuration image.  Invalid definitions
+    are logged and skipped.  The JSON document is freed before returning.
+
+    @param[in]
+        filename
+            pointer to the NUL terminated JSON configuration file name
+
+    @param[out]
+        pSize
+            location to store the size of the image
+
+    @retval pointer to the dynamically allocated image
+    @retval NULL - the configuration could not be converted
+
+============================================================================*/
+static uint8_t *BuildImage( const char *filename, size_t *pSize )
+{
+    uint8_t *pImage = NULL;
+    ImageBuilder *pBuilder;
+    JNode *config;
+    JArray *cmds;
+
+    config = JSON_Process( (char *)filename );
+    cmds = (JArray *)JSON_Find( config, "commands" );
+    if( cmds != NULL )
+    {
+        pBuilder = calloc( 1, sizeof( ImageBuilder ) );
+        if( pBuilder != NULL )
+        {
+            /* offset 0 of the string table is the empty string */
+            Append( pBuilder, &pBuilder->strings, "", 1 );
+
+            JSON_Iterate( cmds, BuildCommand, (void *)pBuilder );
+
+            pImage = FinishImage( pBuilder, pSize );
+            FreeBuilder( pBuilder );
+        }
+    }
+
+    if( config != NULL )
+    {
+        JSON_Free( config );
+    }
+
+    return pImage;
+}
+
+/*==========================================================================*/
+/*  BuildCommand                                                            */
+/*!
+    Add an exec command definition to a configuration image
+
+    The BuildCommand function is a callback function for the JSON_Iterate
+    function which converts one exec command definition object into a
+    command record and its variable records.  The object is expected
+    to look as follows:
+
+    { "var": "varname",
+      "exec": "<command sequence>",
+      "depends_on": [ "<file>", ... ],
+      "netlink": "<interface name>",
+      "ttl": <seconds>,
+      "priority": "high" | "normal" | "low",
+      "hedge": true | false,
+      "retries": <count>,
+      "retry_delay_ms": <milliseconds>,
+      "retry_budget_ms": <milliseconds>,
+      "max_output_bytes": <bytes>,
+      "overflow": "truncate" | "kill",
+      "extract": { <rule> },
+      "outputs": [ { "var": "varname", "extract": { <rule> } }, ... ] }
+
+    A group is defined with a "group" name prefix instead of "exec":
+
+    { "var": "varname", "group": "<variable name prefix>" }
+
+    @param[in]
+       pNode
+            pointer to the exec command definition node
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ImageBuilder object
+
+    @retval EOK - the definition was added
+    @retval EINVAL - the definition is invalid
+
+============================================================================*/
+static int BuildCommand( JNode *pNode, void *arg )
+{
+    ImageBuilder *pBuilder = (ImageBuilder *)arg;
+    CmdRecord rec;
+    JArray *pDepends;
+    JArray *pOutputs;
+    char *varname;
+    char *cmd;
+    char *group;
+    char *overflow;
+    int ttl;
+    int n;
+    bool hedge;
+    int result = EINVAL;
+
+    cmd = JSON_GetStr( pNode, "exec" );
+    group = JSON_GetStr( pNode, "group" );
+    varname = JSON_GetStr( pNode, "var" );
+    pOutputs = (JArray *)JSON_Find( pNode, "outputs" );
+
+    memset( &rec, 0, sizeof( rec ) );
+
+    if( ( ( cmd != NULL ) || ( group != NULL ) ) &&
+        ( ( varname != NULL ) || ( pOutputs != NULL ) ) &&
+        ( ParsePriority( JSON_GetStr( pNode, "priority" ),
+                         &rec.priority ) == EOK ) )
+    {
+        rec.cmd = AddString( pBuilder, cmd );
+        rec.group = AddString( pBuilder, group );
+        rec.netif = AddString( pBuilder, JSON_GetStr( pNode, "netlink" ) );
+        if( JSON_GetNum( pNode, "ttl", &ttl ) == EOK )
+        {
+            rec.ttl = ttl;
+        }
+
+        if( ( JSON_GetBool( pNode, "hedge", &hedge ) == EOK ) &&
+            ( hedge == true ) )
+        {
+            rec.hedge = 1;
+        }
+
+        /* set up the retry policy for transient failures */
+        if( ( JSON_GetNum( pNode, "retries", &n ) == EOK ) && ( n > 0 ) )
+        {
+            rec.retries = n;
+        }
+
+        if( ( JSON_GetNum( pNode, "retry_delay_ms", &n ) == EOK ) &&
+            ( n > 0 ) )
+        {
+            rec.retryDelay = n;
+        }
+
+        if( ( JSON_GetNum( pNode, "retry_budget_ms", &n ) == EOK ) &&
+            ( n > 0 ) )
+        {
+            rec.retryBudget = n;
+        }
+
+        /* set up the output size limit */
+        if( ( JSON_GetNum( pNode, "max_output_bytes", &n ) == EOK ) &&
+            ( n > 0 ) )
+        {
+            rec.maxOutput = n;
+        }
+
+        overflow = JSON_GetStr( pNode, "overflow" );
+        if( ( overflow != NULL ) &&
+            ( strcmp( overflow, "kill" ) == 0 ) )
+        {
+            rec.killOnOverflow = 1;
+        }
+
+        /* add the file dependencies */
+        rec.depends = pBuilder->refs.len / sizeof( uint32_t );
+        pDepends = (JArray *)JSON_Find( pNode, "depends_on" );
+        if( pDepends != NULL )
+        {
+            JSON_Iterate( pDepends, BuildDependency, (void *)pBuilder );
+        }
+        rec.nDepends = pBuilder->refs.len / sizeof( uint32_t ) - rec.depends;
+
+        /* add the pre-tokenized argument vector */
+        if( cmd != NULL )
+        {
+            BuildArgv( pBuilder, cmd, &rec );
+        }
+
+        /* add the variables rendered by the command */
+        rec.vars = pBuilder->vars.len / sizeof( VarRecord );
+        if( varname != NULL )
+        {
+            BuildVar( pBuilder, varname, JSON_Find( pNode, "extract" ) );
+        }
+
+        if( pOutputs != NULL )
+        {
+            JSON_Iterate( pOutputs, BuildOutput, (void *)pBuilder );
+        }
+        rec.nVars = pBuilder->vars.len / sizeof( VarRecord ) - rec.vars;
+
+        if( rec.nVars > 0 )
+        {
+            Append( pBuilder, &pBuilder->cmds, &rec, sizeof( rec ) );
+            result = EOK;
+        }
+    }
+    else
+    {
+        syslog( LOG_ERR, "Invalid exec definition\n" );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  BuildDependency                                                         */
+/*!
+    Add a file dependency to a configuration image
+
+    The BuildDependency function is a callback function for the
+    JSON_Iterate function which adds a file dependency to the
+    reference table.
+
+    @param[in]
+       pNode
+            pointer to the file name node
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ImageBuilder object
+
+    @retval EOK - the dependency was added
+    @retval EINVAL - the dependency is not a string
+
+============================================================================*/
+static int BuildDependency( JNode *pNode, void *arg )
+{
+    ImageBuilder *pBuilder = (ImageBuilder *)arg;
+    JVar *pPath = (JVar *)pNode;
+    int result = EINVAL;
+
+    if( ( pPath != NULL ) &&
+        ( pPath->var.type == VARTYPE_STR ) &&
+        ( pPath->var.val.str != NULL ) )
+    {
+        AddRef( pBuilder, AddString( pBuilder, pPath->var.val.str ) );
+        result = EOK;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  BuildOutput                                                             */
+/*!
+    Add an output variable to a configuration image
+
+    The BuildOutput function is a callback function for the JSON_Iterate
+    function which adds one entry of an "outputs" array to the variable
+    table.  The entry is expected to look as follows:
+
+    { "var": "varname", "extract": { <extraction rule> } }
+
+    @param[in]
+       pNode
+            pointer to the output definition node
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ImageBuilder object
+
+    @retval EOK - the output was added
+    @retval EINVAL - the output is invalid
+
+============================================================================*/
+static int BuildOutput( JNode *pNode, void *arg )
+{
+    ImageBuilder *pBuilder = (ImageBuilder *)arg;
+    char *varname;
+    int result = EINVAL;
+
+    varname = JSON_GetStr( pNode, "var" );
+    if( varname != NULL )
+    {
+        result = BuildVar( pBuilder, varname, JSON_Find( pNode, "extract" ) );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  BuildVar                                                                */
+/*!
+    Add a variable record to a configuration image
+
+    The BuildVar function adds a variable and its optional extraction
+    rule to the variable table.  Extraction rules are defined as:
+
+    { "regex": "<expression>", "group": <n> }
+    { "line": <n>, "field": <m>, "separator": "<chars>" }
+    { "key": "<name>", "separator": "<separator>" }
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[in]
+        name
+            pointer to the NUL terminated variable name
+
+    @param[in]
+        pRule
+            pointer to the extraction rule object, or NULL
+
+    @retval EOK - the variable was added
+    @retval EINVAL - the extraction rule is invalid
+
+============================================================================*/
+static int BuildVar( ImageBuilder *pBuilder, char *name, JNode *pRule )
+{
+    VarRecord rec;
+    char *pattern;
+    char *key;
+    int n;
+    int result = EOK;
+
+    memset( &rec, 0, sizeof( rec ) );
+    rec.name = AddString( pBuilder, name );
+    rec.type = EXTRACT_NONE;
+    rec.group = -1;
+
+    if( pRule != NULL )
+    {
+        pattern = JSON_GetStr( pRule, "regex" );
+        key = JSON_GetStr( pRule, "key" );
+
+        if( pattern != NULL )
+        {
+            rec.type = EXTRACT_REGEX;
+            rec.pattern = AddString( pBuilder, pattern );
+            if( JSON_GetNum( pRule, "group", &n ) == EOK )
+            {
+                rec.group = n;
+            }
+        }
+        else if( JSON_GetNum( pRule, "line", &n ) == EOK )
+        {
+            rec.type = EXTRACT_LINE;
+            rec.line = n;
+            if( JSON_GetNum( pRule, "field", &n ) == EOK )
+            {
+                rec.field = n;
+            }
+        }
+        else if( key != NULL )
+        {
+            rec.type = EXTRACT_KEY;
+            rec.key = AddString( pBuilder, key );
+        }
+        else
+        {
+            syslog( LOG_ERR, "Invalid extract rule for %s\n", name );
+            result = EINVAL;
+        }
+
+        rec.separator = AddString( pBuilder, JSON_GetStr( pRule, "separator" ) );
+    }
+
+    if( result == EOK )
+    {
+        Append( pBuilder, &pBuilder->vars, &rec, sizeof( rec ) );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ParsePriority                                                           */
+/*!
+    Parse the priority class of an exec command definition
+
+    The ParsePriority function converts the name of a priority class,
+    one of "high", "normal", or "low", to its PriorityClass value.
+    A definition without a priority is in the normal priority class.
+
+    @param[in]
+        name
+            pointer to the NUL terminated priority class name, or NULL
+
+    @param[out]
+        pPriority
+            pointer to a location to store the priority class
+
+    @retval EOK - the priority class was parsed
+    @retval EINVAL - the priority class name is invalid
+
+============================================================================*/
+static int ParsePriority( const char *name, int32_t *pPriority )
+{
+    int result = EOK;
+
+    if( ( name == NULL ) ||
+        ( strcmp( name, "normal" ) == 0 ) )
+    {
+        *pPriority = PRIORITY_NORMAL;
+    }
+    else if( strcmp( name, "high" ) == 0 )
+    {
+        *pPriority = PRIORITY_HIGH;
+    }
+    else if( strcmp( name, "low" ) == 0 )
+    {
+        *pPriority = PRIORITY_LOW;
+    }
+    else
+    {
+        syslog( LOG_ERR, "Invalid priority %s\n", name );
+        result = EINVAL;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  BuildArgv                                                               */
+/*!
+    Add the pre-tokenized argument vector of a command
+
+    The BuildArgv function splits a command which does not use any
+    shell features (pipes, redirection, quoting, expansion, etc.) into
+    its arguments, and adds them to the reference table followed by a
+    NULL terminator.  Such commands are executed directly rather than
+    via /bin/sh.  Commands which require the shell get an argc of 0.
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[in]
+        cmd
+            pointer to the NUL terminated command sequence
+
+    @param[in,out]
+        pRec
+            pointer to the command record to update
+
+    @return none
+
+============================================================================*/
+static void BuildArgv( ImageBuilder *pBuilder, const char *cmd, CmdRecord *pRec )
+{
+    char *copy;
+    char *token;
+    char *saveptr = NULL;
+
+    pRec->argv = 0;
+    pRec->argc = 0;
+
+    if( strpbrk( cmd, SHELL_CHARS ) == NULL )
+    {
+        copy = strdup( cmd );
+        if( copy != NULL )
+        {
+            pRec->argv = pBuilder->refs.len / sizeof( uint32_t );
+
+            for( token = strtok_r( copy, " \t", &saveptr );
+                 token != NULL;
+                 token = strtok_r( NULL, " \t", &saveptr ) )
+            {
+                AddRef( pBuilder, AddString( pBuilder, token ) );
+                pRec->argc++;
+            }
+
+            if( pRec->argc > 0 )
+            {
+                /* NULL terminate the argument vector */
+                AddRef( pBuilder, 0 );
+            }
+
+            free( copy );
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  AddString                                                               */
+/*!
+    Add a string to the string table
+
+    The AddString function interns a string into the string table of
+    the image being built, so identical strings are stored once.
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[in]
+        str
+            pointer to the NUL terminated string, or NULL
+
+    @retval offset of the string in the string table, or 0 for NULL
+
+============================================================================*/
+static uint32_t AddString( ImageBuilder *pBuilder, const char *str )
+{
+    StringEntry *pEntry;
+    uint32_t hash = 2166136261u;
+    uint32_t offset = 0;
+    const char *p;
+
+    if( ( str != NULL ) && ( *str != '\0' ) )
+    {
+        for( p = str; *p != '\0'; p++ )
+        {
+            hash ^= (unsigned char)*p;
+            hash *= 16777619u;
+        }
+
+        for( pEntry = pBuilder->stringTable[hash % STRING_TABLE_SIZE];
+             pEntry != NULL;
+             pEntry = pEntry->pNext )
+        {
+            if( ( pEntry->hash == hash ) &&
+                ( strcmp( (char *)&pBuilder->strings.pData[pEntry->offset],
+                          str ) == 0 ) )
+            {
+                return pEntry->offset;
+            }
+        }
+
+        pEntry = malloc( sizeof( StringEntry ) );
+        if( pEntry != NULL )
+        {
+            offset = pBuilder->strings.len;
+            Append( pBuilder, &pBuilder->strings, str, strlen( str ) + 1 );
+
+            pEntry->hash = hash;
+            pEntry->offset = offset;
+            pEntry->pNext = pBuilder->stringTable[hash % STRING_TABLE_SIZE];
+            pBuilder->stringTable[hash % STRING_TABLE_SIZE] = pEntry;
+        }
+        else
+        {
+            pBuilder->error = true;
+        }
+    }
+
+    return offset;
+}
+
+/*==========================================================================*/
+/*  AddRef                                                                  */
+/*!
+    Add a string reference to the reference table
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[in]
+        offset
+            string table offset to add
+
+    @return none
+
+============================================================================*/
+static void AddRef( ImageBuilder *pBuilder, uint32_t offset )
+{
+    Append( pBuilder, &pBuilder->refs, &offset, sizeof( offset ) );
+}
+
+/*==========================================================================*/
+/*  Append                                                                  */
+/*!
+    Append data to a growable buffer
+
+    The Append function appends data to one of the tables of the image
+    being built.  If the buffer cannot be grown the builder is marked
+    as failed.
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[in]
+        pBuf
+            pointer to the buffer to append to
+
+    @param[in]
+        pData
+            pointer to the data to append
+
+    @param[in]
+        len
+            number of bytes to append
+
+    @return none
+
+============================================================================*/
+static void Append( ImageBuilder *pBuilder,
+                    ByteBuffer *pBuf,
+                    const void *pData,
+                    size_t len )
+{
+    size_t size;
+    uint8_t *p;
+
+    if( pBuf->len + len > pBuf->size )
+    {
+        size = ( pBuf->size > 0 ) ? pBuf->size : BUFSIZ;
+        while( size < pBuf->len + len )
+        {
+            size *= 2;
+        }
+
+        p = realloc( pBuf->pData, size );
+        if( p == NULL )
+        {
+            pBuilder->error = true;
+            return;
+        }
+
+        pBuf->pData = p;
+        pBuf->size = size;
+    }
+
+    memcpy( &pBuf->pData[pBuf->len], pData, len );
+    pBuf->len += len;
+}
+
+/*==========================================================================*/
+/*  FinishImage                                                             */
+/*!
+    Assemble a configuration image
+
+    The FinishImage function lays out the header and the tables of the
+    image being built into one contiguous, 4-byte aligned buffer.
+
+    @param[in]
+        pBuilder
+            pointer to the image builder
+
+    @param[out]
+        pSize
+            location to store the size of the image
+
+    @retval pointer to the dynamically allocated image
+    @retval NULL - the image could not be built
+
+============================================================================*/
+static uint8_t *FinishImage( ImageBuilder *pBuilder, size_t *pSize )
+{
+    ImageHeader hdr;
+    uint8_t *pImage = NULL;
+    size_t size;
+
+    memset( &hdr, 0, sizeof( hdr ) );
+    hdr.magic = IMAGE_MAGIC;
+    hdr.version = IMAGE_VERSION;
+
+    hdr.cmdOffset = sizeof( ImageHeader );
+    hdr.nCmds = pBuilder->cmds.len / sizeof( CmdRecord );
+    hdr.varOffset = hdr.cmdOffset + pBuilder->cmds.len;
+    hdr.nVars = pBuilder->vars.len / sizeof( VarRecord );
+    hdr.refOffset = hdr.varOffset + pBuilder->vars.len;
+    hdr.nRefs = pBuilder->refs.len / sizeof( uint32_t );
+    hdr.strOffset = hdr.refOffset + pBuilder->refs.len;
+    hdr.strSize = pBuilder->strings.len;
+
+    size = (size_t)hdr.strOffset + hdr.strSize;
+    hdr.size = size;
+
+    if( ( pBuilder->error == false ) &&
+        ( size < UINT32_MAX ) )
+    {
+        pImage = malloc( size );
+    }
+
+    if( pImage != NULL )
+    {
+        memcpy( pImage, &hdr, sizeof( hdr ) );
+        memcpy( &pImage[hdr.cmdOffset], pBuilder->cmds.pData, pBuilder->cmds.len );
+        memcpy( &pImage[hdr.varOffset], pBuilder->vars.pData, pBuilder->vars.len );
+        memcpy( &pImage[hdr.refOffset], pBuilder->refs.pData, pBuilder->refs.len );
+        memcpy( &pImage[hdr.strOffset], pBuilder->strings.pData, pBuilder->strings.len );
+        *pSize = size;
+    }
+
+    return pImage;
+}
+
+/*==========================================================================*/
+/*  FreeBuilder                                                             */
+/*!
+    Free an image builder
+
+    @param[in]
+        pBuilder
+            pointer to the image builder to free
+
+    @return none
+
+============================================================================*/
+static void FreeBuilder( ImageBuilder *pBuilder )
+{
+    StringEntry *pEntry;
+    int i;
+
+    for( i = 0; i < STRING_TABLE_SIZE; i++ )
+    {
+        while( pBuilder->stringTable[i] != NULL )
+        {
+            pEntry = pBuilder->stringTable[i];
+            pBuilder->stringTable[i] = pEntry->pNext;
+            free( pEntry );
+        }
+    }
+
+    free( pBuilder->strings.pData );
+    free( pBuilder->cmds.pData );
+    free( pBuilder->vars.pData );
+    free( pBuilder->refs.pData );
+    free( pBuilder );
+}
+
+/*==========================================================================*/
+/*  OpenImage                                                               */
+/*!
+    Open a configuration image
+
+    The OpenImage function validates a configuration image and resolves
+    its reference table.  The image memory is released if the image
+    is invalid.
+
+    @param[in]
+        pBase
+            pointer to the start of the image
+
+    @param[in]
+        size
+            size of the image in bytes
+
+    @param[in]
+        mapped
+            true if the image is memory mapped, false if heap allocated
+
+    @retval pointer to the configuration image
+    @retval NULL - the image is invalid
+
+============================================================================*/
+static ConfigImage *OpenImage( uint8_t *pBase, size_t size, bool mapped )
+{
+    ConfigImage *pImage;
+    const uint32_t *pRefs;
+    uint32_t i;
+
+    pImage = calloc( 1, sizeof( ConfigImage ) );
+    if( pImage != NULL )
+    {
+        pImage->pBase = pBase;
+        pImage->size = size;
+        pImage->mapped = mapped;
+
+        if( ValidateImage( pImage ) == EOK )
+        {
+            pImage->ppRefs = calloc( pImage->pHeader->nRefs + 1, sizeof( char * ) );
+            if( pImage->ppRefs != NULL )
+            {
+                pRefs = (const uint32_t *)&pBase[pImage->pHeader->refOffset];
+                for( i = 0; i < pImage->pHeader->nRefs; i++ )
+                {
+                    pImage->ppRefs[i] = (char *)GetString( pImage, pRefs[i] );
+                }
+
+                return pImage;
+            }
+        }
+    }
+
+    if( pImage != NULL )
+    {
+        CONFIG_Release( pImage );
+    }
+    else if( mapped == true )
+    {
+        munmap( pBase, size );
+    }
+    else
+    {
+        free( pBase );
+    }
+
+    return NULL;
+}
+
+/*==========================================================================*/
+/*  ValidateImage                                                           */
+/*!
+    Validate a configuration image
+
+    The ValidateImage function checks that every table, record, string
+    offset, and reference of a configuration image lies within the image,
+    so that a corrupt or truncated binary configuration file is rejected
+    rather than crashing the service.
+
+    @param[in]
+        pImage
+            pointer to the configuration image to validate
+
+    @retval EOK - the image is valid
+    @retval EINVAL - the image is invalid
+
+============================================================================*/
+static int ValidateImage( ConfigImage *pImage )
+{
+    const ImageHeader *pHdr = (const ImageHeader *)pImage->pBase;
+    const CmdRecord *pCmd;
+    const VarRecord *pVar;
+    const uint32_t *pRefs;
+    uint32_t i;
+
+    if( ( pImage->size < sizeof( ImageHeader ) ) ||
+        ( pHdr->magic != IMAGE_MAGIC ) ||
+        ( pHdr->version != IMAGE_VERSION ) ||
+        ( pHdr->size != pImage->size ) ||
+        ( !ValidTable( pImage->size, pHdr->cmdOffset, pHdr->nCmds, sizeof( CmdRecord ) ) ) ||
+        ( !ValidTable( pImage->size, pHdr->varOffset, pHdr->nVars, sizeof( VarRecord ) ) ) ||
+        ( !ValidTable( pImage->size, pHdr->refOffset, pHdr->nRefs, sizeof( uint32_t ) ) ) ||
+        ( !ValidTable( pImage->size, pHdr->strOffset, pHdr->strSize, 1 ) ) ||
+        ( pHdr->strSize == 0 ) )
+    {
+        return EINVAL;
+    }
+
+    pImage->pHeader = pHdr;
+    pImage->pCmds = (const CmdRecord *)&pImage->pBase[pHdr->cmdOffset];
+    pImage->pVars = (const VarRecord *)&pImage->pBase[pHdr->varOffset];
+    pImage->pStrings = (const char *)&pImage->pBase[pHdr->strOffset];
+    pRefs = (const uint32_t *)&pImage->pBase[pHdr->refOffset];
+
+    /* every string must be terminated within the string table */
+    if( ( pImage->pStrings[0] != '\0' ) ||
+        ( pImage->pStrings[pHdr->strSize - 1] != '\0' ) )
+    {
+        return EINVAL;
+    }
+
+    for( i = 0; i < pHdr->nRefs; i++ )
+    {
+        if( pRefs[i] >= pHdr->strSize )
+        {
+            return EINVAL;
+        }
+    }
+
+    for( i = 0; i < pHdr->nVars; i++ )
+    {
+        pVar = &pImage->pVars[i];
+        if( ( pVar->name == 0 ) ||
+            ( pVar->name >= pHdr->strSize ) ||
+            ( pVar->pattern >= pHdr->strSize ) ||
+            ( pVar->key >= pHdr->strSize ) ||
+            ( pVar->separator >= pHdr->strSize ) ||
+            ( pVar->type < EXTRACT_NONE ) ||
+            ( pVar->type > EXTRACT_KEY ) )
+        {
+            return EINVAL;
+        }
+    }
+
+    for( i = 0; i < pHdr->nCmds; i++ )
+    {
+        pCmd = &pImage->pCmds[i];
+        if( ( ( pCmd->cmd == 0 ) && ( pCmd->group == 0 ) ) ||
+            ( pCmd->cmd >= pHdr->strSize ) ||
+            ( pCmd->group >= pHdr->strSize ) ||
+            ( pCmd->priority < PRIORITY_LOW ) ||
+            ( pCmd->priority >= PRIORITY_CLASSES ) ||
+            ( pCmd->hedge > 1 ) ||
+            ( pCmd->retries < 0 ) ||
+            ( pCmd->retryDelay < 0 ) ||
+            ( pCmd->retryBudget < 0 ) ||
+            ( pCmd->maxOutput < 0 ) ||
+            ( pCmd->killOnOverflow > 1 ) ||
+            ( pCmd->netif >= pHdr->strSize ) ||
+            ( (uint64_t)pCmd->depends + pCmd->nDepends > pHdr->nRefs ) ||
+            ( (uint64_t)pCmd->vars + pCmd->nVars > pHdr->nVars ) ||
+            ( ( pCmd->argc > 0 ) &&
+              ( ( (uint64_t)pCmd->argv + pCmd->argc + 1 > pHdr->nRefs ) ||
+                ( pRefs[pCmd->argv + pCmd->argc] != 0 ) ) ) )
+        {
+            return EINVAL;
+        }
+
+        if( pCmd->nVars > pImage->maxVars )
+        {
+            pImage->maxVars = pCmd->nVars;
+        }
+    }
+
+    return EOK;
+}
+
+/*==========================================================================*/
+/*  ValidTable                                                              */
+/*!
+    Check that a table lies within an image
+
+    @param[in]
+        size
+            size of the image in bytes
+
+    @param[in]
+        offset
+            offset of the table
+
+    @param[in]
+        n
+            number of records in the table
+
+    @param[in]
+        recsize
+            size of each record in bytes
+
+    @retval true - the table is 4-byte aligned and lies within the image
+    @retval false - the table is invalid
+
+============================================================================*/
+static bool ValidTable( size_t size, uint32_t offset, uint32_t n, size_t recsize )
+{
+    return ( ( offset % sizeof( uint32_t ) ) == 0 ) &&
+           ( (uint64_t)offset + (uint64_t)n * recsize <= size );
+}
+
+/*==========================================================================*/
+/*  GetString                                                               */
+/*!
+    Get a string from the string table
+
+    @param[in]
+        pImage
+            pointer to the configuration image
+
+    @param[in]
+        offset
+            offset of the string in the string table
+
+    @retval pointer to the string
+    @retval NULL - the offset is 0 (no value)
+
+============================================================================*/
+static const char *GetString( ConfigImage *pImage, uint32_t offset )
+{
+    return ( offset != 0 ) ? &pImage->pStrings[offset] : NULL;
+}
+
+/*! @}
+ * end of config group */
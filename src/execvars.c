@@ -45,13 +45,72 @@ SOFTWARE.
             { "var" : "/sys/network/mac",
               "exec" : "ifconfig eth0 | grep ether | awk {'print $2'}" },
             { "var" : "/sys/info/uptime",
-              "exec" : "uptime" }
+              "exec" : "uptime" },
+            { "var" : "/sys/info/hostname",
+              "exec" : "cat /etc/hostname",
+              "depends_on" : [ "/etc/hostname" ] },
+            { "var" : "/sys/network/ip",
+              "exec" : "ip -4 -o addr show eth0 | awk {'print $4'}",
+              "netlink" : "eth0" }
         ]
     }
 
     When the value of an exec variable is requested, the associated command
     is executed, and the response rendered to the specified output stream.
 
+    An exec variable which lists the files its output is derived from
+    in its "depends_on" array has its output cached.  The cached output
+    is served until one of the listed files is changed.
+
+    An exec variable which specifies a "netlink" network interface name
+    (or "*" for any interface) has its output cached and re-rendered
+    whenever the link state or addresses of that interface change.
+
+    An exec variable which specifies a "ttl" has its output cached for
+    at most that number of seconds.
+
+    An exec variable name can contain "{name}" parameters, to define every
+    variable whose name matches it.  The parameter values are bound from
+    the requested variable name and substituted into the command:
+
+    { "var" : "/sys/network/{if}/mac",
+      "exec" : "cat /sys/class/net/{if}/address" }
+
+    An exec variable can specify an "extract" rule which selects its
+    value from the command output in-process, instead of piping the
+    command output through grep or awk:
+
+    { "var" : "/sys/info/uptime",
+      "exec" : "uptime",
+      "extract" : { "line" : 1 } }
+
+    A single command can render several variables by listing them in
+    an "outputs" array.  Each output selects its value from the command
+    output with an optional extraction rule, so one execution of the
+    command (and one cached result) serves all of the variables:
+
+    { "exec" : "ifconfig eth0",
+      "netlink" : "eth0",
+      "outputs" : [
+          { "var" : "/sys/network/ip",
+            "extract" : { "regex" : "inet ([0-9.]+)" } },
+          { "var" : "/sys/network/mac",
+            "extract" : { "regex" : "ether ([0-9a-f:]+)" } } ] }
+
+    The configuration is reloaded when the execvars service receives
+    SIGHUP, or when the configuration file changes.  Only the differences
+    between the new configuration and the live registry are applied.
+
+    The configuration can also be split into "*.json" fragments in a
+    directory specified with -d.  The fragments are parsed in parallel,
+    and only the fragments which change are re-parsed on a reload.
+
+    A JSON configuration file can be compiled into a binary configuration
+    image with "execvars --compile config.json -o config.bin".  The
+    compiled image is memory mapped read-only when it is loaded, and
+    commands which do not need shell features are executed directly
+    from their pre-tokenized argument vectors.
+
 */
 /*==========================================================================*/
 
@@ -61,8 +120,11 @@ SOFTWARE.
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdalign.h>
 #include <unistd.h>
 #include <syslog.h>
 #include <signal.h>
@@ -70,649 +132,8871 @@ SOFTWARE.
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
+#include <time.h>
+#include <inttypes.h>
 #include <varserver/varserver.h>
-#include <tjson/json.h>
 #include <sys/select.h>
+#include <sys/signalfd.h>
+#include <poll.h>
+#include <getopt.h>
+#include <dirent.h>
+#include <limits.h>
+#include "watch.h"
+#include "netevent.h"
+#include "extract.h"
+#include "config.h"
+#include "pool.h"
+#include "template.h"
+#include "reference.h"
+#include "shmcache.h"
+#include "snapshot.h"
 
 /*============================================================================
         Private definitions
 ============================================================================*/
 
+/*! growable buffer used to capture command output */
+typedef struct outputBuffer
+{
+    /*! pointer to the captured data */
+    char *pData;
+
+    /*! number of bytes captured */
+    size_t len;
+
+    /*! allocated size of the data buffer */
+    size_t size;
+
+    /*! true if some output could not be captured */
+    bool incomplete;
+
+} OutputBuffer;
+
+/*! reference counted block of output data.  The data of an OutputBuffer
+    is the data of an output chunk, which may be shared by several
+    output buffers */
+typedef struct outputChunk
+{
+    /*! number of output buffers referencing the chunk */
+    uint32_t refCount;
+
+    /*! output data */
+    alignas( max_align_t ) char data[];
+
+} OutputChunk;
+
+/*! maximum number of signals read from the signalfd at one time */
+#define MAX_SIGNAL_BATCH 32
+
+/*! number of buckets in the exec command intern table */
+#define EXECCMD_TABLE_SIZE 4096
+
+/*! number of buckets in the exec variable name and handle indexes */
+#define EXECVAR_TABLE_SIZE 16384
+
+/*! number of registry entries allocated at a time once the registry
+    has been sized from the initial configuration */
+#define POOL_CHUNK_SIZE 64
+
+/*! maximum number of exec variables registered per event loop iteration */
+#define REGISTER_BATCH 256
+
+/*! maximum number of bytes of unsent output held in memory per print
+    session.  Further output is spilled to a temporary file */
+#define SESSION_BUFFER_LIMIT 65536
+
+/*! default maximum number of print requests waiting to be served */
+#define DEFAULT_QUEUE_DEPTH 64
+
+/*! default maximum number of print requests for one exec variable which
+    may be waiting to be served or sending their output at once */
+#define DEFAULT_MAX_CLIENTS 16
+
+/*! marker sent to a client whose print request was shed when no cached
+    output is available to serve instead */
+#define BUSY_MARKER "!EBUSY"
+
+/*! default number of consecutive failed executions of a command which
+    open its circuit breaker */
+#define DEFAULT_BREAKER_FAILURES 5
+
+/*! default time in seconds a circuit breaker stays open before the
+    command is probed again */
+#define DEFAULT_BREAKER_COOLDOWN 30
+
+/*! marker sent to a client when a command's circuit breaker is open and
+    no previous output is available to serve instead */
+#define FAILED_MARKER "!EFAILED"
+
+/*! default delay in milliseconds before the first retry of a transiently
+    failed execution */
+#define DEFAULT_RETRY_DELAY_MS 100
+
+/*! default time in milliseconds from the first execution after which a
+    transiently failed execution is not retried */
+#define DEFAULT_RETRY_BUDGET_MS 2000
+
+/*! default maximum number of bytes of output kept from an execution */
+#define DEFAULT_MAX_OUTPUT ( 1024 * 1024 )
+
+/*! default number of entries in the shared result cache */
+#define DEFAULT_SHMCACHE_ENTRIES 1024
+
+/*! duration in milliseconds of the claim on a command being executed
+    for the shared result cache, if no command timeout is set */
+#define SHMCACHE_LEASE_MS 10000
+
+/*! interval in milliseconds at which a print request waiting for the
+    output of a command another instance is executing checks the shared
+    result cache again */
+#define SHMCACHE_POLL_MS 10
+
+/*! default interval in seconds between cache snapshots */
+#define DEFAULT_SNAPSHOT_INTERVAL 60
+
+/*! maximum time in milliseconds to wait for an output stream which is
+    written directly, rather than through a print session, to accept
+    more output */
+#define DIRECT_WRITE_TIMEOUT_MS 1000
+
+/*! size of the smallest pooled output buffer */
+#define OUTPUT_CLASS_MIN 128
+
+/*! number of pooled output buffer size classes.  Each class is four
+    times the size of the one before it */
+#define OUTPUT_CLASSES 6
+
+/*! number of bytes of pooled output buffers allocated at one time */
+#define OUTPUT_CHUNK_SIZE 65536
+
+/*! weight of the latest execution time in the running average
+    execution time of a command, as a power of two divisor */
+#define EXEC_AVERAGE_SHIFT 3
+
+/*! number of recent execution times kept for a hedged command */
+#define HEDGE_SAMPLES 32
+
+/*! minimum number of execution times observed before a command is
+    hedged */
+#define HEDGE_MIN_SAMPLES 8
+
+/*! ioprio_set parameters, which have no glibc wrapper */
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_SHIFT 13
+
+/*! scheduling parameters of a priority class */
+typedef struct priorityInfo
+{
+    /*! number of queued print requests served per scheduling round */
+    int weight;
+
+    /*! nice increment of the commands */
+    int nice;
+
+    /*! best effort I/O priority level of the commands, or -1 to
+        inherit the I/O priority of the service */
+    int ioLevel;
+
+} PriorityInfo;
+
+/*! execCmd component which holds a command sequence and its cached output */
+typedef struct execCmd
+{
+    /*! command sequence */
+    const char *pCmd;
+
+    /*! pre-tokenized argument vector used to execute the command without
+        a shell, or NULL if the command requires a shell */
+    char * const *ppArgv;
+
+    /*! command sequence expanded from a template, owned by the command */
+    char *pCmdBuf;
+
+    /*! intern key made up of the command sequence and its caching policy */
+    char *pKey;
+
+    /*! hash of the intern key */
+    uint32_t hash;
+
+    /*! number of exec variables rendered by this command */
+    int refCount;
+
+    /*! name of the network interface whose changes refresh the output,
+        "*" for any interface, or NULL if not network driven */
+    const char *pNetIf;
+
+    /*! maximum age of the cached output in milliseconds, or 0 if the
+        cached output does not expire */
+    uint64_t ttl_ms;
+
+    /*! monotonic time in milliseconds at which the cached output expires */
+    uint64_t expires_ms;
+
+    /*! true if the output is cached */
+    bool cacheable;
+
+    /*! true if the output must be re-rendered into the cache */
+    bool refresh;
+
+    /*! scheduling priority class of the command */
+    PriorityClass priority;
+
+    /*! true if the cached output is valid */
+    bool cacheValid;
+
+    /*! true if the cached output has been invalidated, but can still be
+        served to a print request shed by admission control */
+    bool cacheStale;
+
+    /*! cached command output */
+    OutputBuffer cache;
+
+    /*! number of times the command was executed */
+    uint64_t execCount;
+
+    /*! total command execution time in microseconds */
+    uint64_t execTime_us;
+
+    /*! running average of the recent command execution times in
+        microseconds, used to estimate the cost of a print request */
+    uint64_t avgTime_us;
+
+    /*! number of executions cancelled because the client went away */
+    uint64_t cancelCount;
+
+    /*! ring buffer of the recent execution times in microseconds of a
+        hedged command, or NULL if the command is not hedged */
+    uint32_t *pLatency;
+
+    /*! number of execution times in the ring buffer */
+    int nLatency;
+
+    /*! index of the next execution time to record in the ring buffer */
+    int latencyNext;
+
+    /*! number of hedged second executions started */
+    uint64_t hedgeCount;
+
+    /*! number of hedged second executions which completed first */
+    uint64_t hedgeWins;
+
+    /*! number of consecutive failed executions */
+    int failures;
+
+    /*! monotonic time in milliseconds until which the circuit breaker
+        is open, or 0 if the circuit breaker is closed */
+    uint64_t breakerUntil_ms;
+
+    /*! number of times the circuit breaker was opened */
+    uint64_t breakerTrips;
+
+    /*! number of renders answered without executing the command because
+        the circuit breaker was open */
+    uint64_t breakerHits;
+
+    /*! exit status of the latest reaped execution: the exit code, or 128
+        plus the signal number if the command was killed by a signal */
+    int exitStatus;
+
+    /*! number of times a transiently failed execution is retried */
+    int retries;
+
+    /*! delay in milliseconds before the first retry */
+    uint32_t retryDelay_ms;
+
+    /*! time in milliseconds from the first execution after which no
+        further retries are started */
+    uint32_t retryBudget_ms;
+
+    /*! number of retries started */
+    uint64_t retryCount;
+
+    /*! number of retries started since the first failed execution of
+        the current series */
+    int retryAttempt;
+
+    /*! monotonic time in milliseconds at which the first execution of
+        the current series was started */
+    uint64_t retryStart_ms;
+
+    /*! monotonic time in milliseconds before which the next retry is
+        not started, or 0 if no retry is pending */
+    uint64_t retryAt_ms;
+
+    /*! delay in milliseconds before the retry after the pending one */
+    uint64_t retryNext_ms;
+
+    /*! maximum number of bytes of output kept from an execution, or 0
+        if the output is not limited */
+    size_t maxOutput;
+
+    /*! true to kill an execution which exceeds the maximum output size,
+        false to truncate its output */
+    bool killOnOverflow;
+
+    /*! number of executions which exceeded the maximum output size */
+    uint64_t overflowCount;
+
+    /*! true if the output expires by time alone, so it is shared with
+        other instances through the shared result cache, and kept in the
+        cache snapshot */
+    bool shareable;
+
+    /*! key of the command in the shared result cache */
+    uint64_t shmKey;
+
+    /*! number of renders served from the shared result cache */
+    uint64_t sharedHits;
+
+    /*! exec variables whose values are referenced by the command sequence,
+        in reference order.  Unknown references are NULL */
+    struct execVar **ppRefs;
+
+    /*! number of references in the command sequence */
+    int nRefs;
+
+    /*! command sequence with the referenced values substituted which
+        rendered the cached output, or NULL */
+    char *pExpanded;
+
+    /*! evaluation which last visited the command */
+    uint32_t evalSerial;
+
+    /*! dependency level of the command in the evaluation, or -1 if its
+        references cannot be evaluated */
+    int evalLevel;
+
+    /*! true while the command's references are being visited */
+    bool evalActive;
+
+    /*! true if the output in the evaluation was served from the cache */
+    bool evalCached;
+
+    /*! output of the command in the evaluation, or NULL if the command
+        could not be rendered */
+    OutputBuffer *pOutput;
+
+    /*! pointer to the next exec command */
+    struct execCmd *pNext;
+
+    /*! pointer to the next exec command in the same intern table bucket */
+    struct execCmd *pHashNext;
+
+} ExecCmd;
+
+/*! configuration file which the registry is loaded from */
+typedef struct configSource
+{
+    /*! name of the configuration file */
+    char *pFileName;
+
+    /*! configuration image which the registry strings are borrowed from */
+    ConfigImage *pImage;
+
+    /*! configuration image loaded by the current (re)load, or NULL */
+    ConfigImage *pNewImage;
+
+    /*! true if the configuration file must be (re)loaded */
+    bool dirty;
+
+    /*! true if the configuration file was found by the latest scan of
+        the configuration directory, or was specified with -f */
+    bool present;
+
+    /*! true if the configuration file is in the configuration directory */
+    bool fragment;
+
+    /*! pointer to the ExecVars state object */
+    struct execVarsState *pState;
+
+    /*! pointer to the next configuration source */
+    struct configSource *pNext;
+
+} ConfigSource;
+
+/*! print request waiting to be served */
+typedef struct printRequest
+{
+    /*! print session identifier received with the print signal */
+    int sigval;
+
+    /*! handle of the variable to print */
+    VAR_HANDLE hVar;
+
+    /*! output file descriptor of the client */
+    int fd;
+
+    /*! monotonic time in milliseconds at which the request was queued */
+    uint64_t queued_ms;
+
+    /*! monotonic time in milliseconds before which the request is not
+        served, or 0 */
+    uint64_t notBefore_ms;
+
+} PrintRequest;
+
+/*! print session whose output is sent to the client as it can accept it */
+typedef struct printSession
+{
+    /*! print session identifier received with the print signal */
+    int sigval;
+
+    /*! handle of the variable being printed */
+    VAR_HANDLE hVar;
+
+    /*! true if the print request was admitted, and counts against the
+        client limit of its exec variable */
+    bool admitted;
+
+    /*! nonblocking output file descriptor of the client */
+    int fd;
+
+    /*! output which has not been sent yet */
+    OutputBuffer pending;
+
+    /*! number of bytes of the pending output which have been sent */
+    size_t offset;
+
+    /*! temporary file holding the output which did not fit in memory,
+        or NULL */
+    FILE *fpSpill;
+
+    /*! number of bytes written to the spill file */
+    off_t spillWrite;
+
+    /*! number of bytes read back from the spill file */
+    off_t spillRead;
+
+    /*! true if the client could not be written to */
+    bool failed;
+
+    /*! pointer to the next print session */
+    struct printSession *pNext;
+
+} PrintSession;
+
+/*! execTemplate component which maps a family of system variables to a
+    parameterized command sequence */
+typedef struct execTemplate
+{
+    /*! compiled variable name and command templates */
+    Template *pTemplate;
+
+    /*! variable name template */
+    const char *pName;
+
+    /*! exec command definition the concrete commands are expanded from */
+    ExecDef def;
+
+    /*! rule which extracts the variable values from the command output,
+        or NULL if the full command output is used */
+    ExtractRule *pExtract;
+
+    /*! configuration generation which defined this template */
+    uint32_t generation;
+
+    /*! pointer to the next exec template */
+    struct execTemplate *pNext;
+
+} ExecTemplate;
+
+/*! execGroup component which renders a set of exec variables as one
+    JSON object */
+typedef struct execGroup
+{
+    /*! name prefix of the member variables */
+    const char *pPrefix;
+
+    /*! array of pointers to the member exec variables, in name order */
+    struct execVar **ppMembers;
+
+    /*! number of member exec variables */
+    int nMembers;
+
+    /*! scheduling priority class of the group */
+    PriorityClass priority;
+
+    /*! configuration generation which defined this group */
+    uint32_t generation;
+
+    /*! pointer to the next exec group */
+    struct execGroup *pNext;
+
+} ExecGroup;
+
+/*! command executed by an evaluation */
+typedef struct execJob
+{
+    /*! command being executed */
+    ExecCmd *pExecCmd;
+
+    /*! command sequence with the referenced values substituted, or NULL
+        if the command sequence is executed as-is */
+    char *pCmdBuf;
+
+    /*! command output stream */
+    FILE *fp;
+
+    /*! process identifier of the command */
+    pid_t pid;
+
+    /*! captured command output */
+    OutputBuffer output;
+
+    /*! monotonic time in nanoseconds at which the command was started */
+    uint64_t start_ns;
+
+    /*! result of the command execution */
+    int result;
+
+    /*! exit status of the command, or -1 if it was not reaped */
+    int status;
+
+    /*! number of bytes of output kept, up to the output limit */
+    size_t outputBytes;
+
+    /*! true if the command exceeded its output limit */
+    bool overflowed;
+
+    /*! true while the command output is being read */
+    bool running;
+
+} ExecJob;
+
+/*! evaluation of a set of exec commands and the commands they reference */
+typedef struct execEval
+{
+    /*! evaluation serial number */
+    uint32_t serial;
+
+    /*! commands to evaluate, in dependency order */
+    ExecCmd **ppOrder;
+
+    /*! number of commands to evaluate */
+    int nOrder;
+
+    /*! allocated size of the command array */
+    int size;
+
+    /*! commands executed by the evaluation */
+    ExecJob *pJobs;
+
+    /*! number of commands executed by the evaluation */
+    int nJobs;
+
+} ExecEval;
+
+/*! context used to look up the references of an exec command */
+typedef struct referenceContext
+{
+    /*! pointer to the ExecVars state object */
+    struct execVarsState *pState;
+
+    /*! exec command whose references are being looked up */
+    ExecCmd *pExecCmd;
+
+} ReferenceContext;
+
 /*! execVar component which maps a system variable to a command sequence */
 typedef struct execVar
 {
     /*! variable handle */
     VAR_HANDLE hVar;
 
-    /*! command sequence */
-    char *pCmd;
+    /*! variable name */
+    const char *pName;
+
+    /*! variable name owned by a template instance, or NULL */
+    char *pNameBuf;
+
+    /*! template the variable is an instance of, or NULL */
+    ExecTemplate *pTemplate;
+
+    /*! configuration source which defines the variable */
+    ConfigSource *pSource;
+
+    /*! group the variable renders, or NULL */
+    ExecGroup *pGroup;
+
+    /*! configuration generation which last defined this variable */
+    uint32_t generation;
+
+    /*! command which renders the variable, or NULL if the variable is
+        a group, or a template instance which has not been rendered yet */
+    ExecCmd *pExecCmd;
+
+    /*! rule which extracts the variable value from the command output,
+        or NULL if the full command output is used */
+    ExtractRule *pExtract;
+
+    /*! number of print requests served from the cached command output */
+    uint64_t cacheHits;
+
+    /*! number of admitted print requests waiting to be served or
+        sending their output */
+    int clients;
+
+    /*! number of print requests shed by admission control */
+    uint64_t shedCount;
+
+    /*! number of shed print requests served from stale cached output */
+    uint64_t staleHits;
+
+    /*! number of times the extraction rule was applied */
+    uint64_t extractCount;
+
+    /*! number of times the extraction rule did not find a value */
+    uint64_t extractFailures;
+
+    /*! total extraction time in nanoseconds */
+    uint64_t extractTime_ns;
+
+    /*! hash of the variable name */
+    uint32_t nameHash;
+
+    /*! true if the variable is waiting to be registered */
+    bool pending;
+
+    /*! pointer to the next exec variable */
+    struct execVar *pNext;
+
+    /*! pointer to the next exec variable in the same name index bucket */
+    struct execVar *pNameNext;
+
+    /*! pointer to the next exec variable in the same handle index bucket */
+    struct execVar *pHandleNext;
+
+    /*! pointer to the next exec variable waiting to be registered */
+    struct execVar *pPendingNext;
+
+} ExecVar;
+
+/*! ExecVars state */
+typedef struct execVarsState
+{
+    /*! variable server handle */
+    VARSERVER_HANDLE hVarServer;
+
+    /*! verbose flag */
+    bool verbose;
+
+    /*! timeout in seconds */
+    int timeout_seconds;
+
+    /*! name of the ExecVars definition file */
+    char *pFileName;
+
+    /*! true to compile the configuration file instead of serving it */
+    bool compile;
+
+    /*! name of the binary configuration file to compile to */
+    char *pOutFileName;
+
+    /*! name of the ExecVars configuration fragment directory */
+    char *pDirName;
+
+    /*! list of configuration sources */
+    ConfigSource *pSources;
+
+    /*! configuration source being applied by the current (re)load */
+    ConfigSource *pSource;
+
+    /*! true if the configuration directory must be re-scanned */
+    bool rescan;
+
+    /*! pointer to the exec vars list */
+    ExecVar *pExecVars;
+
+    /*! pointer to the exec commands list */
+    ExecCmd *pExecCmds;
+
+    /*! pointer to the exec templates list */
+    ExecTemplate *pTemplates;
+
+    /*! pointer to the exec groups list */
+    ExecGroup *pGroups;
+
+    /*! exec command intern table used to share identical commands */
+    ExecCmd *cmdTable[EXECCMD_TABLE_SIZE];
+
+    /*! pool which exec variables are allocated from */
+    Pool *pExecVarPool;
+
+    /*! pool which exec commands are allocated from */
+    Pool *pExecCmdPool;
+
+    /*! pools which output chunks are allocated from, one per size
+        class */
+    Pool *pOutputPool[OUTPUT_CLASSES];
+
+    /*! output buffer holding the output being written, which a print
+        session may keep a reference to instead of copying it, or NULL */
+    OutputBuffer *pShared;
+
+    /*! exec variable index by name, used to apply configuration changes */
+    ExecVar *nameTable[EXECVAR_TABLE_SIZE];
+
+    /*! exec variable index by handle, used to serve print requests */
+    ExecVar *handleTable[EXECVAR_TABLE_SIZE];
+
+    /*! queue of exec variables waiting to be registered */
+    ExecVar *pPending;
+
+    /*! pointer to the tail link of the registration queue */
+    ExecVar **ppPendingTail;
+
+    /*! number of exec variables waiting to be registered */
+    int nPending;
+
+    /*! monotonic time in milliseconds at which registration started */
+    uint64_t registerStart_ms;
+
+    /*! configuration generation, incremented on every (re)load */
+    uint32_t generation;
+
+    /*! evaluation serial number, incremented on every evaluation */
+    uint32_t evalSerial;
+
+    /*! print sessions with output waiting to be sent */
+    PrintSession *pSessions;
+
+    /*! print session being rendered, or NULL */
+    PrintSession *pSession;
+
+    /*! monotonic time in milliseconds until which the print request
+        being rendered is parked in the queue, or 0 if it was served */
+    uint64_t defer_ms;
+
+    /*! number of print sessions with output waiting to be sent */
+    int nSessions;
+
+    /*! poll descriptors of the event loop */
+    struct pollfd *pPollFds;
+
+    /*! number of allocated poll descriptors */
+    int pollSize;
+
+    /*! ring buffers of print requests waiting to be served, one per
+        priority class */
+    PrintRequest *pQueue[PRIORITY_CLASSES];
+
+    /*! maximum number of print requests waiting to be served */
+    int queueDepth;
+
+    /*! index of the oldest print request waiting to be served in
+        each priority class */
+    int queueHead[PRIORITY_CLASSES];
+
+    /*! number of print requests waiting to be served in each
+        priority class */
+    int queueLength[PRIORITY_CLASSES];
+
+    /*! number of print requests waiting to be served */
+    int queueCount;
+
+    /*! number of print requests each priority class may still be
+        served in the current scheduling round */
+    int credits[PRIORITY_CLASSES];
+
+    /*! priority class of the commands being started */
+    PriorityClass childPriority;
+
+    /*! output limit of the command being executed, or 0 */
+    size_t childMaxOutput;
+
+    /*! true to kill the command being executed if it exceeds its
+        output limit, false to truncate its output */
+    bool childKillOnOverflow;
+
+    /*! true if the command being executed exceeded its output limit */
+    bool childOverflowed;
+
+    /*! default maximum number of bytes of output kept from an
+        execution, or 0 if the output is not limited */
+    size_t maxOutput;
+
+    /*! maximum number of admitted print requests per exec variable */
+    int maxClients;
+
+    /*! true to serve the queued print request with the shortest
+        expected execution time first */
+    bool shortestFirst;
+
+    /*! number of consecutive failures which open a circuit breaker,
+        or 0 to disable the circuit breakers */
+    int breakerFailures;
+
+    /*! time in seconds a circuit breaker stays open */
+    int breakerCooldown;
+
+    /*! number of print requests shed by admission control */
+    uint64_t shedCount;
+
+    /*! number of shed print requests served from stale cached output */
+    uint64_t staleHits;
+
+    /*! name of the shared result cache, or NULL if it is not used */
+    char *pShmName;
+
+    /*! shared result cache, or NULL if it is not used */
+    ShmCache *pShmCache;
+
+    /*! name of the cache snapshot file, or NULL if it is not used */
+    char *pSnapshotName;
+
+    /*! interval in seconds between cache snapshots, or 0 to only write
+        the snapshot on shutdown */
+    int snapshotInterval;
+
+    /*! monotonic time in milliseconds at which the next cache snapshot
+        is written */
+    uint64_t snapshot_ms;
+
+    /*! true if the configuration must be reloaded */
+    bool reload;
+
+    /*! number of exec variables added by the current (re)load */
+    int added;
+
+    /*! number of exec variables updated by the current (re)load */
+    int updated;
+} ExecVarsState;
+
+/*! index of the exec commands by shared key, used to restore the cache
+    snapshot */
+typedef struct snapshotIndex
+{
+    /*! pointer to the ExecVars state object */
+    ExecVarsState *pState;
+
+    /*! open addressed table of the exec commands whose output is kept
+        in the cache snapshot */
+    ExecCmd **ppTable;
+
+    /*! number of slots in the table, a power of two */
+    size_t size;
+
+} SnapshotIndex;
+
+/*============================================================================
+        Private file scoped variables
+============================================================================*/
+
+/*! ExecVars State object */
+ExecVarsState state;
+
+/*! scheduling parameters of each priority class.  Low priority print
+    requests are served at least once per scheduling round, so they are
+    never starved by higher priority requests */
+static const PriorityInfo priorities[PRIORITY_CLASSES] =
+{
+    [PRIORITY_LOW] = { 1, 10, 7 },
+    [PRIORITY_NORMAL] = { 4, 0, -1 },
+    [PRIORITY_HIGH] = { 16, 0, 0 }
+};
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+void main(int argc, char **argv);
+static int ProcessOptions( int argC, char *argV[], ExecVarsState *pState );
+static void usage( char *cmdname );
+static int SetupSignalfd( ExecVarsState *pState );
+static void RunEventLoop( ExecVarsState *pState, int sigfd );
+static void AdmitRequest( ExecVarsState *pState, int sigval );
+static void ServeRequest( ExecVarsState *pState );
+static void ShedRequest( ExecVarsState *pState,
+                         PrintRequest *pRequest,
+                         ExecVar *pExecVar );
+static int NextPriority( ExecVarsState *pState, uint64_t now_ms );
+static int NextRequest( ExecVarsState *pState,
+                        int priority,
+                        uint64_t now_ms );
+static int QueueTimeout( ExecVarsState *pState );
+static bool DeferRequest( ExecVarsState *pState, uint64_t until_ms );
+static uint64_t ExpectedCost( ExecVarsState *pState, VAR_HANDLE hVar );
+static uint64_t ExpectedCmdCost( ExecCmd *pExecCmd );
+static void RecordExecution( ExecVarsState *pState,
+                             ExecCmd *pExecCmd,
+                             uint64_t time_us,
+                             int result,
+                             int status );
+static int RunAttempt( ExecVarsState *pState,
+                       ExecCmd *pExecCmd,
+                       int fd,
+                       OutputBuffer *pCapture );
+static bool IsTransient( int result );
+static void RecordOverflow( ExecCmd *pExecCmd );
+static bool BreakerOpen( ExecCmd *pExecCmd );
+static int OutputLastGood( ExecVar *pExecVar, int fd );
+static uint64_t HedgeDelay( ExecCmd *pExecCmd );
+static int CompareSamples( const void *p1, const void *p2 );
+static int ExecuteHedged( ExecVarsState *pState,
+                          ExecCmd *pExecCmd,
+                          int fd,
+                          OutputBuffer *pCapture,
+                          uint64_t delay_ms,
+                          int *pStatus );
+static PriorityClass GetPriority( ExecVar *pExecVar );
+static void SetChildPriority( PriorityClass priority );
+static bool HandlePrintRequest( ExecVarsState *pState,
+                                PrintRequest *pRequest,
+                                bool admitted );
+static void RenderRequest( ExecVarsState *pState,
+                           PrintRequest *pRequest,
+                           bool admitted );
+static int ServeStale( ExecVarsState *pState, VAR_HANDLE hVar, int fd );
+static void ReleaseClient( ExecVarsState *pState, VAR_HANDLE hVar );
+static int SetupPollFds( ExecVarsState *pState );
+static void ServiceSessions( ExecVarsState *pState, int n );
+static void QueueOutput( PrintSession *pSession, const char *buf, size_t len );
+static void SpillOutput( PrintSession *pSession, const char *buf, size_t len );
+static bool FlushSession( PrintSession *pSession );
+static void CloseSession( ExecVarsState *pState, PrintSession *pSession );
+static int LoadConfig( ExecVarsState *pState );
+static void ConfigChanged( const char *path, void *arg );
+static void ConfigDirChanged( const char *path, void *arg );
+static void RequestReload( ExecVarsState *pState );
+static ConfigSource *AddConfigSource( ExecVarsState *pState,
+                                      const char *filename,
+                                      bool fragment );
+static void ScanConfigDir( ExecVarsState *pState );
+static int ConfigFilter( const struct dirent *entry );
+static int LoadConfigSources( ExecVarsState *pState );
+static int PurgeExecVars( ExecVarsState *pState );
+static void PurgeExecCmds( ExecVarsState *pState );
+static int SetupExecVar( const ExecDef *pDef, void *arg );
+static ExecCmd *InternExecCmd( ExecVarsState *pState,
+                               const ExecDef *pDef,
+                               char *pCmdBuf );
+static int SetupTemplate( ExecVarsState *pState,
+                          const ExecDef *pDef,
+                          const VarDef *pVar );
+static ExecCmd *BindTemplate( ExecVarsState *pState,
+                              ExecTemplate *pExecTemplate,
+                              const char *varname );
+static void PurgeTemplates( ExecVarsState *pState );
+static int SetupGroup( ExecVarsState *pState,
+                       const ExecDef *pDef,
+                       const VarDef *pVar );
+static void ResolveGroups( ExecVarsState *pState );
+static int CompareExecVars( const void *p1, const void *p2 );
+static void PurgeGroups( ExecVarsState *pState );
+static int RenderGroup( ExecVarsState *pState, ExecGroup *pExecGroup, int fd );
+static void AppendGroupValue( ExecVar *pExecVar, OutputBuffer *pDoc );
+static size_t TrimValue( const char *pValue, size_t len );
+static void ResolveReferences( ExecVarsState *pState );
+static void SetupReferences( ExecVarsState *pState, ExecCmd *pExecCmd );
+static int AddReference( const char *name, void *arg );
+static int RenderDependent( ExecVarsState *pState,
+                            ExecVar *pExecVar,
+                            int fd );
+static void BeginEvaluation( ExecVarsState *pState, ExecEval *pEval );
+static int VisitExecCmd( ExecVarsState *pState,
+                         ExecEval *pEval,
+                         ExecCmd *pExecCmd );
+static void Evaluate( ExecVarsState *pState, ExecEval *pEval );
+static void PrepareExecCmd( ExecEval *pEval, ExecCmd *pExecCmd );
+static char *ExpandReferences( ExecCmd *pExecCmd );
+static void StartJob( ExecEval *pEval, ExecCmd *pExecCmd, char *pCmdBuf );
+static void RunJobs( ExecVarsState *pState, ExecJob *pJobs, int nJobs );
+static void CompleteJob( ExecJob *pJob );
+static void EndEvaluation( ExecEval *pEval );
+static void AppendJSONString( OutputBuffer *pDoc,
+                              const char *pData,
+                              size_t len );
+static ExecCmd *GetExecCmd( ExecVarsState *pState, ExecVar *pExecVar );
+FILE *popen2( const char *command,
+              char * const *argv,
+              const char *mode,
+              pid_t *pid );
+static ExtractRule *GetExtractRule( ExecVar *pExecVar );
+static char *BuildCmdKey( const ExecDef *pDef );
+static uint32_t HashString( const char *str );
+static uint64_t HashString64( const char *str );
+static int AddExecVar( ExecVarsState *pState,
+                       const char *varname,
+                       ExecCmd *pExecCmd,
+                       ExtractRule *pExtract,
+                       ExecTemplate *pExecTemplate,
+                       ExecGroup *pExecGroup );
+static ExecVar *FindExecVar( ExecVarsState *pState, VAR_HANDLE hVar );
+static ExecVar *FindExecVarByName( ExecVarsState *pState,
+                                   const char *varname,
+                                   uint32_t hash );
+static int RegisterExecVars( ExecVarsState *pState, int max );
+static void UnlinkExecVar( ExecVarsState *pState, ExecVar *pExecVar );
+static void SetupDependencies( ExecCmd *pExecCmd, const ExecDef *pDef );
+static void InvalidateCache( const char *path, void *arg );
+static void NetworkChanged( const char *ifname, void *arg );
+static void RefreshExecVars( ExecVarsState *pState );
+static int RenderToCache( ExecVarsState *pState, ExecCmd *pExecCmd, int fd );
+static int FetchShared( ExecVarsState *pState, ExecCmd *pExecCmd );
+static void LoadSnapshot( ExecVarsState *pState );
+static int RestoreOutput( const SnapshotEntry *pEntry, void *arg );
+static void SaveSnapshot( ExecVarsState *pState );
+static int SnapshotTimeout( ExecVarsState *pState );
+static bool CacheIsValid( ExecCmd *pExecCmd );
+static int OutputValue( ExecVar *pExecVar, OutputBuffer *pOutput, int fd );
+static int GetValue( ExecVar *pExecVar,
+                     char *pData,
+                     size_t len,
+                     const char **ppValue,
+                     size_t *pValueLen );
+static uint64_t GetTimeMs( void );
+static uint64_t GetTimeNs( void );
+static int RunCommand( ExecVarsState *pState,
+                       ExecCmd *pExecCmd,
+                       int fd,
+                       OutputBuffer *pCapture );
+static void DumpStats( ExecVarsState *pState );
+static int ExecuteVar( ExecVarsState *pState,
+                       VAR_HANDLE hVar,
+                       int sig,
+                       int fd );
+static int ExecuteCommand( const char *cmd,
+                           char * const *argv,
+                           int fd,
+                           int timeout_seconds,
+                           OutputBuffer *pCapture,
+                           int *pStatus );
+static int ExecuteCommandInfiniteWait( const char *cmd,
+                                       char * const *argv,
+                                       int fd,
+                                       OutputBuffer *pCapture,
+                                       int *pStatus );
+static int ExecuteCommandWithTimeout( const char *cmd,
+                                      char * const *argv,
+                                      int fd,
+                                      int timeout_seconds,
+                                      OutputBuffer *pCapture,
+                                      int *pStatus );
+static int WaitCommand( pid_t pid, int *pStatus );
+static void KillCommand( pid_t pid );
+static void CancelCommand( int fd, pid_t pid );
+static int GetClientFd( int fd );
+static bool ClientGone( int fd );
+static void WriteOutput( int fd,
+                         char *buf,
+                         size_t len,
+                         OutputBuffer *pCapture );
+static int WriteFully( int fd, const char *buf, size_t len );
+static int RelayOutput( int fd,
+                        char *buf,
+                        size_t len,
+                        OutputBuffer *pCapture,
+                        size_t *pTotal );
+static size_t LimitOutput( size_t maxOutput, size_t *pTotal, size_t len );
+static void SendOutput( int fd,
+                        OutputBuffer *pOutput,
+                        OutputBuffer *pCapture );
+static bool GrowOutput( OutputBuffer *pBuffer, size_t size );
+static void ShareOutput( OutputBuffer *pDst, OutputBuffer *pSrc );
+static bool OutputShared( OutputBuffer *pBuffer );
+static OutputChunk *GetChunk( char *pData );
+static void FreeOutput( OutputBuffer *pBuffer );
+static int OutputClass( size_t size );
+static void SetupTerminationHandler( void );
+static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  main                                                                    */
+/*!
+    Main entry point for the execvars application
+
+    The main function starts the execvars application
+
+    @param[in]
+        argc
+            number of arguments on the command line
+            (including the command itself)
+
+    @param[in]
+        argv
+            array of pointers to the command line arguments
+
+    @return none
+
+============================================================================*/
+void main(int argc, char **argv)
+{
+    int sigfd;
+    size_t size;
+    int i;
+
+    /* clear the execvars state object */
+    memset( &state, 0, sizeof( state ) );
+    state.ppPendingTail = &state.pPending;
+    state.pExecVarPool = POOL_Create( sizeof( ExecVar ), POOL_CHUNK_SIZE );
+    state.pExecCmdPool = POOL_Create( sizeof( ExecCmd ), POOL_CHUNK_SIZE );
+    state.queueDepth = DEFAULT_QUEUE_DEPTH;
+    state.maxClients = DEFAULT_MAX_CLIENTS;
+    state.breakerFailures = DEFAULT_BREAKER_FAILURES;
+    state.breakerCooldown = DEFAULT_BREAKER_COOLDOWN;
+    state.maxOutput = DEFAULT_MAX_OUTPUT;
+    state.snapshotInterval = DEFAULT_SNAPSHOT_INTERVAL;
+
+    if( argc < 3 )
+    {
+        usage( argv[0] );
+        exit( 1 );
+    }
+
+    /* set up an abnormal termination handler */
+    SetupTerminationHandler();
+
+    /* process the command line options */
+    ProcessOptions( argc, argv, &state );
+
+    if( ( state.pFileName == NULL ) &&
+        ( state.pDirName == NULL ) )
+    {
+        usage( argv[0] );
+        exit( 1 );
+    }
+
+    if( state.compile == true )
+    {
+        /* compile the configuration file into a binary image */
+        if( state.pOutFileName == NULL )
+        {
+            usage( argv[0] );
+            exit( 1 );
+        }
+
+        exit( ( CONFIG_Compile( state.pFileName,
+                                state.pOutFileName ) == EOK ) ? 0 : 1 );
+    }
+
+    /* set up the file dependency watcher */
+    if( WATCH_Init() != EOK )
+    {
+        syslog( LOG_ERR, "Unable to initialize file dependency watcher\n" );
+    }
+
+    /* set up the output chunk pools, allocating the small chunks
+       several at a time */
+    for( i = 0; i < OUTPUT_CLASSES; i++ )
+    {
+        size = (size_t)OUTPUT_CLASS_MIN << ( 2 * i );
+        state.pOutputPool[i] = POOL_Create( sizeof( OutputChunk ) + size,
+                                            ( size < OUTPUT_CHUNK_SIZE )
+                                                ? OUTPUT_CHUNK_SIZE / size
+                                                : 1 );
+    }
+
+    /* set up the shared result cache */
+    if( state.pShmName != NULL )
+    {
+        state.pShmCache = SHMCACHE_Open( state.pShmName,
+                                         DEFAULT_SHMCACHE_ENTRIES );
+        if( state.pShmCache == NULL )
+        {
+            syslog( LOG_ERR, "Unable to open the shared result cache\n" );
+        }
+    }
+
+    /* set up the bounded print request queues */
+    for( i = 0; i < PRIORITY_CLASSES; i++ )
+    {
+        state.pQueue[i] = calloc( state.queueDepth, sizeof( PrintRequest ) );
+        if( state.pQueue[i] == NULL )
+        {
+            syslog( LOG_ERR, "Unable to allocate the print request queue\n" );
+            exit( 1 );
+        }
+    }
+
+    /* block the signals handled by the event loop */
+    sigfd = SetupSignalfd( &state );
+
+    /* a client which goes away is detected from the EPIPE write error */
+    signal( SIGPIPE, SIG_IGN );
+
+    /* get a handle to the VAR server */
+    state.hVarServer = VARSERVER_Open();
+    if( state.hVarServer != NULL )
+    {
+        /* set up the configuration sources.  Each configuration file
+           is reloaded on its own when it changes */
+        if( state.pFileName != NULL )
+        {
+            AddConfigSource( &state, state.pFileName, false );
+        }
+
+        if( state.pDirName != NULL )
+        {
+            /* rescan the configuration directory when it changes */
+            state.rescan = true;
+            WATCH_Add( state.pDirName, ConfigDirChanged, &state );
+        }
+
+        /* set up the exec vars from the configuration files */
+        LoadConfig( &state );
+
+        /* start with the still valid output of the previous run */
+        LoadSnapshot( &state );
+
+        /* process print requests and change events */
+        RunEventLoop( &state, sigfd );
+
+        /* keep the cached output for the next run */
+        SaveSnapshot( &state );
+
+        /* close the variable server */
+        if ( VARSERVER_Close( state.hVarServer ) == EOK )
+        {
+            state.hVarServer = NULL;
+        }
+    }
+
+    SHMCACHE_Close( state.pShmCache );
+}
+
+/*==========================================================================*/
+/*  SetupSignalfd                                                           */
+/*!
+    Set up the signal file descriptor
+
+    The SetupSignalfd function blocks the signals sent by the variable
+    server, the SIGUSR1 statistics request signal, and the SIGHUP
+    configuration reload signal, and creates a
+    signal file descriptor to receive them, so that they can be waited
+    on together with the other event sources.  If a cache snapshot is
+    kept, the SIGTERM and SIGINT termination signals are received the
+    same way, so the snapshot is written before the service exits.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval the signal file descriptor
+    @retval -1 - the signal file descriptor could not be created
+
+============================================================================*/
+static int SetupSignalfd( ExecVarsState *pState )
+{
+    sigset_t mask;
+    int fd;
+
+    sigemptyset( &mask );
+    sigaddset( &mask, SIG_VAR_PRINT );
+    sigaddset( &mask, SIGUSR1 );
+    sigaddset( &mask, SIGHUP );
+
+    if( pState->pSnapshotName != NULL )
+    {
+        sigaddset( &mask, SIGTERM );
+        sigaddset( &mask, SIGINT );
+    }
+
+    /* block the signals so they are only delivered via the signalfd */
+    sigprocmask( SIG_BLOCK, &mask, NULL );
+
+    fd = signalfd( -1, &mask, SFD_NONBLOCK | SFD_CLOEXEC );
+    if( fd == -1 )
+    {
+        syslog( LOG_ERR, "Unable to create signalfd: %s\n", strerror( errno ) );
+    }
+
+    return fd;
+}
+
+/*==========================================================================*/
+/*  RunEventLoop                                                            */
+/*!
+    Run the execvars event loop
+
+    The RunEventLoop function waits for print requests from the variable
+    server, file dependency changes, network interface changes, and
+    configuration reload requests, and dispatches them as they arrive.
+    File dependency changes and configuration reloads are applied before
+    print requests received at the same time, so a stale cached value
+    or removed definition is never served.
+
+    Newly defined exec variables are registered with the variable server
+    in batches between events, so the service answers print requests for
+    the variables already registered while a large configuration is still
+    being registered.
+
+    Print sessions whose client has not accepted all of their output yet
+    are waited on for space in their output streams, so a slow client
+    never blocks the service.
+
+    Print requests are drained from the signal file descriptor into the
+    bounded print request queue, and one queued request is served per
+    iteration, so new requests are admitted or shed between requests
+    rather than piling up behind the service.  Queued requests are
+    served in priority order, with weighted fair sharing between the
+    priority classes.
+
+    If a cache snapshot is kept, it is written periodically between
+    events, and the event loop returns when a termination signal is
+    received.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        sigfd
+            signal file descriptor receiving variable server signals
+
+    @return none
+
+============================================================================*/
+static void RunEventLoop( ExecVarsState *pState, int sigfd )
+{
+    struct pollfd *fds;
+    struct signalfd_siginfo info[MAX_SIGNAL_BATCH];
+    bool terminate = false;
+    int timeout;
+    int snapshot;
+    int count;
+    int n;
+    int i;
+
+    while( terminate == false )
+    {
+        /* event sources may be created when the configuration is
+           reloaded, and print sessions come and go */
+        n = SetupPollFds( pState );
+        fds = pState->pPollFds;
+        fds[0].fd = sigfd;
+
+        /* don't block while there are exec vars waiting to be
+           registered with the variable server, or print requests
+           ready to be served, and wake up for the parked print
+           requests and the periodic cache snapshot */
+        timeout = ( pState->nPending > 0 ) ? 0 : QueueTimeout( pState );
+        snapshot = SnapshotTimeout( pState );
+        if( ( timeout < 0 ) ||
+            ( ( snapshot >= 0 ) && ( snapshot < timeout ) ) )
+        {
+            timeout = snapshot;
+        }
+
+        if( poll( fds, n, timeout ) < 0 )
+        {
+            if( errno != EINTR )
+            {
+                syslog( LOG_ERR, "poll failed: %s\n", strerror( errno ) );
+                break;
+            }
+
+            continue;
+        }
+
+        if( SnapshotTimeout( pState ) == 0 )
+        {
+            /* write the periodic cache snapshot */
+            SaveSnapshot( pState );
+        }
+
+        /* send the pending output of the print sessions */
+        ServiceSessions( pState, n );
+
+        if( fds[1].revents & POLLIN )
+        {
+            /* apply file dependency changes */
+            WATCH_Process();
+        }
+
+        if( fds[2].revents & POLLIN )
+        {
+            /* refresh the execvars affected by network changes */
+            NETEVENT_Process( NetworkChanged, pState );
+            RefreshExecVars( pState );
+        }
+
+        /* drain the signals so the backlog is held in the bounded
+           print request queue rather than by the kernel */
+        do
+        {
+            /* queue the print requests behind any reload request */
+            count = 0;
+            while( ( fds[0].revents & POLLIN ) &&
+                   ( count < MAX_SIGNAL_BATCH ) &&
+                   ( read( sigfd, &info[count], sizeof( info[0] ) )
+                        == sizeof( info[0] ) ) )
+            {
+                if( info[count].ssi_signo == SIGHUP )
+                {
+                    RequestReload( pState );
+                }
+                else if( info[count].ssi_signo == SIGUSR1 )
+                {
+                    DumpStats( pState );
+                }
+                else if( ( info[count].ssi_signo == SIGTERM ) ||
+                         ( info[count].ssi_signo == SIGINT ) )
+                {
+                    terminate = true;
+                }
+                else
+                {
+                    count++;
+                }
+            }
+
+            if( pState->reload == true )
+            {
+                pState->reload = false;
+                LoadConfig( pState );
+            }
+
+            for( i = 0; i < count; i++ )
+            {
+                if( info[i].ssi_signo == (uint32_t)SIG_VAR_PRINT )
+                {
+                    AdmitRequest( pState, info[i].ssi_int );
+                }
+            }
+        } while( count == MAX_SIGNAL_BATCH );
+
+        /* serve the next queued print request */
+        ServeRequest( pState );
+
+        /* register the next batch of exec vars */
+        RegisterExecVars( pState, REGISTER_BATCH );
+    }
+}
+
+/*==========================================================================*/
+/*  AdmitRequest                                                            */
+/*!
+    Admit a print request
+
+    The AdmitRequest function opens a print session for a print request
+    and queues it to be served.  If the print request queue is full, or
+    the requested exec variable already has its maximum number of print
+    requests waiting or sending output, the request is shed immediately
+    instead: it is served from the variable's stale cached output if
+    there is any, and otherwise the client receives the BUSY_MARKER.
+    When the queue is full, a request makes room for itself by shedding
+    the newest queued request of a lower priority class.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        sigval
+            print session identifier received with the print signal
+
+    @return none
+
+============================================================================*/
+static void AdmitRequest( ExecVarsState *pState, int sigval )
+{
+    PrintRequest request;
+    PrintRequest evicted;
+    ExecVar *pExecVar;
+    PriorityClass priority;
+    int i;
+
+    /* open a print session */
+    request.sigval = sigval;
+    request.queued_ms = GetTimeMs();
+    request.notBefore_ms = 0;
+    if( VAR_OpenPrintSession( pState->hVarServer,
+                              sigval,
+                              &request.hVar,
+                              &request.fd ) != EOK )
+    {
+        return;
+    }
+
+    pExecVar = FindExecVar( pState, request.hVar );
+    priority = GetPriority( pExecVar );
+
+    if( ( pExecVar != NULL ) &&
+        ( pExecVar->clients >= pState->maxClients ) )
+    {
+        /* fail fast rather than adding to the backlog */
+        ShedRequest( pState, &request, pExecVar );
+        return;
+    }
+
+    for( i = PRIORITY_LOW;
+         ( i < (int)priority ) &&
+         ( pState->queueCount >= pState->queueDepth );
+         i++ )
+    {
+        if( pState->queueLength[i] > 0 )
+        {
+            /* make room by shedding the newest lower priority request */
+            pState->queueLength[i]--;
+            pState->queueCount--;
+            evicted = pState->pQueue[i][( pState->queueHead[i] +
+                                          pState->queueLength[i] ) %
+                                        pState->queueDepth];
+
+            ShedRequest( pState,
+                         &evicted,
+                         FindExecVar( pState, evicted.hVar ) );
+            ReleaseClient( pState, evicted.hVar );
+        }
+    }
+
+    if( pState->queueCount >= pState->queueDepth )
+    {
+        ShedRequest( pState, &request, pExecVar );
+        return;
+    }
+
+    i = ( pState->queueHead[priority] + pState->queueLength[priority] ) %
+        pState->queueDepth;
+    pState->pQueue[priority][i] = request;
+    pState->queueLength[priority]++;
+    pState->queueCount++;
+
+    if( pExecVar != NULL )
+    {
+        pExecVar->clients++;
+    }
+}
+
+/*==========================================================================*/
+/*  ShedRequest                                                             */
+/*!
+    Shed a print request
+
+    The ShedRequest function counts a print request which was shed by
+    admission control, and answers it without executing its variable.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pRequest
+            pointer to the print request to shed
+
+    @param[in]
+       pExecVar
+            pointer to the requested exec variable, or NULL
+
+    @return none
+
+============================================================================*/
+static void ShedRequest( ExecVarsState *pState,
+                         PrintRequest *pRequest,
+                         ExecVar *pExecVar )
+{
+    pState->shedCount++;
+    if( pExecVar != NULL )
+    {
+        pExecVar->shedCount++;
+    }
+
+    if( pState->verbose == true )
+    {
+        printf( "saturated: shedding print request for %s\n",
+                ( pExecVar != NULL ) ? pExecVar->pName : "unknown" );
+    }
+
+    HandlePrintRequest( pState, pRequest, false );
+}
+
+/*==========================================================================*/
+/*  ServeRequest                                                            */
+/*!
+    Serve the next queued print request
+
+    The ServeRequest function removes the next print request of the
+    priority class chosen by the scheduler from the print request queue,
+    if there is one, and renders it.  A print request which cannot be
+    served yet is parked at the back of its priority class until the
+    time it asked for.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void ServeRequest( ExecVarsState *pState )
+{
+    PrintRequest *pQueue;
+    PrintRequest request;
+    int depth = pState->queueDepth;
+    uint64_t now_ms;
+    int head;
+    int n;
+    int i;
+
+    now_ms = GetTimeMs();
+    i = NextPriority( pState, now_ms );
+    if( i >= 0 )
+    {
+        pQueue = pState->pQueue[i];
+        head = pState->queueHead[i];
+        n = NextRequest( pState, i, now_ms );
+        request = pQueue[( head + n ) % depth];
+
+        /* close the gap left by the request, keeping the queue order */
+        for( ; n > 0; n-- )
+        {
+            pQueue[( head + n ) % depth] = pQueue[( head + n - 1 ) % depth];
+        }
+
+        pState->queueHead[i] = ( head + 1 ) % depth;
+        pState->queueLength[i]--;
+        pState->queueCount--;
+
+        if( HandlePrintRequest( pState, &request, true ) == false )
+        {
+            /* the slot the request was served from is still free */
+            request.notBefore_ms = pState->defer_ms;
+            pQueue[( pState->queueHead[i] + pState->queueLength[i] ) %
+                   depth] = request;
+            pState->queueLength[i]++;
+            pState->queueCount++;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  NextPriority                                                            */
+/*!
+    Choose the priority class of the next print request to serve
+
+    The NextPriority function implements weighted fair scheduling of the
+    print request queue.  In each scheduling round, every priority class
+    may have up to its weight of print requests served.  The highest
+    priority class with queued requests and remaining credit is chosen,
+    and a new round is started once no class with queued requests has
+    credit left, so a lower priority class always gets its share.
+    Parked print requests are not counted until they are due.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        now_ms
+            current monotonic time in milliseconds
+
+    @retval the priority class to serve
+    @retval -1 - there are no queued print requests ready to be served
+
+============================================================================*/
+static int NextPriority( ExecVarsState *pState, uint64_t now_ms )
+{
+    int round;
+    int i;
+
+    for( round = 0; ( round < 2 ) && ( pState->queueCount > 0 ); round++ )
+    {
+        for( i = PRIORITY_HIGH; i >= PRIORITY_LOW; i-- )
+        {
+            if( ( pState->credits[i] > 0 ) &&
+                ( NextRequest( pState, i, now_ms ) >= 0 ) )
+            {
+                pState->credits[i]--;
+                return i;
+            }
+        }
+
+        /* start a new scheduling round */
+        for( i = PRIORITY_LOW; i < PRIORITY_CLASSES; i++ )
+        {
+            pState->credits[i] = priorities[i].weight;
+        }
+    }
+
+    return -1;
+}
+
+/*==========================================================================*/
+/*  NextRequest                                                             */
+/*!
+    Choose the next print request to serve within a priority class
+
+    The NextRequest function chooses the oldest print request of a
+    priority class, or, if shortest expected job first scheduling is
+    enabled, the request whose expected execution time less the time it
+    has been waiting is the smallest.  Cheap requests are then not held
+    up behind expensive ones, while the waiting time ages an expensive
+    request until it is served, so it is never starved.  Parked print
+    requests which are not due yet are passed over.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        priority
+            priority class with queued print requests
+
+    @param[in]
+        now_ms
+            current monotonic time in milliseconds
+
+    @retval position of the print request in the priority class queue
+    @retval -1 - no print request of the priority class is due
+
+============================================================================*/
+static int NextRequest( ExecVarsState *pState,
+                        int priority,
+                        uint64_t now_ms )
+{
+    PrintRequest *pRequest;
+    int64_t score;
+    int64_t best = 0;
+    int n = -1;
+    int i;
+
+    for( i = 0; i < pState->queueLength[priority]; i++ )
+    {
+        pRequest = &pState->pQueue[priority][( pState->queueHead[priority]
+                                               + i ) %
+                                             pState->queueDepth];
+        if( pRequest->notBefore_ms > now_ms )
+        {
+            continue;
+        }
+
+        if( pState->shortestFirst == false )
+        {
+            /* serve the oldest request which is due */
+            return i;
+        }
+
+        score = (int64_t)ExpectedCost( pState, pRequest->hVar ) -
+                (int64_t)( now_ms - pRequest->queued_ms ) * 1000;
+        if( ( n < 0 ) || ( score < best ) )
+        {
+            best = score;
+            n = i;
+        }
+    }
+
+    return n;
+}
+
+/*==========================================================================*/
+/*  QueueTimeout                                                            */
+/*!
+    Get the time until the next queued print request is due
+
+    The QueueTimeout function gets the time the event loop may wait for
+    events before a queued print request is ready to be served.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval time in milliseconds until the first parked print request
+            is due
+    @retval 0 - a print request is ready to be served
+    @retval -1 - there are no queued print requests
+
+============================================================================*/
+static int QueueTimeout( ExecVarsState *pState )
+{
+    PrintRequest *pRequest;
+    uint64_t now_ms;
+    uint64_t due_ms = UINT64_MAX;
+    int priority;
+    int i;
+
+    if( pState->queueCount == 0 )
+    {
+        return -1;
+    }
+
+    for( priority = PRIORITY_LOW; priority < PRIORITY_CLASSES; priority++ )
+    {
+        for( i = 0; i < pState->queueLength[priority]; i++ )
+        {
+            pRequest = &pState->pQueue[priority][( pState->queueHead[priority]
+                                                   + i ) %
+                                                 pState->queueDepth];
+            if( pRequest->notBefore_ms < due_ms )
+            {
+                due_ms = pRequest->notBefore_ms;
+            }
+        }
+    }
+
+    now_ms = GetTimeMs();
+    if( now_ms >= due_ms )
+    {
+        return 0;
+    }
+
+    return ( due_ms - now_ms < INT_MAX ) ? (int)( due_ms - now_ms )
+                                         : INT_MAX;
+}
+
+/*==========================================================================*/
+/*  DeferRequest                                                            */
+/*!
+    Park the print request being rendered
+
+    The DeferRequest function asks for the print request being rendered
+    to be parked in the print request queue and rendered again once the
+    given time has passed, so the event loop keeps serving the other
+    print requests meanwhile.  It must be called before any output of
+    the print request has been written.  Only a print request rendered
+    into a print session can be parked.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        until_ms
+            monotonic time in milliseconds at which the print request is
+            rendered again
+
+    @retval true - the print request is parked
+    @retval false - there is no print request which can be parked
+
+============================================================================*/
+static bool DeferRequest( ExecVarsState *pState, uint64_t until_ms )
+{
+    if( pState->pSession == NULL )
+    {
+        return false;
+    }
+
+    pState->defer_ms = until_ms;
+    return true;
+}
+
+/*==========================================================================*/
+/*  ExpectedCost                                                            */
+/*!
+    Estimate the execution time of a print request
+
+    The ExpectedCost function estimates the time in microseconds needed
+    to render an exec variable from the running average execution time
+    of its command.  A variable which can be served from the cache costs
+    nothing, and a group costs as much as its most expensive member, as
+    its members are rendered concurrently.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        hVar
+            handle of the requested variable
+
+    @retval expected execution time in microseconds
+
+============================================================================*/
+static uint64_t ExpectedCost( ExecVarsState *pState, VAR_HANDLE hVar )
+{
+    ExecVar *pExecVar;
+    uint64_t cost = 0;
+    uint64_t memberCost;
+    int i;
+
+    pExecVar = FindExecVar( pState, hVar );
+    if( pExecVar == NULL )
+    {
+        return 0;
+    }
+
+    if( pExecVar->pGroup != NULL )
+    {
+        for( i = 0; i < pExecVar->pGroup->nMembers; i++ )
+        {
+            memberCost = ExpectedCmdCost(
+                            pExecVar->pGroup->ppMembers[i]->pExecCmd );
+            if( memberCost > cost )
+            {
+                cost = memberCost;
+            }
+        }
+    }
+    else
+    {
+        cost = ExpectedCmdCost( pExecVar->pExecCmd );
+    }
+
+    return cost;
+}
+
+/*==========================================================================*/
+/*  ExpectedCmdCost                                                         */
+/*!
+    Estimate the execution time of an exec command
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command, or NULL if it has not been
+            bound yet
+
+    @retval 0 - the output can be served from the cache, or the
+                command has no execution history
+    @retval running average execution time in microseconds
+
+============================================================================*/
+static uint64_t ExpectedCmdCost( ExecCmd *pExecCmd )
+{
+    return ( ( pExecCmd == NULL ) ||
+             ( ( pExecCmd->nRefs == 0 ) &&
+               ( CacheIsValid( pExecCmd ) == true ) ) )
+                ? 0
+                : pExecCmd->avgTime_us;
+}
+
+/*==========================================================================*/
+/*  GetPriority                                                             */
+/*!
+    Get the priority class of an exec variable
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable, or NULL
+
+    @retval the priority class of the exec variable's definition
+
+============================================================================*/
+static PriorityClass GetPriority( ExecVar *pExecVar )
+{
+    PriorityClass priority = PRIORITY_NORMAL;
+
+    if( pExecVar != NULL )
+    {
+        if( pExecVar->pGroup != NULL )
+        {
+            priority = pExecVar->pGroup->priority;
+        }
+        else if( pExecVar->pExecCmd != NULL )
+        {
+            priority = pExecVar->pExecCmd->priority;
+        }
+        else if( pExecVar->pTemplate != NULL )
+        {
+            priority = pExecVar->pTemplate->def.priority;
+        }
+    }
+
+    return priority;
+}
+
+/*==========================================================================*/
+/*  HandlePrintRequest                                                      */
+/*!
+    Handle a print request
+
+    The HandlePrintRequest function renders a print request into its
+    print session, and closes the print session once all of its output
+    has been sent.  Output which the client cannot accept yet is sent
+    from the event loop.  A print request which asked to be parked is
+    left open for the caller to queue again.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pRequest
+            pointer to the print request to handle
+
+    @param[in]
+        admitted
+            true if the print request was admitted, false if it was shed
+
+    @retval true - the print request was served
+    @retval false - the print request is parked until pState->defer_ms
+
+============================================================================*/
+static bool HandlePrintRequest( ExecVarsState *pState,
+                                PrintRequest *pRequest,
+                                bool admitted )
+{
+    PrintSession *pSession;
+    int flags;
+
+    pSession = calloc( 1, sizeof( PrintSession ) );
+    if( pSession == NULL )
+    {
+        /* render the variable directly into the output stream */
+        RenderRequest( pState, pRequest, admitted );
+        VAR_ClosePrintSession( pState->hVarServer,
+                               pRequest->sigval,
+                               pRequest->fd );
+        if( admitted == true )
+        {
+            ReleaseClient( pState, pRequest->hVar );
+        }
+
+        return true;
+    }
+
+    pSession->sigval = pRequest->sigval;
+    pSession->hVar = pRequest->hVar;
+    pSession->fd = pRequest->fd;
+    pSession->admitted = admitted;
+
+    /* output which the client cannot accept yet is queued */
+    flags = fcntl( pSession->fd, F_GETFL );
+    if( flags != -1 )
+    {
+        fcntl( pSession->fd, F_SETFL, flags | O_NONBLOCK );
+    }
+
+    /* render the variable */
+    pState->pSession = pSession;
+    pState->defer_ms = 0;
+    RenderRequest( pState, pRequest, admitted );
+    pState->pSession = NULL;
+
+    if( pState->defer_ms != 0 )
+    {
+        /* nothing was written, so the print session stays open */
+        free( pSession );
+        return false;
+    }
+
+    if( FlushSession( pSession ) == true )
+    {
+        /* all of the output was sent */
+        CloseSession( pState, pSession );
+    }
+    else
+    {
+        /* send the rest of the output from the event loop */
+        pSession->pNext = pState->pSessions;
+        pState->pSessions = pSession;
+        pState->nSessions++;
+    }
+
+    return true;
+}
+
+/*==========================================================================*/
+/*  RenderRequest                                                           */
+/*!
+    Render a print request
+
+    The RenderRequest function executes the variable of an admitted print
+    request.  A shed print request is served from the variable's stale
+    cached output instead, or is answered with the BUSY_MARKER if there
+    is none.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pRequest
+            pointer to the print request to render
+
+    @param[in]
+        admitted
+            true if the print request was admitted, false if it was shed
+
+    @return none
+
+============================================================================*/
+static void RenderRequest( ExecVarsState *pState,
+                           PrintRequest *pRequest,
+                           bool admitted )
+{
+    if( admitted == true )
+    {
+        ExecuteVar( pState, pRequest->hVar, SIG_VAR_PRINT, pRequest->fd );
+    }
+    else if( ServeStale( pState, pRequest->hVar, pRequest->fd ) != EOK )
+    {
+        WriteOutput( pRequest->fd,
+                     BUSY_MARKER,
+                     strlen( BUSY_MARKER ),
+                     NULL );
+    }
+}
+
+/*==========================================================================*/
+/*  ServeStale                                                              */
+/*!
+    Serve a variable from its cached output without executing it
+
+    The ServeStale function writes the value of an exec variable from its
+    command's cached output, even if the cached output has expired or has
+    been invalidated.  It is used to answer print requests which were
+    shed when the service is saturated.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        hVar
+            handle of the variable to serve
+
+    @param[in]
+        fd
+            output file descriptor to write the value to
+
+    @retval EOK - the cached value was written
+    @retval ENOENT - there is no cached value
+
+============================================================================*/
+static int ServeStale( ExecVarsState *pState, VAR_HANDLE hVar, int fd )
+{
+    int result = ENOENT;
+    ExecVar *pExecVar;
+
+    pExecVar = FindExecVar( pState, hVar );
+    if( pExecVar != NULL )
+    {
+        result = OutputLastGood( pExecVar, fd );
+        if( result == EOK )
+        {
+            pExecVar->staleHits++;
+            pState->staleHits++;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  OutputLastGood                                                          */
+/*!
+    Write an exec variable's last good value to the output stream
+
+    The OutputLastGood function writes the value of an exec variable
+    from the last successful output of its command which was cached,
+    even if the cached output has expired or has been invalidated.
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable to render
+
+    @param[in]
+        fd
+            output file descriptor to write the value to
+
+    @retval EOK - the last good value was written
+    @retval ENOENT - there is no last good value
+
+============================================================================*/
+static int OutputLastGood( ExecVar *pExecVar, int fd )
+{
+    int result = ENOENT;
+    ExecCmd *pExecCmd = pExecVar->pExecCmd;
+
+    if( ( pExecVar->pGroup == NULL ) &&
+        ( pExecCmd != NULL ) &&
+        ( ( pExecCmd->cacheValid == true ) ||
+          ( pExecCmd->cacheStale == true ) ) )
+    {
+        result = OutputValue( pExecVar, &pExecCmd->cache, fd );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ReleaseClient                                                           */
+/*!
+    Release an admitted print request's place in its client limit
+
+    The ReleaseClient function is called when the print session of an
+    admitted print request is closed, to allow another print request
+    for the same exec variable to be admitted.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        hVar
+            handle of the variable which was printed
+
+    @return none
+
+============================================================================*/
+static void ReleaseClient( ExecVarsState *pState, VAR_HANDLE hVar )
+{
+    ExecVar *pExecVar;
+
+    /* the exec variable may have been dropped by a reload */
+    pExecVar = FindExecVar( pState, hVar );
+    if( ( pExecVar != NULL ) &&
+        ( pExecVar->clients > 0 ) )
+    {
+        pExecVar->clients--;
+    }
+}
+
+/*==========================================================================*/
+/*  SetupPollFds                                                            */
+/*!
+    Set up the poll descriptors of the event loop
+
+    The SetupPollFds function sets up the poll descriptors of the event
+    loop: the signal file descriptor (which is filled in by the caller),
+    the file dependency watcher, the network event source, and the output
+    stream of every print session with output waiting to be sent.
+    Negative descriptors are ignored by poll.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval number of poll descriptors
+
+============================================================================*/
+static int SetupPollFds( ExecVarsState *pState )
+{
+    PrintSession *pSession;
+    struct pollfd *pfds;
+    int size;
+    int n;
+
+    size = 3 + pState->nSessions;
+    if( ( pState->pPollFds == NULL ) ||
+        ( size > pState->pollSize ) )
+    {
+        pfds = realloc( pState->pPollFds, size * sizeof( struct pollfd ) );
+        if( pfds != NULL )
+        {
+            pState->pPollFds = pfds;
+            pState->pollSize = size;
+        }
+        else if( pState->pPollFds == NULL )
+        {
+            /* the event loop cannot run without its poll descriptors */
+            syslog( LOG_ERR, "Unable to allocate poll descriptors\n" );
+            exit( 1 );
+        }
+    }
+
+    pfds = pState->pPollFds;
+    memset( pfds, 0, pState->pollSize * sizeof( struct pollfd ) );
+
+    pfds[0].fd = -1;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = WATCH_GetFd();
+    pfds[1].events = POLLIN;
+    pfds[2].fd = NETEVENT_GetFd();
+    pfds[2].events = POLLIN;
+
+    n = 3;
+    for( pSession = pState->pSessions;
+         ( pSession != NULL ) && ( n < pState->pollSize );
+         pSession = pSession->pNext )
+    {
+        pfds[n].fd = pSession->fd;
+        pfds[n].events = POLLOUT;
+        n++;
+    }
+
+    return n;
+}
+
+/*==========================================================================*/
+/*  ServiceSessions                                                         */
+/*!
+    Send the pending output of the print sessions
+
+    The ServiceSessions function sends as much pending output as possible
+    to every print session whose output stream has space, or has failed,
+    and closes the print sessions whose output has all been sent.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        n
+            number of poll descriptors set up by SetupPollFds
+
+    @return none
+
+============================================================================*/
+static void ServiceSessions( ExecVarsState *pState, int n )
+{
+    PrintSession *pSession;
+    PrintSession *pNext;
+    int i = 3;
+
+    for( pSession = pState->pSessions;
+         ( pSession != NULL ) && ( i < n );
+         pSession = pNext, i++ )
+    {
+        pNext = pSession->pNext;
+
+        if( ( pState->pPollFds[i].revents != 0 ) &&
+            ( FlushSession( pSession ) == true ) )
+        {
+            CloseSession( pState, pSession );
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  QueueOutput                                                             */
+/*!
+    Send output to a print session
+
+    The QueueOutput function sends output to the client of a print
+    session.  Output which the client cannot accept immediately is queued
+    behind any output which is already waiting, in memory up to
+    SESSION_BUFFER_LIMIT bytes, and in a temporary file beyond that, so a
+    slow client costs memory in proportion to its backlog and never
+    blocks the service.  If nothing is waiting and the output is part of
+    the shared output being written, the session keeps a reference to
+    the shared output instead of copying it, so many slow clients of a
+    cached value cost no memory of their own.
+
+    @param[in,out]
+       pSession
+            pointer to the print session
+
+    @param[in]
+        buf
+            pointer to the output data
+
+    @param[in]
+        len
+            number of bytes of output data
+
+    @return none
+
+============================================================================*/
+static void QueueOutput( PrintSession *pSession, const char *buf, size_t len )
+{
+    OutputBuffer copy;
+    OutputBuffer *pShared = state.pShared;
+    ssize_t n;
+    size_t room;
+
+    if( pSession->failed == true )
+    {
+        return;
+    }
+
+    /* send directly to the client if nothing is waiting */
+    while( ( len > 0 ) &&
+           ( pSession->offset == pSession->pending.len ) &&
+           ( pSession->spillRead == pSession->spillWrite ) )
+    {
+        n = write( pSession->fd, buf, len );
+        if( n > 0 )
+        {
+            buf += n;
+            len -= n;
+        }
+        else if( ( n < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+        else if( ( n < 0 ) &&
+                 ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+        {
+            break;
+        }
+        else
+        {
+            pSession->failed = true;
+            return;
+        }
+    }
+
+    if( len == 0 )
+    {
+        return;
+    }
+
+    if( ( pSession->offset == pSession->pending.len ) &&
+        ( pSession->spillRead == pSession->spillWrite ) &&
+        ( pShared != NULL ) &&
+        ( buf >= pShared->pData ) &&
+        ( buf + len <= pShared->pData + pShared->len ) )
+    {
+        /* nothing else is waiting, so keep a reference to the shared
+           output instead of copying it */
+        ShareOutput( &pSession->pending, pShared );
+        pSession->offset = buf - pSession->pending.pData;
+        pSession->pending.len = pSession->offset + len;
+        pSession->pending.incomplete = false;
+        return;
+    }
+
+    if( ( pSession->offset > 0 ) &&
+        ( OutputShared( &pSession->pending ) == true ) )
+    {
+        /* take a copy of the unsent part of the shared output */
+        memset( &copy, 0, sizeof( copy ) );
+        WriteOutput( -1,
+                     &pSession->pending.pData[pSession->offset],
+                     pSession->pending.len - pSession->offset,
+                     &copy );
+        FreeOutput( &pSession->pending );
+        pSession->pending = copy;
+        pSession->offset = 0;
+    }
+    else if( pSession->offset > 0 )
+    {
+        /* discard the output which has been sent */
+        memmove( pSession->pending.pData,
+                 &pSession->pending.pData[pSession->offset],
+                 pSession->pending.len - pSession->offset );
+        pSession->pending.len -= pSession->offset;
+        pSession->offset = 0;
+    }
+
+    room = 0;
+    if( ( pSession->spillRead == pSession->spillWrite ) &&
+        ( pSession->pending.len < SESSION_BUFFER_LIMIT ) )
+    {
+        room = SESSION_BUFFER_LIMIT - pSession->pending.len;
+    }
+
+    if( room > len )
+    {
+        room = len;
+    }
+
+    /* hold as much as possible in memory, and spill the rest */
+    WriteOutput( -1, (char *)buf, room, &pSession->pending );
+    if( pSession->pending.incomplete == true )
+    {
+        pSession->failed = true;
+        return;
+    }
+
+    SpillOutput( pSession, &buf[room], len - room );
+}
+
+/*==========================================================================*/
+/*  SpillOutput                                                             */
+/*!
+    Spill the output of a print session to a temporary file
+
+    The SpillOutput function appends output which does not fit in the
+    memory of a print session to the session's temporary spill file,
+    creating the file when it is first needed.
+
+    @param[in,out]
+       pSession
+            pointer to the print session
+
+    @param[in]
+        buf
+            pointer to the output data
+
+    @param[in]
+        len
+            number of bytes of output data
+
+    @return none
+
+============================================================================*/
+static void SpillOutput( PrintSession *pSession, const char *buf, size_t len )
+{
+    ssize_t n;
+
+    if( len == 0 )
+    {
+        return;
+    }
+
+    if( pSession->fpSpill == NULL )
+    {
+        pSession->fpSpill = tmpfile();
+        if( pSession->fpSpill == NULL )
+        {
+            syslog( LOG_ERR,
+                    "Unable to create spill file: %s\n",
+                    strerror( errno ) );
+            pSession->failed = true;
+            return;
+        }
+    }
+
+    while( len > 0 )
+    {
+        n = pwrite( fileno( pSession->fpSpill ),
+                    buf,
+                    len,
+                    pSession->spillWrite );
+        if( n > 0 )
+        {
+            buf += n;
+            len -= n;
+            pSession->spillWrite += n;
+        }
+        else if( ( n < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+        else
+        {
+            syslog( LOG_ERR,
+                    "Unable to write spill file: %s\n",
+                    strerror( errno ) );
+            pSession->failed = true;
+            return;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  FlushSession                                                            */
+/*!
+    Send the pending output of a print session
+
+    The FlushSession function sends the pending output of a print session
+    to its client until the client cannot accept any more output.  The
+    output held in memory is sent first, followed by the output spilled
+    to the temporary file, which is read back into memory one buffer at
+    a time.
+
+    @param[in,out]
+       pSession
+            pointer to the print session
+
+    @retval true - all of the output was sent, or the client failed
+    @retval false - output is waiting for the client to accept it
+
+============================================================================*/
+static bool FlushSession( PrintSession *pSession )
+{
+    ssize_t n;
+    size_t chunk;
+
+    while( pSession->failed == false )
+    {
+        if( pSession->offset < pSession->pending.len )
+        {
+            n = write( pSession->fd,
+                       &pSession->pending.pData[pSession->offset],
+                       pSession->pending.len - pSession->offset );
+            if( n > 0 )
+            {
+                pSession->offset += n;
+            }
+            else if( ( n < 0 ) && ( errno == EINTR ) )
+            {
+                continue;
+            }
+            else if( ( n < 0 ) &&
+                     ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
+            {
+                return false;
+            }
+            else
+            {
+                pSession->failed = true;
+            }
+
+            continue;
+        }
+
+        pSession->pending.len = 0;
+        pSession->offset = 0;
+
+        if( pSession->spillRead == pSession->spillWrite )
+        {
+            /* everything has been sent */
+            pSession->spillRead = 0;
+            pSession->spillWrite = 0;
+            return true;
+        }
+
+        /* read the next buffer of spilled output back into memory */
+        chunk = SESSION_BUFFER_LIMIT;
+        if( (off_t)chunk > pSession->spillWrite - pSession->spillRead )
+        {
+            chunk = pSession->spillWrite - pSession->spillRead;
+        }
+
+        if( GrowOutput( &pSession->pending, chunk ) == false )
+        {
+            pSession->failed = true;
+            continue;
+        }
+
+        n = pread( fileno( pSession->fpSpill ),
+                   pSession->pending.pData,
+                   chunk,
+                   pSession->spillRead );
+        if( n > 0 )
+        {
+            pSession->pending.len = n;
+            pSession->spillRead += n;
+        }
+        else if( ( n < 0 ) && ( errno == EINTR ) )
+        {
+            continue;
+        }
+        else
+        {
+            pSession->failed = true;
+        }
+    }
+
+    return true;
+}
+
+/*==========================================================================*/
+/*  CloseSession                                                            */
+/*!
+    Close a print session
+
+    The CloseSession function closes a print session with the variable
+    server, removes it from the list of print sessions with pending
+    output, releases its output buffers, and releases its place in the
+    client limit of its exec variable.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pSession
+            pointer to the print session to close
+
+    @return none
+
+============================================================================*/
+static void CloseSession( ExecVarsState *pState, PrintSession *pSession )
+{
+    PrintSession **ppSession;
+
+    for( ppSession = &pState->pSessions;
+         *ppSession != NULL;
+         ppSession = &(*ppSession)->pNext )
+    {
+        if( *ppSession == pSession )
+        {
+            *ppSession = pSession->pNext;
+            pState->nSessions--;
+            break;
+        }
+    }
+
+    VAR_ClosePrintSession( pState->hVarServer,
+                           pSession->sigval,
+                           pSession->fd );
+
+    if( pSession->admitted == true )
+    {
+        ReleaseClient( pState, pSession->hVar );
+    }
+
+    if( pSession->fpSpill != NULL )
+    {
+        fclose( pSession->fpSpill );
+    }
+
+    FreeOutput( &pSession->pending );
+    free( pSession );
+}
+
+/*==========================================================================*/
+/*  LoadConfig                                                              */
+/*!
+    Load or reload the execvars configuration
+
+    The LoadConfig function loads the configuration files which have
+    changed since the previous load, and applies the configuration of
+    every configuration source to the live registry.  New exec variables
+    are queued to be registered with the variable server, existing exec
+    variables have their commands and extraction rules updated in place,
+    and exec variables which are no longer defined are dropped.  Commands
+    which are unchanged keep their cached output.  If a configuration
+    file cannot be loaded, the previous configuration of that file
+    is kept.
+
+    The registry borrows its names and command sequences from the
+    configuration images, so every surviving entry is re-pointed at a
+    current image before the replaced images are released.  The registry
+    entries are allocated from pools which are sized from the first
+    configuration loaded, so they are contiguous in memory.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval EOK - the configuration was loaded
+    @retval EINVAL - a configuration file could not be loaded
+
+============================================================================*/
+static int LoadConfig( ExecVarsState *pState )
+{
+    ConfigSource **ppSource;
+    ConfigSource *pSource;
+    ConfigImage *pImage;
+    size_t totalCmds = 0;
+    size_t totalVars = 0;
+    size_t nCmds;
+    size_t nVars;
+    int nFiles = 0;
+    int removed;
+    int result;
+
+    if( pState->rescan == true )
+    {
+        /* find the fragments which were added to or removed from
+           the configuration directory */
+        pState->rescan = false;
+        ScanConfigDir( pState );
+    }
+
+    /* parse the configuration files which have changed */
+    result = LoadConfigSources( pState );
+
+    for( pSource = pState->pSources;
+         pSource != NULL;
+         pSource = pSource->pNext )
+    {
+        pImage = ( pSource->pNewImage != NULL ) ? pSource->pNewImage
+                                                : pSource->pImage;
+        if( ( pSource->present == true ) &&
+            ( CONFIG_GetCounts( pImage, &nCmds, &nVars ) == EOK ) )
+        {
+            totalCmds += nCmds;
+            totalVars += nVars;
+            nFiles++;
+        }
+    }
+
+    if( pState->pExecVars == NULL )
+    {
+        /* size the registry so its entries are contiguous */
+        POOL_Reserve( pState->pExecCmdPool, totalCmds );
+        POOL_Reserve( pState->pExecVarPool, totalVars );
+    }
+
+    pState->generation++;
+    pState->added = 0;
+    pState->updated = 0;
+
+    /* set up the exec vars from the exec command definitions of every
+       configuration source, in order, so the first definition of a
+       variable wins */
+    for( pSource = pState->pSources;
+         pSource != NULL;
+         pSource = pSource->pNext )
+    {
+        if( pSource->present == true )
+        {
+            pImage = ( pSource->pNewImage != NULL ) ? pSource->pNewImage
+                                                    : pSource->pImage;
+            pState->pSource = pSource;
+            CONFIG_Iterate( pImage, SetupExecVar, (void *)pState );
+        }
+    }
+
+    pState->pSource = NULL;
+
+    /* drop the definitions which were not in the configuration */
+    removed = PurgeExecVars( pState );
+    PurgeExecCmds( pState );
+    PurgeTemplates( pState );
+    PurgeGroups( pState );
+
+    /* find the members of each group in the updated registry */
+    ResolveGroups( pState );
+
+    /* find the exec variables referenced by each command */
+    ResolveReferences( pState );
+
+    /* nothing refers to the replaced configuration images any more */
+    ppSource = &pState->pSources;
+    while( *ppSource != NULL )
+    {
+        pSource = *ppSource;
+
+        if( pSource->pNewImage != NULL )
+        {
+            CONFIG_Release( pSource->pImage );
+            pSource->pImage = pSource->pNewImage;
+            pSource->pNewImage = NULL;
+        }
+
+        if( pSource->present == false )
+        {
+            /* the fragment was removed from the configuration directory */
+            *ppSource = pSource->pNext;
+
+            WATCH_Remove( pSource );
+            CONFIG_Release( pSource->pImage );
+            free( pSource->pFileName );
+            free( pSource );
+        }
+        else
+        {
+            ppSource = &pSource->pNext;
+        }
+    }
+
+    syslog( LOG_INFO,
+            "Loaded %d configuration files: %d added, %d updated, %d removed\n",
+            nFiles,
+            pState->added,
+            pState->updated,
+            removed );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  LoadConfigSources                                                       */
+/*!
+    Load the configuration files which have changed
+
+    The LoadConfigSources function parses every configuration file which
+    has changed since it was last loaded.  The files are parsed in
+    parallel, and each new image is held in its configuration source
+    until the registry has been updated from it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval EOK - the configuration files were loaded
+    @retval EINVAL - a configuration file could not be loaded
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int LoadConfigSources( ExecVarsState *pState )
+{
+    ConfigSource *pSource;
+    ConfigSource **ppSources;
+    ConfigImage **ppImages;
+    char **ppFileNames;
+    int result = EOK;
+    int n = 0;
+    int i;
+
+    for( pSource = pState->pSources;
+         pSource != NULL;
+         pSource = pSource->pNext )
+    {
+        if( ( pSource->present == true ) &&
+            ( pSource->dirty == true ) )
+        {
+            n++;
+        }
+    }
+
+    if( n == 0 )
+    {
+        return EOK;
+    }
+
+    ppSources = calloc( n, sizeof( ConfigSource * ) );
+    ppImages = calloc( n, sizeof( ConfigImage * ) );
+    ppFileNames = calloc( n, sizeof( char * ) );
+    if( ( ppSources != NULL ) &&
+        ( ppImages != NULL ) &&
+        ( ppFileNames != NULL ) )
+    {
+        n = 0;
+        for( pSource = pState->pSources;
+             pSource != NULL;
+             pSource = pSource->pNext )
+        {
+            if( ( pSource->present == true ) &&
+                ( pSource->dirty == true ) )
+            {
+                ppSources[n] = pSource;
+                ppFileNames[n] = pSource->pFileName;
+                n++;
+            }
+        }
+
+        result = CONFIG_LoadAll( ppFileNames, ppImages, n );
+
+        for( i = 0; i < n; i++ )
+        {
+            pSource = ppSources[i];
+            pSource->dirty = false;
+            pSource->pNewImage = ppImages[i];
+            if( ppImages[i] == NULL )
+            {
+                /* keep the previous configuration of the file */
+                syslog( LOG_ERR, "Unable to load %s\n", pSource->pFileName );
+            }
+        }
+    }
+    else
+    {
+        result = ENOMEM;
+    }
+
+    free( ppSources );
+    free( ppImages );
+    free( ppFileNames );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  AddConfigSource                                                         */
+/*!
+    Add a configuration source
+
+    The AddConfigSource function adds a configuration file to the list of
+    configuration sources, and watches it so it is reloaded when it
+    changes.  The file specified with -f is always first, followed by the
+    configuration directory fragments in name order.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        filename
+            pointer to the NUL terminated name of the configuration file
+
+    @param[in]
+        fragment
+            true if the file is in the configuration directory
+
+    @retval pointer to the new configuration source
+    @retval NULL - memory allocation failed
+
+============================================================================*/
+static ConfigSource *AddConfigSource( ExecVarsState *pState,
+                                      const char *filename,
+                                      bool fragment )
+{
+    ConfigSource **ppSource = &pState->pSources;
+    ConfigSource *pSource;
+
+    pSource = calloc( 1, sizeof( ConfigSource ) );
+    if( pSource != NULL )
+    {
+        pSource->pFileName = strdup( filename );
+        if( pSource->pFileName == NULL )
+        {
+            free( pSource );
+            return NULL;
+        }
+
+        pSource->dirty = true;
+        pSource->present = true;
+        pSource->fragment = fragment;
+        pSource->pState = pState;
+
+        /* keep the fragments in name order after the -f file */
+        while( ( *ppSource != NULL ) &&
+               ( ( fragment == true ) &&
+                 ( ( (*ppSource)->fragment == false ) ||
+                   ( strcmp( (*ppSource)->pFileName, filename ) < 0 ) ) ) )
+        {
+            ppSource = &(*ppSource)->pNext;
+        }
+
+        pSource->pNext = *ppSource;
+        *ppSource = pSource;
+
+        /* reload the configuration file when it changes */
+        WATCH_Add( pSource->pFileName, ConfigChanged, pSource );
+    }
+
+    return pSource;
+}
+
+/*==========================================================================*/
+/*  ScanConfigDir                                                           */
+/*!
+    Scan the configuration directory
+
+    The ScanConfigDir function lists the "*.json" and "*.bin" files in the
+    configuration directory.  Configuration sources are added for new
+    files, and the configuration sources of files which no longer exist
+    are marked to be removed by the next configuration load.  If the
+    directory cannot be scanned, the configuration sources are left
+    unchanged.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void ScanConfigDir( ExecVarsState *pState )
+{
+    struct dirent **ppEntries = NULL;
+    ConfigSource *pSource;
+    char path[PATH_MAX];
+    int n;
+    int i;
+
+    if( pState->pDirName == NULL )
+    {
+        return;
+    }
+
+    n = scandir( pState->pDirName, &ppEntries, ConfigFilter, alphasort );
+    if( n < 0 )
+    {
+        /* keep the current fragments, eg. while the directory is
+           being replaced */
+        syslog( LOG_ERR,
+                "Unable to scan %s: %s\n",
+                pState->pDirName,
+                strerror( errno ) );
+        return;
+    }
+
+    for( pSource = pState->pSources;
+         pSource != NULL;
+         pSource = pSource->pNext )
+    {
+        if( pSource->fragment == true )
+        {
+            pSource->present = false;
+        }
+    }
+
+    for( i = 0; i < n; i++ )
+    {
+        snprintf( path,
+                  sizeof( path ),
+                  "%s/%s",
+                  pState->pDirName,
+                  ppEntries[i]->d_name );
+
+        for( pSource = pState->pSources;
+             pSource != NULL;
+             pSource = pSource->pNext )
+        {
+            if( strcmp( pSource->pFileName, path ) == 0 )
+            {
+                break;
+            }
+        }
+
+        if( pSource != NULL )
+        {
+            pSource->present = true;
+        }
+        else
+        {
+            AddConfigSource( pState, path, true );
+        }
+
+        free( ppEntries[i] );
+    }
+
+    free( ppEntries );
+}
+
+/*==========================================================================*/
+/*  ConfigFilter                                                            */
+/*!
+    Select the configuration files in the configuration directory
+
+    The ConfigFilter function is a scandir filter which selects the
+    JSON and compiled configuration files.  Hidden files, such as the
+    temporary files written by editors, are ignored.
+
+    @param[in]
+       entry
+            pointer to the directory entry
+
+    @retval 1 - the entry is a configuration file
+    @retval 0 - the entry is not a configuration file
+
+============================================================================*/
+static int ConfigFilter( const struct dirent *entry )
+{
+    const char *pExt;
+
+    if( entry->d_name[0] == '.' )
+    {
+        return 0;
+    }
+
+    pExt = strrchr( entry->d_name, '.' );
+
+    return ( pExt != NULL ) &&
+           ( ( strcmp( pExt, ".json" ) == 0 ) ||
+             ( strcmp( pExt, ".bin" ) == 0 ) );
+}
+
+/*==========================================================================*/
+/*  ConfigChanged                                                           */
+/*!
+    Handle a change to a configuration file
+
+    The ConfigChanged function is invoked by the file watcher when a
+    configuration file changes.  It marks the file to be re-parsed and
+    requests a configuration reload, which is performed by the event
+    loop once all pending changes have been processed.  Unchanged
+    configuration files are not re-parsed.
+
+    @param[in]
+       path
+            pointer to the path of the configuration file
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ConfigSource object
+
+============================================================================*/
+static void ConfigChanged( const char *path, void *arg )
+{
+    ConfigSource *pSource = (ConfigSource *)arg;
+
+    (void)path;
+
+    if( pSource != NULL )
+    {
+        pSource->dirty = true;
+        pSource->pState->reload = true;
+    }
+}
+
+/*==========================================================================*/
+/*  ConfigDirChanged                                                        */
+/*!
+    Handle a change to the configuration directory
+
+    The ConfigDirChanged function is invoked by the file watcher when a
+    file in the configuration directory changes.  It requests that the
+    directory is re-scanned for added and removed fragments by the
+    next configuration reload.
+
+    @param[in]
+       path
+            pointer to the path of the configuration directory
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ExecVars state object
+
+============================================================================*/
+static void ConfigDirChanged( const char *path, void *arg )
+{
+    ExecVarsState *pState = (ExecVarsState *)arg;
+
+    (void)path;
+
+    if( pState != NULL )
+    {
+        pState->rescan = true;
+        pState->reload = true;
+    }
+}
+
+/*==========================================================================*/
+/*  RequestReload                                                           */
+/*!
+    Request a full configuration reload
+
+    The RequestReload function marks every configuration file to be
+    re-parsed, and the configuration directory to be re-scanned, by the
+    next configuration reload.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void RequestReload( ExecVarsState *pState )
+{
+    ConfigSource *pSource;
+
+    for( pSource = pState->pSources;
+         pSource != NULL;
+         pSource = pSource->pNext )
+    {
+        pSource->dirty = true;
+    }
+
+    pState->rescan = true;
+    pState->reload = true;
+}
+
+/*==========================================================================*/
+/*  PurgeExecVars                                                           */
+/*!
+    Remove exec variables which are no longer defined
+
+    The PurgeExecVars function removes every exec variable which was not
+    defined by the most recent configuration load from the registry, its
+    indexes, and the registration queue, and releases its reference to
+    its exec command.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval number of exec variables removed
+
+============================================================================*/
+static int PurgeExecVars( ExecVarsState *pState )
+{
+    ExecVar **ppExecVar = &pState->pExecVars;
+    ExecVar *pExecVar;
+    int count = 0;
+
+    while( *ppExecVar != NULL )
+    {
+        pExecVar = *ppExecVar;
+        if( pExecVar->generation != pState->generation )
+        {
+            *ppExecVar = pExecVar->pNext;
+
+            if( pState->verbose == true )
+            {
+                printf( "removing %s\n", pExecVar->pName );
+            }
+
+            UnlinkExecVar( pState, pExecVar );
+            if( pExecVar->pExecCmd != NULL )
+            {
+                pExecVar->pExecCmd->refCount--;
+            }
+
+            EXTRACT_Free( pExecVar->pExtract );
+            free( pExecVar->pNameBuf );
+            POOL_Free( pState->pExecVarPool, pExecVar );
+            count++;
+        }
+        else
+        {
+            ppExecVar = &pExecVar->pNext;
+        }
+    }
+
+    return count;
+}
+
+/*==========================================================================*/
+/*  PurgeExecCmds                                                           */
+/*!
+    Remove exec commands which are no longer used
+
+    The PurgeExecCmds function removes every exec command which no longer
+    renders any exec variable from the exec command list and intern table,
+    removes its file dependencies, and frees it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void PurgeExecCmds( ExecVarsState *pState )
+{
+    ExecCmd **ppExecCmd = &pState->pExecCmds;
+    ExecCmd **ppBucket;
+    ExecCmd *pExecCmd;
+
+    while( *ppExecCmd != NULL )
+    {
+        pExecCmd = *ppExecCmd;
+        if( pExecCmd->refCount <= 0 )
+        {
+            /* unlink the command from the exec command list */
+            *ppExecCmd = pExecCmd->pNext;
+
+            /* unlink the command from the intern table */
+            ppBucket = &pState->cmdTable[pExecCmd->hash % EXECCMD_TABLE_SIZE];
+            while( *ppBucket != NULL )
+            {
+                if( *ppBucket == pExecCmd )
+                {
+                    *ppBucket = pExecCmd->pHashNext;
+                    break;
+                }
+
+                ppBucket = &(*ppBucket)->pHashNext;
+            }
+
+            WATCH_Remove( pExecCmd );
+
+            free( pExecCmd->pKey );
+            free( pExecCmd->pCmdBuf );
+            FreeOutput( &pExecCmd->cache );
+            free( pExecCmd->ppRefs );
+            free( pExecCmd->pExpanded );
+            free( pExecCmd->pLatency );
+            POOL_Free( pState->pExecCmdPool, pExecCmd );
+        }
+        else
+        {
+            ppExecCmd = &pExecCmd->pNext;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  SetupExecVar                                                            */
+/*!
+    Set up an execvar object
+
+    The SetupExecVar function is a callback function for the CONFIG_Iterate
+    function which sets up an exec command and the exec variables it
+    renders from its definition in the configuration image.
+
+    When the definition lists file dependencies, the command output is
+    cached until one of the listed files changes.
+
+    When the definition names a network interface, the command output
+    is cached and re-rendered whenever the specified network interface
+    ("*" for any interface) changes.
+
+    When the definition has a time to live, the command output is
+    cached for at most the specified number of seconds.
+
+    Each variable rendered by the command may have an extraction rule
+    which selects its value from the command output.  The rule is
+    compiled once here rather than on every print request.
+
+    A variable whose name contains "{name}" parameters is a template,
+    which defines every existing variable with a matching name.
+
+    A definition with a "group" name prefix instead of a command defines
+    a variable which renders every exec variable with that prefix.
+
+    @param[in]
+       pDef
+            pointer to the exec command definition
+
+    @param[in]
+        arg
+            opaque pointer argument used for the execvar state object
+
+    @retval EOK - the exec variable was set up successfully
+    @retval EINVAL - the exec variable could not be set up
+
+============================================================================*/
+static int SetupExecVar( const ExecDef *pDef, void *arg )
+{
+    ExecVarsState *pState = (ExecVarsState *)arg;
+    ExecCmd *pExecCmd = NULL;
+    const VarDef *pVar;
+    ExtractRule *pExtract;
+    int result = EINVAL;
+    int i;
+
+    if( ( pState != NULL ) &&
+        ( pDef != NULL ) )
+    {
+        result = EOK;
+
+        for( i = 0; i < pDef->nVars; i++ )
+        {
+            pVar = &pDef->pVars[i];
+
+            if( pDef->pGroup != NULL )
+            {
+                /* set up a variable which renders a group of variables */
+                SetupGroup( pState, pDef, pVar );
+                continue;
+            }
+
+            if( TEMPLATE_IsTemplate( pVar->pName ) == true )
+            {
+                /* set up the variables which match the template */
+                SetupTemplate( pState, pDef, pVar );
+                continue;
+            }
+
+            if( pExecCmd == NULL )
+            {
+                pExecCmd = InternExecCmd( pState, pDef, NULL );
+                if( pExecCmd == NULL )
+                {
+                    result = ENOMEM;
+                    break;
+                }
+            }
+
+            /* get the rule which extracts the variable value */
+            pExtract = EXTRACT_Create( &pVar->extract );
+            if( ( pVar->extract.type == EXTRACT_NONE ) ||
+                ( pExtract != NULL ) )
+            {
+                AddExecVar( pState,
+                            pVar->pName,
+                            pExecCmd,
+                            pExtract,
+                            NULL,
+                            NULL );
+            }
+            else
+            {
+                syslog( LOG_ERR,
+                        "Invalid extract rule for %s\n",
+                        pVar->pName );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  SetupTemplate                                                           */
+/*!
+    Set up an execvar template
+
+    The SetupTemplate function compiles a variable definition whose name
+    contains parameters, such as "/sys/network/{if}/mac", and sets up an
+    exec variable for every variable in the variable server whose name
+    matches it.  The command of each instance is expanded from the
+    template when the instance is first rendered, and instances which
+    expand to the same command share one exec command and its cache.
+
+    Instances which were already rendered before a reload are bound to
+    their new command immediately, so unchanged commands keep their
+    cached output.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pDef
+            pointer to the exec command definition
+
+    @param[in]
+       pVar
+            pointer to the template variable definition
+
+    @retval EOK - the template was set up
+    @retval EINVAL - the template is invalid
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int SetupTemplate( ExecVarsState *pState,
+                          const ExecDef *pDef,
+                          const VarDef *pVar )
+{
+    ExecTemplate *pExecTemplate;
+    ExecVar *pExecVar;
+    ExecCmd *pExecCmd;
+    VarQuery query;
+    VarObject obj;
+    int result;
+
+    pExecTemplate = calloc( 1, sizeof( ExecTemplate ) );
+    if( pExecTemplate == NULL )
+    {
+        return ENOMEM;
+    }
+
+    pExecTemplate->pTemplate = TEMPLATE_Create( pVar->pName, pDef->pCmd );
+    pExecTemplate->pExtract = EXTRACT_Create( &pVar->extract );
+    if( ( pExecTemplate->pTemplate == NULL ) ||
+        ( ( pVar->extract.type != EXTRACT_NONE ) &&
+          ( pExecTemplate->pExtract == NULL ) ) )
+    {
+        syslog( LOG_ERR, "Invalid template %s\n", pVar->pName );
+        TEMPLATE_Free( pExecTemplate->pTemplate );
+        EXTRACT_Free( pExecTemplate->pExtract );
+        free( pExecTemplate );
+        return EINVAL;
+    }
+
+    /* instances are executed by the shell once their parameters are
+       substituted into the command */
+    pExecTemplate->pName = pVar->pName;
+    pExecTemplate->def = *pDef;
+    pExecTemplate->def.ppArgv = NULL;
+    pExecTemplate->def.pVars = NULL;
+    pExecTemplate->def.nVars = 0;
+    pExecTemplate->generation = pState->generation;
+
+    pExecTemplate->pNext = pState->pTemplates;
+    pState->pTemplates = pExecTemplate;
+
+    /* find the variables which match the template */
+    memset( &query, 0, sizeof( query ) );
+    memset( &obj, 0, sizeof( obj ) );
+    query.type = QUERY_MATCH;
+    query.match = (char *)TEMPLATE_GetPrefix( pExecTemplate->pTemplate );
+
+    result = VAR_GetFirst( pState->hVarServer, &query, &obj );
+    while( result == EOK )
+    {
+        if( TEMPLATE_Match( pExecTemplate->pTemplate, query.name ) == true )
+        {
+            pExecCmd = NULL;
+
+            pExecVar = FindExecVarByName( pState,
+                                          query.name,
+                                          HashString( query.name ) );
+            if( ( pExecVar != NULL ) &&
+                ( pExecVar->pExecCmd != NULL ) )
+            {
+                /* rebind the instance so an unchanged command keeps
+                   its cached output */
+                pExecCmd = BindTemplate( pState, pExecTemplate, query.name );
+            }
+
+            AddExecVar( pState,
+                        query.name,
+                        pExecCmd,
+                        NULL,
+                        pExecTemplate,
+                        NULL );
+        }
+
+        result = VAR_GetNext( pState->hVarServer, &query, &obj );
+    }
+
+    return EOK;
+}
+
+/*==========================================================================*/
+/*  BindTemplate                                                            */
+/*!
+    Get the exec command of a template instance
+
+    The BindTemplate function binds the parameters of a template from
+    the name of one of its instances, and gets the exec command for the
+    expanded command sequence.  Instances with the same parameter values
+    get the same exec command, and so share its cache.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecTemplate
+            pointer to the exec template
+
+    @param[in]
+       varname
+            pointer to the NUL terminated name of the instance
+
+    @retval pointer to the exec command
+    @retval NULL - the exec command could not be created
+
+============================================================================*/
+static ExecCmd *BindTemplate( ExecVarsState *pState,
+                              ExecTemplate *pExecTemplate,
+                              const char *varname )
+{
+    ExecDef def;
+    char *pCmd;
+
+    pCmd = TEMPLATE_Expand( pExecTemplate->pTemplate, varname );
+    if( pCmd == NULL )
+    {
+        return NULL;
+    }
+
+    def = pExecTemplate->def;
+    def.pCmd = pCmd;
+
+    return InternExecCmd( pState, &def, pCmd );
+}
+
+/*==========================================================================*/
+/*  PurgeTemplates                                                          */
+/*!
+    Remove templates which are no longer defined
+
+    The PurgeTemplates function frees every exec template which was not
+    defined by the most recent configuration load.  It must be called
+    after PurgeExecVars, so no instance refers to them.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void PurgeTemplates( ExecVarsState *pState )
+{
+    ExecTemplate **ppExecTemplate = &pState->pTemplates;
+    ExecTemplate *pExecTemplate;
+
+    while( *ppExecTemplate != NULL )
+    {
+        pExecTemplate = *ppExecTemplate;
+        if( pExecTemplate->generation != pState->generation )
+        {
+            *ppExecTemplate = pExecTemplate->pNext;
+
+            TEMPLATE_Free( pExecTemplate->pTemplate );
+            EXTRACT_Free( pExecTemplate->pExtract );
+            free( pExecTemplate );
+        }
+        else
+        {
+            ppExecTemplate = &pExecTemplate->pNext;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  SetupGroup                                                              */
+/*!
+    Set up an execvar group
+
+    The SetupGroup function sets up an exec variable which renders every
+    exec variable whose name starts with the group's name prefix as one
+    JSON object.  The members of the group are found by ResolveGroups once
+    the whole configuration has been applied, so members defined after
+    the group, or in other configuration files, are included.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pDef
+            pointer to the group definition
+
+    @param[in]
+       pVar
+            pointer to the group variable definition
+
+    @retval EOK - the group was set up
+    @retval EEXIST - the group variable was already defined
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int SetupGroup( ExecVarsState *pState,
+                       const ExecDef *pDef,
+                       const VarDef *pVar )
+{
+    ExecGroup *pExecGroup;
+    int result;
+
+    pExecGroup = calloc( 1, sizeof( ExecGroup ) );
+    if( pExecGroup == NULL )
+    {
+        return ENOMEM;
+    }
+
+    pExecGroup->pPrefix = pDef->pGroup;
+    pExecGroup->priority = pDef->priority;
+    pExecGroup->generation = pState->generation;
+
+    pExecGroup->pNext = pState->pGroups;
+    pState->pGroups = pExecGroup;
+
+    result = AddExecVar( pState, pVar->pName, NULL, NULL, NULL, pExecGroup );
+    if( result != EOK )
+    {
+        /* nothing refers to the group */
+        pState->pGroups = pExecGroup->pNext;
+        free( pExecGroup );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ResolveGroups                                                           */
+/*!
+    Find the members of every execvar group
+
+    The ResolveGroups function builds the member list of every exec group
+    from the exec variables whose names start with the group's name prefix.
+    Variable names are not case sensitive.  Groups are not members of
+    other groups.  The members are sorted by name so the group is always
+    rendered in the same order.
+
+    It must be called after PurgeExecVars, as the member lists refer to
+    the exec variables directly.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void ResolveGroups( ExecVarsState *pState )
+{
+    ExecGroup *pExecGroup;
+    ExecVar *pExecVar;
+    size_t len;
+    int n;
+
+    for( pExecGroup = pState->pGroups;
+         pExecGroup != NULL;
+         pExecGroup = pExecGroup->pNext )
+    {
+        free( pExecGroup->ppMembers );
+        pExecGroup->ppMembers = NULL;
+        pExecGroup->nMembers = 0;
+
+        len = strlen( pExecGroup->pPrefix );
+
+        n = 0;
+        for( pExecVar = pState->pExecVars;
+             pExecVar != NULL;
+             pExecVar = pExecVar->pNext )
+        {
+            if( ( pExecVar->pGroup == NULL ) &&
+                ( strncasecmp( pExecVar->pName,
+                               pExecGroup->pPrefix,
+                               len ) == 0 ) )
+            {
+                n++;
+            }
+        }
+
+        if( n == 0 )
+        {
+            continue;
+        }
+
+        pExecGroup->ppMembers = calloc( n, sizeof( ExecVar * ) );
+        if( pExecGroup->ppMembers == NULL )
+        {
+            syslog( LOG_ERR,
+                    "Unable to resolve group %s\n",
+                    pExecGroup->pPrefix );
+            continue;
+        }
+
+        for( pExecVar = pState->pExecVars;
+             pExecVar != NULL;
+             pExecVar = pExecVar->pNext )
+        {
+            if( ( pExecVar->pGroup == NULL ) &&
+                ( strncasecmp( pExecVar->pName,
+                               pExecGroup->pPrefix,
+                               len ) == 0 ) )
+            {
+                pExecGroup->ppMembers[pExecGroup->nMembers++] = pExecVar;
+            }
+        }
+
+        qsort( pExecGroup->ppMembers,
+               pExecGroup->nMembers,
+               sizeof( ExecVar * ),
+               CompareExecVars );
+    }
+}
+
+/*==========================================================================*/
+/*  CompareExecVars                                                         */
+/*!
+    Compare the names of two exec variables
+
+    The CompareExecVars function is a qsort comparison function which
+    orders exec variable pointers by variable name.
+
+    @param[in]
+       p1
+            pointer to the first exec variable pointer
+
+    @param[in]
+       p2
+            pointer to the second exec variable pointer
+
+    @retval <0 - the first name sorts before the second name
+    @retval 0 - the names are the same
+    @retval >0 - the first name sorts after the second name
+
+============================================================================*/
+static int CompareExecVars( const void *p1, const void *p2 )
+{
+    const ExecVar *pExecVar1 = *(ExecVar * const *)p1;
+    const ExecVar *pExecVar2 = *(ExecVar * const *)p2;
+
+    return strcasecmp( pExecVar1->pName, pExecVar2->pName );
+}
+
+/*==========================================================================*/
+/*  PurgeGroups                                                             */
+/*!
+    Remove groups which are no longer defined
+
+    The PurgeGroups function frees every exec group which was not
+    defined by the most recent configuration load.  It must be called
+    after PurgeExecVars, so no exec variable refers to them.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void PurgeGroups( ExecVarsState *pState )
+{
+    ExecGroup **ppExecGroup = &pState->pGroups;
+    ExecGroup *pExecGroup;
+
+    while( *ppExecGroup != NULL )
+    {
+        pExecGroup = *ppExecGroup;
+        if( pExecGroup->generation != pState->generation )
+        {
+            *ppExecGroup = pExecGroup->pNext;
+
+            free( pExecGroup->ppMembers );
+            free( pExecGroup );
+        }
+        else
+        {
+            ppExecGroup = &pExecGroup->pNext;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  GetExecCmd                                                              */
+/*!
+    Get the exec command which renders an exec variable
+
+    The GetExecCmd function gets the exec command of an exec variable.
+    The parameters of a template instance are bound on its first use.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable
+
+    @retval pointer to the exec command
+    @retval NULL - the exec variable is not rendered by a command
+
+============================================================================*/
+static ExecCmd *GetExecCmd( ExecVarsState *pState, ExecVar *pExecVar )
+{
+    if( ( pExecVar->pExecCmd == NULL ) &&
+        ( pExecVar->pTemplate != NULL ) )
+    {
+        /* bind the template parameters on first use */
+        pExecVar->pExecCmd = BindTemplate( pState,
+                                           pExecVar->pTemplate,
+                                           pExecVar->pName );
+        if( pExecVar->pExecCmd != NULL )
+        {
+            pExecVar->pExecCmd->refCount++;
+            SetupReferences( pState, pExecVar->pExecCmd );
+        }
+    }
+
+    return pExecVar->pExecCmd;
+}
+
+/*==========================================================================*/
+/*  GetExtractRule                                                          */
+/*!
+    Get the extraction rule of an exec variable
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable
+
+    @retval pointer to the extraction rule
+    @retval NULL - the full command output is used
+
+============================================================================*/
+static ExtractRule *GetExtractRule( ExecVar *pExecVar )
+{
+    return ( pExecVar->pTemplate != NULL ) ? pExecVar->pTemplate->pExtract
+                                           : pExecVar->pExtract;
+}
+
+/*==========================================================================*/
+/*  InternExecCmd                                                           */
+/*!
+    Get the exec command for a command definition
+
+    The InternExecCmd function looks up an existing exec command with the
+    same command sequence and caching policy as the specified definition,
+    so that aliased variables share one execution, one cache, and one set
+    of statistics.  If there is no such command, a new exec command object
+    is created from the definition, its cache invalidation sources are
+    set up, and it is added to the exec command list and intern table.
+
+    In both cases the command's strings are pointed at the definition's
+    configuration image, unless the command sequence was expanded from
+    a template, in which case the exec command takes ownership of it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pDef
+            pointer to the exec command definition
+
+    @param[in]
+        pCmdBuf
+            pointer to the dynamically allocated command sequence of
+            pDef expanded from a template, or NULL
+
+    @retval pointer to the exec command
+    @retval NULL - the exec command could not be created
+
+============================================================================*/
+static ExecCmd *InternExecCmd( ExecVarsState *pState,
+                               const ExecDef *pDef,
+                               char *pCmdBuf )
+{
+    ExecCmd *pExecCmd;
+    char *pKey;
+    uint32_t hash;
+
+    pKey = BuildCmdKey( pDef );
+    if( pKey == NULL )
+    {
+        free( pCmdBuf );
+        return NULL;
+    }
+
+    /* look for an identical command */
+    hash = HashString( pKey );
+    for( pExecCmd = pState->cmdTable[hash % EXECCMD_TABLE_SIZE];
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pHashNext )
+    {
+        if( ( pExecCmd->hash == hash ) &&
+            ( strcmp( pExecCmd->pKey, pKey ) == 0 ) )
+        {
+            /* identical strings are stored once per image, so a matching
+               command from the same image is an alias */
+            if( ( pState->verbose == true ) &&
+                ( pExecCmd->pCmd == pDef->pCmd ) )
+            {
+                printf( "sharing command: %s\n", pDef->pCmd );
+            }
+
+            /* a command which owns its command sequence keeps it.  One
+               which borrows it takes ownership of an expanded command
+               sequence, since the image it borrows from may be released
+               while the template instance still uses the command, or
+               otherwise borrows from the new configuration image */
+            if( ( pExecCmd->pCmdBuf == NULL ) &&
+                ( pCmdBuf != NULL ) )
+            {
+                pExecCmd->pCmd = pCmdBuf;
+                pExecCmd->ppArgv = NULL;
+                pExecCmd->pCmdBuf = pCmdBuf;
+                pCmdBuf = NULL;
+            }
+            else if( pExecCmd->pCmdBuf == NULL )
+            {
+                pExecCmd->pCmd = pDef->pCmd;
+                pExecCmd->ppArgv = pDef->ppArgv;
+            }
+
+            if( pExecCmd->pNetIf != NULL )
+            {
+                pExecCmd->pNetIf = pDef->pNetIf;
+            }
+
+            free( pCmdBuf );
+            free( pKey );
+            return pExecCmd;
+        }
+    }
+
+    /* allocate memory for the exec command */
+    pExecCmd = POOL_Alloc( pState->pExecCmdPool );
+    if( pExecCmd != NULL )
+    {
+        /* set the command sequence */
+        pExecCmd->pCmd = pDef->pCmd;
+        pExecCmd->ppArgv = pDef->ppArgv;
+        pExecCmd->pCmdBuf = pCmdBuf;
+        pExecCmd->pKey = pKey;
+        pExecCmd->hash = hash;
+        pExecCmd->priority = pDef->priority;
+
+        /* hedged commands track the distribution of their execution
+           times.  They are not hedged if it cannot be tracked */
+        if( pDef->hedge == true )
+        {
+            pExecCmd->pLatency = calloc( HEDGE_SAMPLES, sizeof( uint32_t ) );
+        }
+
+        /* set up the retry policy for transient failures */
+        pExecCmd->retries = pDef->retries;
+        pExecCmd->retryDelay_ms = ( pDef->retryDelay > 0 )
+                                  ? (uint32_t)pDef->retryDelay
+                                  : DEFAULT_RETRY_DELAY_MS;
+        pExecCmd->retryBudget_ms = ( pDef->retryBudget > 0 )
+                                   ? (uint32_t)pDef->retryBudget
+                                   : DEFAULT_RETRY_BUDGET_MS;
+
+        /* set up the output size limit */
+        pExecCmd->maxOutput = ( pDef->maxOutput > 0 )
+                              ? (size_t)pDef->maxOutput
+                              : pState->maxOutput;
+        pExecCmd->killOnOverflow = pDef->killOnOverflow;
+
+        /* set the maximum age of the cached output */
+        if( pDef->ttl > 0 )
+        {
+            pExecCmd->ttl_ms = (uint64_t)pDef->ttl * 1000;
+            pExecCmd->cacheable = true;
+        }
+
+        /* set up the network interface the command tracks */
+        if( pDef->pNetIf != NULL )
+        {
+            if( NETEVENT_Init() == EOK )
+            {
+                pExecCmd->pNetIf = pDef->pNetIf;
+                pExecCmd->cacheable = true;
+            }
+            else
+            {
+                syslog( LOG_ERR,
+                        "Unable to monitor network events for %s\n",
+                        pDef->pCmd );
+            }
+        }
+
+        /* set up the file dependencies of the command.  This is done
+           last so a dependency failure disables caching entirely */
+        SetupDependencies( pExecCmd, pDef );
+
+        /* only output which expires by time alone is valid for every
+           instance, so only it is shared */
+        pExecCmd->shareable = ( pExecCmd->ttl_ms > 0 ) &&
+                              ( pDef->pNetIf == NULL ) &&
+                              ( pDef->nDepends == 0 );
+        pExecCmd->shmKey = HashString64( pKey );
+
+        /* store the command into the exec command list */
+        pExecCmd->pNext = pState->pExecCmds;
+        pState->pExecCmds = pExecCmd;
+
+        /* store the command into the intern table */
+        pExecCmd->pHashNext = pState->cmdTable[hash % EXECCMD_TABLE_SIZE];
+        pState->cmdTable[hash % EXECCMD_TABLE_SIZE] = pExecCmd;
+    }
+    else
+    {
+        free( pCmdBuf );
+        free( pKey );
+    }
+
+    return pExecCmd;
+}
+
+/*==========================================================================*/
+/*  BuildCmdKey                                                             */
+/*!
+    Build the intern key of an exec command definition
+
+    The BuildCmdKey function builds a string which uniquely identifies
+    an exec command by its command sequence, its caching policy
+    (time to live, network interface, and file dependencies), its
+    priority class, and whether it is hedged.  Only
+    definitions with identical keys share an exec command, so sharing
+    never changes when a variable's value is refreshed.
+
+    @param[in]
+       pDef
+            pointer to the exec command definition
+
+    @retval pointer to the dynamically allocated intern key
+    @retval NULL - memory allocation failed
+
+============================================================================*/
+static char *BuildCmdKey( const ExecDef *pDef )
+{
+    OutputBuffer key;
+    char buf[128];
+    char *pKey = NULL;
+    int i;
+
+    memset( &key, 0, sizeof( key ) );
+
+    snprintf( buf,
+              sizeof( buf ),
+              "ttl=%d\npriority=%d\nhedge=%d\nretry=%d,%d,%d\n"
+              "output=%d,%d\n",
+              pDef->ttl,
+              pDef->priority,
+              pDef->hedge,
+              pDef->retries,
+              pDef->retryDelay,
+              pDef->retryBudget,
+              pDef->maxOutput,
+              pDef->killOnOverflow );
+    WriteOutput( -1, buf, strlen( buf ), &key );
+
+    if( pDef->pNetIf != NULL )
+    {
+        WriteOutput( -1, "netlink=", 8, &key );
+        WriteOutput( -1, (char *)pDef->pNetIf, strlen( pDef->pNetIf ), &key );
+        WriteOutput( -1, "\n", 1, &key );
+    }
+
+    for( i = 0; i < pDef->nDepends; i++ )
+    {
+        WriteOutput( -1, "depends_on=", 11, &key );
+        WriteOutput( -1,
+                     (char *)pDef->ppDepends[i],
+                     strlen( pDef->ppDepends[i] ),
+                     &key );
+        WriteOutput( -1, "\n", 1, &key );
+    }
+
+    WriteOutput( -1, "exec=", 5, &key );
+    WriteOutput( -1, (char *)pDef->pCmd, strlen( pDef->pCmd ) + 1, &key );
+
+    if( key.incomplete == false )
+    {
+        /* the key outlives the pooled buffer it was built in */
+        pKey = strdup( key.pData );
+    }
+
+    FreeOutput( &key );
+
+    return pKey;
+}
+
+/*==========================================================================*/
+/*  HashString                                                              */
+/*!
+    Hash a string
+
+    The HashString function computes the 32-bit FNV-1a hash of a
+    NUL terminated string.
+
+    @param[in]
+        str
+            pointer to the NUL terminated string to hash
+
+    @retval the hash of the string
+
+============================================================================*/
+static uint32_t HashString( const char *str )
+{
+    uint32_t hash = 2166136261u;
+
+    while( *str != '\0' )
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/*==========================================================================*/
+/*  HashString64                                                            */
+/*!
+    Hash a string into 64 bits
+
+    The HashString64 function computes the 64-bit FNV-1a hash of a
+    NUL terminated string.  It is used where the hash identifies the
+    string on its own, such as the shared result cache key.
+
+    @param[in]
+        str
+            pointer to the NUL terminated string to hash
+
+    @retval the hash of the string
+
+============================================================================*/
+static uint64_t HashString64( const char *str )
+{
+    uint64_t hash = 14695981039346656037u;
+
+    while( *str != '\0' )
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 1099511628211u;
+    }
+
+    return hash;
+}
+
+/*==========================================================================*/
+/*  AddExecVar                                                              */
+/*!
+    Add an exec variable
+
+    The AddExecVar function creates an exec variable which is rendered
+    from the output of an exec command, adds it to the exec variable list
+    and name index, and queues it to be registered with the variable
+    server by the event loop.  If an exec variable with the same name
+    already exists, its command and extraction rule are updated in place.
+
+    Template instances own a copy of their name, and use the extraction
+    rule of their template.
+
+    A variable may only be defined once per configuration load.  The
+    first definition wins, except that an explicit definition replaces
+    a template instance.  Duplicate explicit definitions are logged.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        varname
+            pointer to the NUL terminated variable name
+
+    @param[in]
+        pExecCmd
+            pointer to the exec command which renders the variable
+
+    @param[in]
+        pExtract
+            pointer to the rule which extracts the variable's value from
+            the command output, or NULL to use the full command output
+
+    @param[in]
+        pExecTemplate
+            pointer to the template the variable is an instance of,
+            or NULL
+
+    @param[in]
+        pExecGroup
+            pointer to the group the variable renders, or NULL
+
+    @retval EOK - the exec variable was added successfully
+    @retval EEXIST - the exec variable was already defined
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int AddExecVar( ExecVarsState *pState,
+                       const char *varname,
+                       ExecCmd *pExecCmd,
+                       ExtractRule *pExtract,
+                       ExecTemplate *pExecTemplate,
+                       ExecGroup *pExecGroup )
+{
+    ExecVar *pExecVar;
+    uint32_t hash;
+    int result = ENOMEM;
+
+    hash = HashString( varname );
+
+    pExecVar = FindExecVarByName( pState, varname, hash );
+    if( ( pExecVar != NULL ) &&
+        ( pExecVar->generation == pState->generation ) &&
+        ( ( pExecTemplate != NULL ) ||
+          ( pExecVar->pTemplate == NULL ) ) )
+    {
+        /* the variable was already defined by this configuration load */
+        if( pExecTemplate == NULL )
+        {
+            syslog( LOG_ERR,
+                    "Duplicate definition of %s in %s (first defined in %s)\n",
+                    varname,
+                    ( pState->pSource != NULL ) ? pState->pSource->pFileName
+                                                : "",
+                    ( pExecVar->pSource != NULL ) ? pExecVar->pSource->pFileName
+                                                  : "" );
+        }
+
+        EXTRACT_Free( pExtract );
+        return EEXIST;
+    }
+
+    if( ( pExecVar != NULL ) &&
+        ( pExecTemplate != NULL ) &&
+        ( pExecVar->pNameBuf == NULL ) )
+    {
+        /* template instance names are not in the configuration.  If
+           the name cannot be copied the variable is left to be purged,
+           as its name refers to the previous configuration */
+        pExecVar->pNameBuf = strdup( varname );
+        if( pExecVar->pNameBuf == NULL )
+        {
+            EXTRACT_Free( pExtract );
+            return ENOMEM;
+        }
+
+        pExecVar->pName = pExecVar->pNameBuf;
+    }
+
+    if( pExecVar != NULL )
+    {
+        /* the variable is already defined, so update its command
+           and extraction rule in place */
+        if( pExecVar->pExecCmd != pExecCmd )
+        {
+            if( pExecVar->pExecCmd != NULL )
+            {
+                pExecVar->pExecCmd->refCount--;
+            }
+
+            pExecVar->pExecCmd = pExecCmd;
+            if( pExecCmd != NULL )
+            {
+                pExecCmd->refCount++;
+            }
+        }
+
+        EXTRACT_Free( pExecVar->pExtract );
+        pExecVar->pExtract = pExtract;
+        pExecVar->pTemplate = pExecTemplate;
+        pExecVar->pGroup = pExecGroup;
+        pExecVar->pSource = pState->pSource;
+
+        if( pExecTemplate == NULL )
+        {
+            /* borrow the name from the new configuration image */
+            free( pExecVar->pNameBuf );
+            pExecVar->pNameBuf = NULL;
+            pExecVar->pName = varname;
+        }
+
+        if( pExecVar->generation != pState->generation )
+        {
+            pExecVar->generation = pState->generation;
+            pState->updated++;
+        }
+
+        result = EOK;
+    }
+    else
+    {
+        /* allocate memory for the exec variable */
+        pExecVar = POOL_Alloc( pState->pExecVarPool );
+        if( ( pExecVar != NULL ) &&
+            ( pExecTemplate != NULL ) )
+        {
+            /* template instance names are not in the configuration */
+            pExecVar->pNameBuf = strdup( varname );
+            if( pExecVar->pNameBuf == NULL )
+            {
+                POOL_Free( pState->pExecVarPool, pExecVar );
+                pExecVar = NULL;
+            }
+        }
+
+        if( pExecVar != NULL )
+        {
+            pExecVar->hVar = VAR_INVALID;
+            pExecVar->pName = ( pExecVar->pNameBuf != NULL ) ? pExecVar->pNameBuf
+                                                             : varname;
+            pExecVar->nameHash = hash;
+            pExecVar->generation = pState->generation;
+
+            /* set the command and extraction rule of the exec var */
+            pExecVar->pExecCmd = pExecCmd;
+            if( pExecCmd != NULL )
+            {
+                pExecCmd->refCount++;
+            }
+
+            pExecVar->pExtract = pExtract;
+            pExecVar->pTemplate = pExecTemplate;
+            pExecVar->pGroup = pExecGroup;
+            pExecVar->pSource = pState->pSource;
+
+            /* store the execvar into the execvar list and name index */
+            pExecVar->pNext = pState->pExecVars;
+            pState->pExecVars = pExecVar;
+
+            pExecVar->pNameNext = pState->nameTable[hash % EXECVAR_TABLE_SIZE];
+            pState->nameTable[hash % EXECVAR_TABLE_SIZE] = pExecVar;
+
+            /* queue the execvar to be registered with the variable server */
+            if( pState->nPending == 0 )
+            {
+                pState->registerStart_ms = GetTimeMs();
+            }
+
+            pExecVar->pending = true;
+            *pState->ppPendingTail = pExecVar;
+            pState->ppPendingTail = &pExecVar->pPendingNext;
+            pState->nPending++;
+
+            pState->added++;
+            result = EOK;
+        }
+        else
+        {
+            EXTRACT_Free( pExtract );
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  RegisterExecVars                                                        */
+/*!
+    Register queued exec variables with the variable server
+
+    The RegisterExecVars function takes exec variables from the head of
+    the registration queue, looks up their handles, and tells the
+    variable server that execvars fulfils their print requests.  It is
+    called by the event loop between batches of events, so print requests
+    for the variables which are already registered are served while the
+    rest of a large configuration is still being registered.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        max
+            maximum number of exec variables to register
+
+    @retval number of exec variables still waiting to be registered
+
+============================================================================*/
+static int RegisterExecVars( ExecVarsState *pState, int max )
+{
+    ExecVar *pExecVar;
+    uint32_t idx;
+    int count = 0;
+
+    while( ( pState->pPending != NULL ) &&
+           ( count < max ) )
+    {
+        pExecVar = pState->pPending;
+
+        /* remove the exec var from the registration queue */
+        pState->pPending = pExecVar->pPendingNext;
+        if( pState->pPending == NULL )
+        {
+            pState->ppPendingTail = &pState->pPending;
+        }
+
+        pExecVar->pPendingNext = NULL;
+        pExecVar->pending = false;
+        pState->nPending--;
+        count++;
+
+        /* get a handle to the exec var */
+        pExecVar->hVar = VAR_FindByName( pState->hVarServer,
+                                         (char *)pExecVar->pName );
+        if( pExecVar->hVar == VAR_INVALID )
+        {
+            syslog( LOG_ERR, "Variable %s not found\n", pExecVar->pName );
+            continue;
+        }
+
+        /* store the execvar into the handle index before the variable
+           server can send print requests for it */
+        idx = pExecVar->hVar % EXECVAR_TABLE_SIZE;
+        pExecVar->pHandleNext = pState->handleTable[idx];
+        pState->handleTable[idx] = pExecVar;
+
+        /* tell the variable server that we will be responsible
+           for fulfilling print requests for this exec var */
+        VAR_Notify( pState->hVarServer, pExecVar->hVar, NOTIFY_PRINT );
+    }
+
+    if( ( count > 0 ) &&
+        ( pState->nPending == 0 ) )
+    {
+        syslog( LOG_INFO,
+                "Registered execvars in %" PRIu64 " ms\n",
+                GetTimeMs() - pState->registerStart_ms );
+    }
+
+    return pState->nPending;
+}
+
+/*==========================================================================*/
+/*  UnlinkExecVar                                                           */
+/*!
+    Remove an exec variable from the indexes
+
+    The UnlinkExecVar function removes an exec variable from the name
+    index, the handle index, and the registration queue.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        pExecVar
+            pointer to the exec variable to remove
+
+    @return none
+
+============================================================================*/
+static void UnlinkExecVar( ExecVarsState *pState, ExecVar *pExecVar )
+{
+    ExecVar **ppExecVar;
+
+    ppExecVar = &pState->nameTable[pExecVar->nameHash % EXECVAR_TABLE_SIZE];
+    while( *ppExecVar != NULL )
+    {
+        if( *ppExecVar == pExecVar )
+        {
+            *ppExecVar = pExecVar->pNameNext;
+            break;
+        }
+
+        ppExecVar = &(*ppExecVar)->pNameNext;
+    }
+
+    if( pExecVar->hVar != VAR_INVALID )
+    {
+        ppExecVar = &pState->handleTable[pExecVar->hVar % EXECVAR_TABLE_SIZE];
+        while( *ppExecVar != NULL )
+        {
+            if( *ppExecVar == pExecVar )
+            {
+                *ppExecVar = pExecVar->pHandleNext;
+                break;
+            }
+
+            ppExecVar = &(*ppExecVar)->pHandleNext;
+        }
+    }
+
+    if( pExecVar->pending == true )
+    {
+        ppExecVar = &pState->pPending;
+        while( *ppExecVar != NULL )
+        {
+            if( *ppExecVar == pExecVar )
+            {
+                *ppExecVar = pExecVar->pPendingNext;
+                if( pState->ppPendingTail == &pExecVar->pPendingNext )
+                {
+                    pState->ppPendingTail = ppExecVar;
+                }
+
+                pState->nPending--;
+                break;
+            }
+
+            ppExecVar = &(*ppExecVar)->pPendingNext;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  FindExecVar                                                             */
+/*!
+    Find an exec variable
+
+    The FindExecVar function looks up the exec variable with the
+    specified variable handle in the handle index.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        hVar
+            handle of the variable to find
+
+    @retval pointer to the exec variable
+    @retval NULL - the variable is not an exec variable
+
+============================================================================*/
+static ExecVar *FindExecVar( ExecVarsState *pState, VAR_HANDLE hVar )
+{
+    ExecVar *pExecVar = NULL;
+
+    if( hVar != VAR_INVALID )
+    {
+        for( pExecVar = pState->handleTable[hVar % EXECVAR_TABLE_SIZE];
+             pExecVar != NULL;
+             pExecVar = pExecVar->pHandleNext )
+        {
+            if( pExecVar->hVar == hVar )
+            {
+                break;
+            }
+        }
+    }
+
+    return pExecVar;
+}
+
+/*==========================================================================*/
+/*  FindExecVarByName                                                       */
+/*!
+    Find an exec variable by name
+
+    The FindExecVarByName function looks up the exec variable with the
+    specified name in the name index.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        varname
+            pointer to the NUL terminated variable name
+
+    @param[in]
+        hash
+            hash of the variable name
+
+    @retval pointer to the exec variable
+    @retval NULL - there is no exec variable with the specified name
+
+============================================================================*/
+static ExecVar *FindExecVarByName( ExecVarsState *pState,
+                                   const char *varname,
+                                   uint32_t hash )
+{
+    ExecVar *pExecVar;
+
+    for( pExecVar = pState->nameTable[hash % EXECVAR_TABLE_SIZE];
+         pExecVar != NULL;
+         pExecVar = pExecVar->pNameNext )
+    {
+        if( ( pExecVar->nameHash == hash ) &&
+            ( strcmp( pExecVar->pName, varname ) == 0 ) )
+        {
+            break;
+        }
+    }
+
+    return pExecVar;
+}
+
+/*==========================================================================*/
+/*  SetupDependencies                                                       */
+/*!
+    Set up the file dependencies of an exec command
+
+    The SetupDependencies function registers every file dependency of
+    an exec command definition with the file dependency watcher.
+    If any dependency cannot be watched, caching is disabled for the
+    exec command so a stale value is never served.
+
+    @param[in]
+        pExecCmd
+            pointer to the exec command
+
+    @param[in]
+       pDef
+            pointer to the exec command definition
+
+    @return none
+
+============================================================================*/
+static void SetupDependencies( ExecCmd *pExecCmd, const ExecDef *pDef )
+{
+    int i;
+
+    if( pDef->nDepends > 0 )
+    {
+        pExecCmd->cacheable = true;
+    }
+
+    for( i = 0; i < pDef->nDepends; i++ )
+    {
+        if( WATCH_Add( pDef->ppDepends[i], InvalidateCache, pExecCmd ) != EOK )
+        {
+            syslog( LOG_ERR,
+                    "Caching disabled for command %s\n",
+                    pExecCmd->pCmd );
+            pExecCmd->cacheable = false;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  InvalidateCache                                                         */
+/*!
+    Invalidate the cached output of an exec command
+
+    The InvalidateCache function is invoked by the file dependency watcher
+    when a file which an exec command depends on has changed.
+
+    @param[in]
+       path
+            pointer to the path of the file which changed
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ExecCmd object
+
+============================================================================*/
+static void InvalidateCache( const char *path, void *arg )
+{
+    ExecCmd *pExecCmd = (ExecCmd *)arg;
+
+    if( pExecCmd != NULL )
+    {
+        if( ( state.verbose == true ) &&
+            ( pExecCmd->cacheValid == true ) )
+        {
+            printf( "%s changed: invalidating %s\n", path, pExecCmd->pCmd );
+        }
+
+        if( pExecCmd->cacheValid == true )
+        {
+            /* keep the output to serve when the service is saturated */
+            pExecCmd->cacheStale = true;
+        }
+
+        pExecCmd->cacheValid = false;
+    }
+}
+
+/*==========================================================================*/
+/*  NetworkChanged                                                          */
+/*!
+    Handle a network interface change
+
+    The NetworkChanged function is invoked by the network event source
+    when the link state or addresses of a network interface change.
+    It invalidates the cached output of every exec command which tracks
+    that interface and schedules it to be re-rendered.
+
+    @param[in]
+       ifname
+            name of the interface which changed, or NULL if unknown
+
+    @param[in]
+        arg
+            opaque pointer argument used for the ExecVars state object
+
+============================================================================*/
+static void NetworkChanged( const char *ifname, void *arg )
+{
+    ExecVarsState *pState = (ExecVarsState *)arg;
+    ExecCmd *pExecCmd;
+
+    if( pState != NULL )
+    {
+        for( pExecCmd = pState->pExecCmds;
+             pExecCmd != NULL;
+             pExecCmd = pExecCmd->pNext )
+        {
+            if( ( pExecCmd->pNetIf != NULL ) &&
+                ( ( ifname == NULL ) ||
+                  ( strcmp( pExecCmd->pNetIf, "*" ) == 0 ) ||
+                  ( strcmp( pExecCmd->pNetIf, ifname ) == 0 ) ) )
+            {
+                if( pExecCmd->cacheValid == true )
+                {
+                    pExecCmd->cacheStale = true;
+                }
+
+                pExecCmd->cacheValid = false;
+                pExecCmd->refresh = true;
+            }
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  RefreshExecVars                                                         */
+/*!
+    Re-render the exec commands affected by network changes
+
+    The RefreshExecVars function executes every exec command which was
+    scheduled for refresh, and stores the output in its cache so
+    subsequent print requests for its variables are served from memory.
+    Each exec command is rendered once no matter how many change
+    events were received for it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void RefreshExecVars( ExecVarsState *pState )
+{
+    ExecCmd *pExecCmd;
+
+    if( pState != NULL )
+    {
+        for( pExecCmd = pState->pExecCmds;
+             pExecCmd != NULL;
+             pExecCmd = pExecCmd->pNext )
+        {
+            if( ( pExecCmd->refresh == true ) &&
+                ( pExecCmd->nRefs > 0 ) )
+            {
+                /* the referenced values are evaluated on the next
+                   print request */
+                pExecCmd->refresh = false;
+            }
+            else if( pExecCmd->refresh == true )
+            {
+                pExecCmd->refresh = false;
+
+                if( pState->verbose == true )
+                {
+                    printf( "network changed: refreshing %s\n", pExecCmd->pCmd );
+                }
+
+                RenderToCache( pState, pExecCmd, -1 );
+            }
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  RenderToCache                                                           */
+/*!
+    Render an exec command into its cache
+
+    The RenderToCache function executes an exec command, optionally
+    sending its output to an output stream, and captures the output into
+    the exec command's cache.  The cache is only replaced if the
+    command succeeded and all of its output was captured, otherwise the
+    previous output is kept as the command's last good output.  The
+    command is not executed while its circuit breaker is open.
+
+    If the shared result cache is used, output which another instance
+    stored in it is used instead of executing the command, and the
+    output of the command is stored in it for the other instances.
+    While another instance is executing the command, the print request
+    is parked until its output arrives.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to render
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to,
+            or -1 to only capture the output
+
+    @retval EOK - the exec command was rendered successfully
+    @retval ENOENT - the command was not found
+    @retval EINVAL - invalid arguments
+    @retval EAGAIN - the command's circuit breaker is open
+    @retval EINPROGRESS - the print request is parked
+
+============================================================================*/
+static int RenderToCache( ExecVarsState *pState, ExecCmd *pExecCmd, int fd )
+{
+    int result = EINVAL;
+    OutputBuffer output;
+
+    if( ( pState != NULL ) &&
+        ( pExecCmd != NULL ) )
+    {
+        result = FetchShared( pState, pExecCmd );
+        if( result == EOK )
+        {
+            /* another instance executed the command */
+            SendOutput( fd, &pExecCmd->cache, NULL );
+            return EOK;
+        }
+        else if( result == EINPROGRESS )
+        {
+            /* another instance is executing the command */
+            return EINPROGRESS;
+        }
+
+        memset( &output, 0, sizeof( output ) );
+
+        result = RunCommand( pState, pExecCmd, fd, &output );
+        if( ( result == EOK ) &&
+            ( output.incomplete == false ) )
+        {
+            FreeOutput( &pExecCmd->cache );
+            pExecCmd->cache = output;
+            pExecCmd->cacheValid = true;
+            pExecCmd->cacheStale = false;
+            pExecCmd->expires_ms = GetTimeMs() + pExecCmd->ttl_ms;
+
+            if( ( pState->pShmCache != NULL ) &&
+                ( pExecCmd->shareable == true ) )
+            {
+                /* output too large to share is left to each instance */
+                SHMCACHE_Put( pState->pShmCache,
+                              pExecCmd->shmKey,
+                              output.pData,
+                              output.len,
+                              pExecCmd->expires_ms );
+            }
+        }
+        else
+        {
+            /* keep the previous output as the last good output */
+            FreeOutput( &output );
+            if( pExecCmd->cacheValid == true )
+            {
+                pExecCmd->cacheStale = true;
+                pExecCmd->cacheValid = false;
+            }
+
+            if( ( pState->pShmCache != NULL ) &&
+                ( pExecCmd->shareable == true ) )
+            {
+                /* let the other instances execute the command */
+                SHMCACHE_Release( pState->pShmCache, pExecCmd->shmKey );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  FetchShared                                                             */
+/*!
+    Fetch an exec command's output from the shared result cache
+
+    The FetchShared function copies the output of an exec command which
+    another instance stored in the shared result cache into the command's
+    cache.  If another instance is executing the command, the print
+    request is parked and checks the shared result cache again from the
+    event loop, until the output arrives or the other instance's claim
+    expires.  Otherwise the command's shared cache entry is claimed, so
+    the other instances wait for this instance to execute it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command
+
+    @retval EOK - the output was fetched into the command's cache
+    @retval EINPROGRESS - the print request is parked
+    @retval ENOENT - the command must be executed
+    @retval ENOTSUP - the command's output is not shared
+
+============================================================================*/
+static int FetchShared( ExecVarsState *pState, ExecCmd *pExecCmd )
+{
+    char buf[SHMCACHE_VALUE_SIZE];
+    OutputBuffer output;
+    size_t len;
+    uint64_t expires_ms;
+    uint64_t lease_ms;
+    int result;
+
+    if( ( pState->pShmCache == NULL ) ||
+        ( pExecCmd->shareable == false ) ||
+        ( pExecCmd->nRefs > 0 ) )
+    {
+        return ENOTSUP;
+    }
+
+    lease_ms = ( pState->timeout_seconds > 0 )
+               ? (uint64_t)pState->timeout_seconds * 1000
+               : SHMCACHE_LEASE_MS;
+
+    result = SHMCACHE_Get( pState->pShmCache,
+                           pExecCmd->shmKey,
+                           buf,
+                           &len,
+                           &expires_ms );
+    if( result == EOK )
+    {
+        memset( &output, 0, sizeof( output ) );
+        WriteOutput( -1, buf, len, &output );
+        if( output.incomplete == true )
+        {
+            /* the output could not be copied */
+            FreeOutput( &output );
+            return ENOENT;
+        }
+
+        FreeOutput( &pExecCmd->cache );
+        pExecCmd->cache = output;
+        pExecCmd->cacheValid = true;
+        pExecCmd->cacheStale = false;
+        pExecCmd->expires_ms = expires_ms;
+        pExecCmd->sharedHits++;
+        return EOK;
+    }
+
+    if( ( result == EINPROGRESS ) &&
+        ( DeferRequest( pState, GetTimeMs() + SHMCACHE_POLL_MS ) == true ) )
+    {
+        /* another instance is executing the command */
+        return EINPROGRESS;
+    }
+
+    /* this instance executes the command, and claims it unless the entry
+       is claimed for another instance or a command sharing its slot */
+    SHMCACHE_Claim( pState->pShmCache, pExecCmd->shmKey, lease_ms );
+    return ENOENT;
+}
+
+/*==========================================================================*/
+/*  LoadSnapshot                                                            */
+/*!
+    Load the cache snapshot
+
+    The LoadSnapshot function restores the cached output of the exec
+    commands from the cache snapshot written by the previous run of the
+    service, so output which is still valid is served without executing
+    the commands.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void LoadSnapshot( ExecVarsState *pState )
+{
+    SnapshotIndex index;
+    ExecCmd *pExecCmd;
+    size_t n = 0;
+    size_t i;
+    int result;
+
+    if( pState->pSnapshotName == NULL )
+    {
+        return;
+    }
+
+    /* index the commands by key, so each snapshot entry is matched to
+       its command in constant time */
+    for( pExecCmd = pState->pExecCmds;
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pNext )
+    {
+        n++;
+    }
+
+    index.pState = pState;
+    index.size = 16;
+    while( index.size < n * 2 )
+    {
+        index.size *= 2;
+    }
+
+    index.ppTable = calloc( index.size, sizeof( ExecCmd * ) );
+    if( index.ppTable == NULL )
+    {
+        syslog( LOG_ERR, "Unable to index the cache snapshot\n" );
+        return;
+    }
+
+    for( pExecCmd = pState->pExecCmds;
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pNext )
+    {
+        if( ( pExecCmd->shareable == true ) &&
+            ( pExecCmd->nRefs == 0 ) )
+        {
+            i = pExecCmd->shmKey & ( index.size - 1 );
+            while( index.ppTable[i] != NULL )
+            {
+                i = ( i + 1 ) & ( index.size - 1 );
+            }
+
+            index.ppTable[i] = pExecCmd;
+        }
+    }
+
+    result = SNAPSHOT_Load( pState->pSnapshotName, RestoreOutput, &index );
+    free( index.ppTable );
+    if( result == EINVAL )
+    {
+        syslog( LOG_ERR,
+                "Invalid cache snapshot %s\n",
+                pState->pSnapshotName );
+    }
+
+    /* the first periodic snapshot is written after a full interval */
+    if( pState->snapshotInterval > 0 )
+    {
+        pState->snapshot_ms = GetTimeMs() +
+                              (uint64_t)pState->snapshotInterval * 1000;
+    }
+}
+
+/*==========================================================================*/
+/*  RestoreOutput                                                           */
+/*!
+    Restore an exec command's cached output from the cache snapshot
+
+    The RestoreOutput function is invoked for each unexpired entry of the
+    cache snapshot.  The entry's output becomes the cached output of the
+    exec command with the same key, if there is one and its output is
+    kept in the cache snapshot.
+
+    @param[in]
+       pEntry
+            pointer to the cache snapshot entry
+
+    @param[in]
+        arg
+            opaque pointer argument used for the SnapshotIndex object
+
+    @retval EOK - the cached output was restored
+    @retval ENOENT - no exec command matches the entry
+
+============================================================================*/
+static int RestoreOutput( const SnapshotEntry *pEntry, void *arg )
+{
+    SnapshotIndex *pIndex = (SnapshotIndex *)arg;
+    ExecVarsState *pState = pIndex->pState;
+    ExecCmd *pExecCmd;
+    OutputBuffer output;
+    size_t i;
+
+    for( i = pEntry->key & ( pIndex->size - 1 );
+         ( pExecCmd = pIndex->ppTable[i] ) != NULL;
+         i = ( i + 1 ) & ( pIndex->size - 1 ) )
+    {
+        if( ( pExecCmd->shmKey == pEntry->key ) &&
+            ( pExecCmd->cacheable == true ) &&
+            ( pExecCmd->ttl_ms == pEntry->ttl_ms ) &&
+            ( pExecCmd->cacheValid == false ) )
+        {
+            memset( &output, 0, sizeof( output ) );
+            WriteOutput( -1, (char *)pEntry->pData, pEntry->len, &output );
+            if( output.incomplete == true )
+            {
+                FreeOutput( &output );
+                break;
+            }
+
+            FreeOutput( &pExecCmd->cache );
+            pExecCmd->cache = output;
+            pExecCmd->cacheValid = true;
+            pExecCmd->cacheStale = false;
+            pExecCmd->expires_ms = pEntry->expires_ms;
+
+            if( pState->verbose == true )
+            {
+                printf( "restored cached output of %s\n", pExecCmd->pCmd );
+            }
+
+            return EOK;
+        }
+    }
+
+    return ENOENT;
+}
+
+/*==========================================================================*/
+/*  SaveSnapshot                                                            */
+/*!
+    Write the cache snapshot
+
+    The SaveSnapshot function writes the valid cached output of the exec
+    commands whose output expires by time alone to the cache snapshot,
+    replacing the previous snapshot, and schedules the next periodic
+    snapshot.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void SaveSnapshot( ExecVarsState *pState )
+{
+    Snapshot *pSnapshot;
+    SnapshotEntry entry;
+    ExecCmd *pExecCmd;
+
+    if( pState->pSnapshotName == NULL )
+    {
+        return;
+    }
+
+    if( pState->snapshotInterval > 0 )
+    {
+        pState->snapshot_ms = GetTimeMs() +
+                              (uint64_t)pState->snapshotInterval * 1000;
+    }
+
+    pSnapshot = SNAPSHOT_Create( pState->pSnapshotName );
+    if( pSnapshot == NULL )
+    {
+        syslog( LOG_ERR,
+                "Unable to create cache snapshot %s\n",
+                pState->pSnapshotName );
+        return;
+    }
+
+    for( pExecCmd = pState->pExecCmds;
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pNext )
+    {
+        if( ( pExecCmd->shareable == true ) &&
+            ( pExecCmd->nRefs == 0 ) &&
+            ( CacheIsValid( pExecCmd ) == true ) )
+        {
+            entry.key = pExecCmd->shmKey;
+            entry.ttl_ms = pExecCmd->ttl_ms;
+            entry.expires_ms = pExecCmd->expires_ms;
+            entry.pData = pExecCmd->cache.pData;
+            entry.len = pExecCmd->cache.len;
+            SNAPSHOT_Add( pSnapshot, &entry );
+        }
+    }
+
+    if( SNAPSHOT_Commit( pSnapshot ) != EOK )
+    {
+        syslog( LOG_ERR,
+                "Unable to write cache snapshot %s\n",
+                pState->pSnapshotName );
+    }
+}
+
+/*==========================================================================*/
+/*  SnapshotTimeout                                                         */
+/*!
+    Get the time until the next periodic cache snapshot
+
+    The SnapshotTimeout function gets the time the event loop may wait
+    for events before the next periodic cache snapshot is due.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @retval time in milliseconds until the next cache snapshot
+    @retval 0 - the cache snapshot is due
+    @retval -1 - no periodic cache snapshot is written
+
+============================================================================*/
+static int SnapshotTimeout( ExecVarsState *pState )
+{
+    uint64_t now_ms;
+
+    if( ( pState->pSnapshotName == NULL ) ||
+        ( pState->snapshotInterval <= 0 ) )
+    {
+        return -1;
+    }
+
+    now_ms = GetTimeMs();
+    if( now_ms >= pState->snapshot_ms )
+    {
+        return 0;
+    }
+
+    return ( pState->snapshot_ms - now_ms < INT_MAX )
+           ? (int)( pState->snapshot_ms - now_ms )
+           : INT_MAX;
+}
+
+/*==========================================================================*/
+/*  CacheIsValid                                                            */
+/*!
+    Check if the cached output of an exec command can be served
+
+    The CacheIsValid function checks that an exec command's cached
+    output has not been invalidated and, if the command has a time
+    to live, that it has not expired.
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to check
+
+    @retval true - the cached output can be served
+    @retval false - the command must be executed
+
+============================================================================*/
+static bool CacheIsValid( ExecCmd *pExecCmd )
+{
+    bool valid = false;
+
+    if( ( pExecCmd != NULL ) &&
+        ( pExecCmd->cacheable == true ) &&
+        ( pExecCmd->cacheValid == true ) )
+    {
+        valid = ( pExecCmd->ttl_ms == 0 ) ||
+                ( GetTimeMs() < pExecCmd->expires_ms );
+    }
+
+    return valid;
+}
+
+/*==========================================================================*/
+/*  ExecuteVar                                                              */
+/*!
+    Execute an execvar
+
+    The ExecuteVar function searches the registered execvars for the
+    specified variable handle.  If found, the command
+    associated with it is executed, and the output piped to the
+    specified output stream.  Cacheable commands are served from their
+    cached output until they expire, or one of their file dependencies or
+    network interfaces changes.  Variables with an extraction rule are
+    rendered with the value extracted from the captured command output.
+    A group variable renders the values of all of its members.  A variable
+    whose command references other exec variables is rendered once the
+    referenced values have been evaluated.  While the circuit breaker of
+    a variable's command is open, the variable's last good value, or the
+    FAILED_MARKER, is served instead of executing the command.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+        hVar
+            handle of the variable to execute
+
+    @param[in]
+        sig
+            type of signal:  one of:
+                SIG_VAR_PRINT
+                SIG_VAR_MODIFIED
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to
+
+    @retval EOK - variable executed successfully
+    @retval ENOENT - variable was not found
+    @retval EINVAL - invalid arguments
+    @retval EAGAIN - the command's circuit breaker is open
+    @retval EINPROGRESS - the print request is parked
+
+============================================================================*/
+static int ExecuteVar( ExecVarsState *pState,
+                       VAR_HANDLE hVar,
+                       int sig,
+                       int fd )
+{
+    int result = EINVAL;
+    ExecVar *pExecVar;
+    ExecCmd *pExecCmd;
+    ExtractRule *pExtract;
+    OutputBuffer capture;
+
+    if( ( pState != NULL ) &&
+        ( hVar != VAR_INVALID ) )
+    {
+        result = ENOENT;
+
+        /* apply any pending file dependency changes */
+        WATCH_Process();
+
+        pExecVar = FindExecVar( pState, hVar );
+        if( ( pExecVar != NULL ) &&
+            ( pExecVar->pGroup != NULL ) )
+        {
+            /* render every member of the group */
+            result = ( sig == SIG_VAR_PRINT )
+                        ? RenderGroup( pState, pExecVar->pGroup, fd )
+                        : ENOTSUP;
+        }
+        else if( ( pExecVar != NULL ) &&
+                 ( GetExecCmd( pState, pExecVar ) != NULL ) )
+        {
+            pExecCmd = pExecVar->pExecCmd;
+            pExtract = GetExtractRule( pExecVar );
+
+            if ( sig != SIG_VAR_PRINT )
+            {
+                result = ENOTSUP;
+            }
+            else if( BreakerOpen( pExecCmd ) == true )
+            {
+                /* the command keeps failing, so serve its last good
+                   value rather than paying to execute it */
+                pExecCmd->breakerHits++;
+                result = OutputLastGood( pExecVar, fd );
+                if( result != EOK )
+                {
+                    WriteOutput( fd,
+                                 FAILED_MARKER,
+                                 strlen( FAILED_MARKER ),
+                                 NULL );
+                    result = EAGAIN;
+                }
+            }
+            else if( pExecCmd->nRefs > 0 )
+            {
+                /* evaluate the referenced exec variables first */
+                result = RenderDependent( pState, pExecVar, fd );
+            }
+            else if( CacheIsValid( pExecCmd ) == true )
+            {
+                /* serve the cached output */
+                pExecVar->cacheHits++;
+                result = OutputValue( pExecVar, &pExecCmd->cache, fd );
+            }
+            else if( pExecCmd->cacheable == true )
+            {
+                /* execute the command and capture its output.  The
+                   output is only streamed directly if it is not
+                   subject to extraction */
+                result = RenderToCache( pState,
+                                        pExecCmd,
+                                        ( pExtract == NULL ) ? fd
+                                                             : -1 );
+                if( ( result == EOK ) &&
+                    ( pExtract != NULL ) )
+                {
+                    result = OutputValue( pExecVar, &pExecCmd->cache, fd );
+                }
+            }
+            else if( pExtract != NULL )
+            {
+                /* capture the output to extract the value from it */
+                memset( &capture, 0, sizeof( capture ) );
+                result = RunCommand( pState, pExecCmd, -1, &capture );
+                if( result == EOK )
+                {
+                    result = OutputValue( pExecVar, &capture, fd );
+                }
+
+                FreeOutput( &capture );
+            }
+            else
+            {
+                result = RunCommand( pState, pExecCmd, fd, NULL );
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  OutputValue                                                             */
+/*!
+    Write an exec variable's value to the output stream
+
+    The OutputValue function writes the value of an exec variable,
+    rendered from its command's captured output, to the output stream.
+    If the exec variable has an extraction rule, only the extracted
+    value is written.
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable to render
+
+    @param[in]
+        pOutput
+            pointer to the captured command output
+
+    @param[in]
+        fd
+            output file descriptor to write the value to
+
+    @retval EOK - the value was written
+    @retval ENOENT - the value could not be extracted
+
+============================================================================*/
+static int OutputValue( ExecVar *pExecVar, OutputBuffer *pOutput, int fd )
+{
+    int result;
+    const char *pValue;
+    size_t valueLen;
+    OutputBuffer *pShared;
+
+    result = GetValue( pExecVar,
+                       pOutput->pData,
+                       pOutput->len,
+                       &pValue,
+                       &valueLen );
+    if( result == EOK )
+    {
+        /* a slow client may hold on to the command output rather than
+           copying its value */
+        pShared = state.pShared;
+        state.pShared = pOutput;
+        WriteOutput( fd, (char *)pValue, valueLen, NULL );
+        state.pShared = pShared;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  GetValue                                                                */
+/*!
+    Get an exec variable's value from its command output
+
+    The GetValue function gets the value of an exec variable from its
+    command's captured output.  If the exec variable has an extraction
+    rule, the value is extracted from the output, otherwise the value is
+    the full command output.  The value refers to the command output.
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable to render
+
+    @param[in]
+        pData
+            pointer to the captured command output
+
+    @param[in]
+        len
+            length of the captured command output
+
+    @param[out]
+        ppValue
+            pointer to a location to store a pointer to the value
+
+    @param[out]
+        pValueLen
+            pointer to a location to store the length of the value
+
+    @retval EOK - the value was found
+    @retval ENOENT - the value could not be extracted
+
+============================================================================*/
+static int GetValue( ExecVar *pExecVar,
+                     char *pData,
+                     size_t len,
+                     const char **ppValue,
+                     size_t *pValueLen )
+{
+    int result = EOK;
+    ExtractRule *pExtract = GetExtractRule( pExecVar );
+    uint64_t start;
+
+    *ppValue = pData;
+    *pValueLen = len;
+
+    if( pExtract != NULL )
+    {
+        start = GetTimeNs();
+
+        result = EXTRACT_Apply( pExtract,
+                                pData,
+                                len,
+                                ppValue,
+                                pValueLen );
+
+        pExecVar->extractTime_ns += GetTimeNs() - start;
+        pExecVar->extractCount++;
+        if( result != EOK )
+        {
+            pExecVar->extractFailures++;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  RenderGroup                                                             */
+/*!
+    Render an execvar group
+
+    The RenderGroup function renders the members of an exec group as one
+    JSON object mapping each member's name to its value.  The commands of
+    the members are evaluated together, so the commands which cannot be
+    served from their cache are executed concurrently, and the group takes
+    as long as its slowest command rather than the sum of its commands.
+    Members which share a command are rendered from a single execution.
+
+    Members whose value cannot be rendered are rendered as null.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecGroup
+            pointer to the exec group to render
+
+    @param[in]
+        fd
+            output file descriptor to write the JSON object to
+
+    @retval EOK - the group was rendered
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int RenderGroup( ExecVarsState *pState, ExecGroup *pExecGroup, int fd )
+{
+    ExecEval eval;
+    ExecCmd *pExecCmd;
+    OutputBuffer doc;
+    int result = EOK;
+    int i;
+
+    /* execute the member commands concurrently */
+    BeginEvaluation( pState, &eval );
+
+    for( i = 0; i < pExecGroup->nMembers; i++ )
+    {
+        pExecCmd = GetExecCmd( pState, pExecGroup->ppMembers[i] );
+        if( pExecCmd != NULL )
+        {
+            VisitExecCmd( pState, &eval, pExecCmd );
+        }
+    }
+
+    Evaluate( pState, &eval );
+
+    /* build the JSON object from the member values */
+    memset( &doc, 0, sizeof( doc ) );
+    WriteOutput( -1, "{", 1, &doc );
+
+    for( i = 0; i < pExecGroup->nMembers; i++ )
+    {
+        if( i > 0 )
+        {
+            WriteOutput( -1, ",", 1, &doc );
+        }
+
+        AppendJSONString( &doc,
+                          pExecGroup->ppMembers[i]->pName,
+                          strlen( pExecGroup->ppMembers[i]->pName ) );
+        WriteOutput( -1, ":", 1, &doc );
+        AppendGroupValue( pExecGroup->ppMembers[i], &doc );
+    }
+
+    WriteOutput( -1, "}", 1, &doc );
+
+    if( doc.incomplete == false )
+    {
+        WriteOutput( fd, doc.pData, doc.len, NULL );
+    }
+    else
+    {
+        result = ENOMEM;
+    }
+
+    EndEvaluation( &eval );
+    FreeOutput( &doc );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  AppendGroupValue                                                        */
+/*!
+    Append the value of a group member to the group document
+
+    The AppendGroupValue function appends the value of a group member to
+    the group's JSON document as a JSON string.  The value is taken from
+    the output of the member's command in the group's evaluation.
+    Trailing new lines and NUL characters are removed from the value.
+    If the value cannot be rendered, null is appended.
+
+    @param[in]
+       pExecVar
+            pointer to the group member
+
+    @param[in,out]
+        pDoc
+            pointer to the group document
+
+    @return none
+
+============================================================================*/
+static void AppendGroupValue( ExecVar *pExecVar, OutputBuffer *pDoc )
+{
+    ExecCmd *pExecCmd = pExecVar->pExecCmd;
+    OutputBuffer *pOutput = NULL;
+    const char *pValue;
+    size_t len;
+
+    if( pExecCmd != NULL )
+    {
+        pOutput = pExecCmd->pOutput;
+        if( ( pOutput != NULL ) &&
+            ( pExecCmd->evalCached == true ) )
+        {
+            /* the member is served from the cached output */
+            pExecVar->cacheHits++;
+        }
+    }
+
+    if( ( pOutput != NULL ) &&
+        ( GetValue( pExecVar,
+                    pOutput->pData,
+                    pOutput->len,
+                    &pValue,
+                    &len ) == EOK ) )
+    {
+        AppendJSONString( pDoc, pValue, TrimValue( pValue, len ) );
+    }
+    else
+    {
+        WriteOutput( -1, "null", 4, pDoc );
+    }
+}
+
+/*==========================================================================*/
+/*  TrimValue                                                               */
+/*!
+    Remove the line ending from a value
+
+    The TrimValue function gets the length of a value without its
+    trailing new lines and NUL characters.
+
+    @param[in]
+        pValue
+            pointer to the value
+
+    @param[in]
+        len
+            length of the value
+
+    @retval length of the trimmed value
+
+============================================================================*/
+static size_t TrimValue( const char *pValue, size_t len )
+{
+    while( ( len > 0 ) &&
+           ( ( pValue[len - 1] == '\n' ) ||
+             ( pValue[len - 1] == '\r' ) ||
+             ( pValue[len - 1] == '\0' ) ) )
+    {
+        len--;
+    }
+
+    return len;
+}
+
+/*==========================================================================*/
+/*  ResolveReferences                                                       */
+/*!
+    Build the exec variable dependency graph
+
+    The ResolveReferences function finds the exec variables referenced by
+    the command sequence of every exec command, and checks the resulting
+    dependency graph for cycles.  Commands which are part of a cycle, or
+    which reference a command which is, are logged, and are never
+    executed.
+
+    It must be called after PurgeExecVars, as the references refer to the
+    exec variables directly.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void ResolveReferences( ExecVarsState *pState )
+{
+    ExecEval eval;
+    ExecCmd *pExecCmd;
+    int i;
+
+    for( pExecCmd = pState->pExecCmds;
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pNext )
+    {
+        SetupReferences( pState, pExecCmd );
+    }
+
+    /* visit the whole graph to find the cycles */
+    BeginEvaluation( pState, &eval );
+
+    for( pExecCmd = pState->pExecCmds;
+         pExecCmd != NULL;
+         pExecCmd = pExecCmd->pNext )
+    {
+        if( pExecCmd->nRefs > 0 )
+        {
+            VisitExecCmd( pState, &eval, pExecCmd );
+        }
+    }
+
+    for( i = 0; i < eval.nOrder; i++ )
+    {
+        if( eval.ppOrder[i]->evalLevel < 0 )
+        {
+            syslog( LOG_ERR,
+                    "Dependency cycle in command %s\n",
+                    eval.ppOrder[i]->pCmd );
+        }
+    }
+
+    EndEvaluation( &eval );
+}
+
+/*==========================================================================*/
+/*  SetupReferences                                                         */
+/*!
+    Find the exec variables referenced by a command
+
+    The SetupReferences function looks up the exec variable of every
+    "${/name}" reference in an exec command's command sequence.  Unknown
+    references, references to groups, and references inside quotes are
+    logged, and prevent the command from being executed.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command
+
+    @return none
+
+============================================================================*/
+static void SetupReferences( ExecVarsState *pState, ExecCmd *pExecCmd )
+{
+    ReferenceContext ctx;
+    int n;
+
+    free( pExecCmd->ppRefs );
+    pExecCmd->ppRefs = NULL;
+    pExecCmd->nRefs = 0;
+
+    n = REFERENCE_Iterate( pExecCmd->pCmd, NULL, NULL );
+    if( n < 0 )
+    {
+        /* the command cannot be executed without its references */
+        syslog( LOG_ERR, "Invalid reference in command %s\n", pExecCmd->pCmd );
+        pExecCmd->nRefs = 1;
+        return;
+    }
+
+    if( n == 0 )
+    {
+        return;
+    }
+
+    pExecCmd->ppRefs = calloc( n, sizeof( ExecVar * ) );
+    if( pExecCmd->ppRefs == NULL )
+    {
+        /* the command cannot be executed without its references */
+        syslog( LOG_ERR,
+                "Unable to set up the references of command %s\n",
+                pExecCmd->pCmd );
+        pExecCmd->nRefs = n;
+        return;
+    }
+
+    ctx.pState = pState;
+    ctx.pExecCmd = pExecCmd;
+    REFERENCE_Iterate( pExecCmd->pCmd, AddReference, &ctx );
+}
+
+/*==========================================================================*/
+/*  AddReference                                                            */
+/*!
+    Add a reference to an exec command
+
+    The AddReference function is a callback for the REFERENCE_Iterate
+    function which appends the exec variable with the referenced name
+    to the references of an exec command.
+
+    @param[in]
+       name
+            pointer to the NUL terminated name of the referenced variable
+
+    @param[in]
+        arg
+            opaque pointer argument used for the reference context
+
+    @retval EOK - the reference was added
+    @retval ENOENT - the referenced variable is not an exec variable
+
+============================================================================*/
+static int AddReference( const char *name, void *arg )
+{
+    ReferenceContext *pCtx = (ReferenceContext *)arg;
+    ExecCmd *pExecCmd = pCtx->pExecCmd;
+    ExecVar *pExecVar;
+
+    pExecVar = FindExecVarByName( pCtx->pState, name, HashString( name ) );
+    if( ( pExecVar != NULL ) &&
+        ( pExecVar->pGroup != NULL ) )
+    {
+        pExecVar = NULL;
+    }
+
+    if( pExecVar == NULL )
+    {
+        syslog( LOG_ERR,
+                "Unknown execvar %s referenced by command %s\n",
+                name,
+                pExecCmd->pCmd );
+    }
+
+    pExecCmd->ppRefs[pExecCmd->nRefs++] = pExecVar;
+
+    return ( pExecVar != NULL ) ? EOK : ENOENT;
+}
+
+/*==========================================================================*/
+/*  RenderDependent                                                         */
+/*!
+    Render an exec variable whose command references other exec variables
+
+    The RenderDependent function evaluates the exec variables referenced
+    by the command of an exec variable, then executes the command with the
+    referenced values substituted, and writes the variable's value to the
+    output stream.  Each referenced command is executed at most once, and
+    referenced commands which do not depend on each other are executed
+    concurrently.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecVar
+            pointer to the exec variable to render
+
+    @param[in]
+        fd
+            output file descriptor to write the value to
+
+    @retval EOK - the exec variable was rendered
+    @retval ENOENT - the exec variable could not be rendered
+
+============================================================================*/
+static int RenderDependent( ExecVarsState *pState,
+                            ExecVar *pExecVar,
+                            int fd )
+{
+    ExecCmd *pExecCmd = pExecVar->pExecCmd;
+    ExecEval eval;
+    int result = ENOENT;
+
+    BeginEvaluation( pState, &eval );
+    VisitExecCmd( pState, &eval, pExecCmd );
+    Evaluate( pState, &eval );
+
+    if( pExecCmd->pOutput != NULL )
+    {
+        if( pExecCmd->evalCached == true )
+        {
+            pExecVar->cacheHits++;
+        }
+
+        result = OutputValue( pExecVar, pExecCmd->pOutput, fd );
+    }
+
+    EndEvaluation( &eval );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  BeginEvaluation                                                         */
+/*!
+    Begin an evaluation
+
+    The BeginEvaluation function initializes an evaluation of a set of
+    exec commands.  The commands are added to the evaluation with
+    VisitExecCmd, evaluated with Evaluate, and their outputs are
+    available until EndEvaluation is called.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[out]
+       pEval
+            pointer to the evaluation to initialize
+
+    @return none
+
+============================================================================*/
+static void BeginEvaluation( ExecVarsState *pState, ExecEval *pEval )
+{
+    memset( pEval, 0, sizeof( ExecEval ) );
+
+    /* serial number 0 is never used, so new commands are unvisited */
+    if( ++pState->evalSerial == 0 )
+    {
+        pState->evalSerial++;
+    }
+
+    pEval->serial = pState->evalSerial;
+}
+
+/*==========================================================================*/
+/*  VisitExecCmd                                                            */
+/*!
+    Add an exec command to an evaluation
+
+    The VisitExecCmd function adds an exec command, and every command it
+    references (directly or indirectly), to an evaluation.  The commands
+    are added after the commands they reference, and each command's
+    dependency level is one more than the highest level of the commands
+    it references, so the commands at the same level are independent.
+    Each command is added once.
+
+    A command which references itself through a cycle, an unknown exec
+    variable, or a command which cannot be evaluated, gets a level of -1.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in,out]
+       pEval
+            pointer to the evaluation
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to add
+
+    @retval the dependency level of the command
+    @retval -1 - the command cannot be evaluated
+
+============================================================================*/
+static int VisitExecCmd( ExecVarsState *pState,
+                         ExecEval *pEval,
+                         ExecCmd *pExecCmd )
+{
+    ExecCmd **ppOrder;
+    ExecCmd *pRefCmd;
+    ExecVar *pRefVar;
+    int level = 0;
+    int refLevel;
+    int size;
+    int i;
+
+    if( pExecCmd->evalSerial == pEval->serial )
+    {
+        /* the command was already visited, or is part of a cycle */
+        return ( pExecCmd->evalActive == true ) ? -1 : pExecCmd->evalLevel;
+    }
+
+    pExecCmd->evalSerial = pEval->serial;
+    pExecCmd->evalActive = true;
+    pExecCmd->evalCached = false;
+    pExecCmd->pOutput = NULL;
+
+    if( ( pExecCmd->nRefs > 0 ) &&
+        ( pExecCmd->ppRefs == NULL ) )
+    {
+        level = -1;
+    }
+
+    for( i = 0; ( i < pExecCmd->nRefs ) && ( level >= 0 ); i++ )
+    {
+        pRefVar = pExecCmd->ppRefs[i];
+        pRefCmd = ( pRefVar != NULL ) ? GetExecCmd( pState, pRefVar ) : NULL;
+        if( pRefCmd == NULL )
+        {
+            level = -1;
+            break;
+        }
+
+        refLevel = VisitExecCmd( pState, pEval, pRefCmd );
+        if( refLevel < 0 )
+        {
+            level = -1;
+        }
+        else if( refLevel >= level )
+        {
+            level = refLevel + 1;
+        }
+    }
+
+    pExecCmd->evalActive = false;
+    pExecCmd->evalLevel = level;
+
+    if( pEval->nOrder == pEval->size )
+    {
+        size = ( pEval->size > 0 ) ? pEval->size * 2 : 16;
+        ppOrder = realloc( pEval->ppOrder, size * sizeof( ExecCmd * ) );
+        if( ppOrder == NULL )
+        {
+            /* the command is not evaluated */
+            pExecCmd->evalLevel = -1;
+            return -1;
+        }
+
+        pEval->ppOrder = ppOrder;
+        pEval->size = size;
+    }
+
+    pEval->ppOrder[pEval->nOrder++] = pExecCmd;
+
+    return pExecCmd->evalLevel;
+}
+
+/*==========================================================================*/
+/*  Evaluate                                                                */
+/*!
+    Evaluate the exec commands of an evaluation
+
+    The Evaluate function renders the output of every exec command in an
+    evaluation, one dependency level at a time.  The commands of each
+    level which cannot be served from their cache are executed
+    concurrently, and the level completes when its slowest command
+    completes.  The referenced values of each command are substituted into
+    its command sequence from the outputs of the previous levels.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in,out]
+       pEval
+            pointer to the evaluation
+
+    @return none
+
+============================================================================*/
+static void Evaluate( ExecVarsState *pState, ExecEval *pEval )
+{
+    int maxLevel = -1;
+    int level;
+    int first;
+    int i;
+
+    if( pEval->nOrder == 0 )
+    {
+        return;
+    }
+
+    pEval->pJobs = calloc( pEval->nOrder, sizeof( ExecJob ) );
+    if( pEval->pJobs == NULL )
+    {
+        return;
+    }
+
+    for( i = 0; i < pEval->nOrder; i++ )
+    {
+        if( pEval->ppOrder[i]->evalLevel > maxLevel )
+        {
+            maxLevel = pEval->ppOrder[i]->evalLevel;
+        }
+    }
+
+    for( level = 0; level <= maxLevel; level++ )
+    {
+        first = pEval->nJobs;
+
+        for( i = 0; i < pEval->nOrder; i++ )
+        {
+            if( pEval->ppOrder[i]->evalLevel == level )
+            {
+                PrepareExecCmd( pEval, pEval->ppOrder[i] );
+            }
+        }
+
+        RunJobs( pState, &pEval->pJobs[first], pEval->nJobs - first );
+
+        for( i = first; i < pEval->nJobs; i++ )
+        {
+            CompleteJob( &pEval->pJobs[i] );
+        }
+
+        if( ( pState->pSession != NULL ) &&
+            ( pState->pSession->failed == true ) )
+        {
+            /* nobody wants the output of the remaining levels */
+            break;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  PrepareExecCmd                                                          */
+/*!
+    Prepare an exec command to be evaluated
+
+    The PrepareExecCmd function serves an exec command from its cache if
+    the cached output is valid, and, for a command with references, was
+    rendered with the current referenced values.  Otherwise the command is
+    started, with the referenced values substituted into it, unless its
+    circuit breaker is open, in which case its last good output is used.
+
+    @param[in,out]
+       pEval
+            pointer to the evaluation
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to prepare
+
+    @return none
+
+============================================================================*/
+static void PrepareExecCmd( ExecEval *pEval, ExecCmd *pExecCmd )
+{
+    char *pCmdBuf = NULL;
+
+    if( pExecCmd->nRefs > 0 )
+    {
+        pCmdBuf = ExpandReferences( pExecCmd );
+        if( pCmdBuf == NULL )
+        {
+            /* a referenced value could not be rendered */
+            return;
+        }
+    }
+
+    if( ( CacheIsValid( pExecCmd ) == true ) &&
+        ( ( pCmdBuf == NULL ) ||
+          ( ( pExecCmd->pExpanded != NULL ) &&
+            ( strcmp( pExecCmd->pExpanded, pCmdBuf ) == 0 ) ) ) )
+    {
+        /* serve the cached output */
+        pExecCmd->pOutput = &pExecCmd->cache;
+        pExecCmd->evalCached = true;
+        free( pCmdBuf );
+    }
+    else if( BreakerOpen( pExecCmd ) == true )
+    {
+        /* don't execute a command which keeps failing */
+        pExecCmd->breakerHits++;
+        if( ( pExecCmd->cacheValid == true ) ||
+            ( pExecCmd->cacheStale == true ) )
+        {
+            pExecCmd->pOutput = &pExecCmd->cache;
+            pExecCmd->evalCached = true;
+        }
+
+        free( pCmdBuf );
+    }
+    else
+    {
+        StartJob( pEval, pExecCmd, pCmdBuf );
+    }
+}
+
+/*==========================================================================*/
+/*  ExpandReferences                                                        */
+/*!
+    Substitute the referenced values into a command
+
+    The ExpandReferences function gets the value of every exec variable
+    referenced by an exec command from its command's output in the
+    current evaluation, and substitutes the values into the command
+    sequence.  Trailing new lines are removed from the values.
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command
+
+    @retval pointer to the dynamically allocated command sequence
+    @retval NULL - a referenced value could not be rendered
+
+============================================================================*/
+static char *ExpandReferences( ExecCmd *pExecCmd )
+{
+    const char **ppValues;
+    size_t *pLens;
+    ExecVar *pRefVar;
+    OutputBuffer *pOutput;
+    char *pCmd = NULL;
+    int i;
+
+    ppValues = calloc( pExecCmd->nRefs, sizeof( char * ) );
+    pLens = calloc( pExecCmd->nRefs, sizeof( size_t ) );
+    if( ( ppValues != NULL ) &&
+        ( pLens != NULL ) )
+    {
+        for( i = 0; i < pExecCmd->nRefs; i++ )
+        {
+            pRefVar = pExecCmd->ppRefs[i];
+            pOutput = pRefVar->pExecCmd->pOutput;
+            if( ( pOutput == NULL ) ||
+                ( GetValue( pRefVar,
+                            pOutput->pData,
+                            pOutput->len,
+                            &ppValues[i],
+                            &pLens[i] ) != EOK ) )
+            {
+                break;
+            }
+
+            pLens[i] = TrimValue( ppValues[i], pLens[i] );
+        }
+
+        if( i == pExecCmd->nRefs )
+        {
+            pCmd = REFERENCE_Expand( pExecCmd->pCmd,
+                                     ppValues,
+                                     pLens,
+                                     pExecCmd->nRefs );
+        }
+    }
+
+    free( ppValues );
+    free( pLens );
+
+    return pCmd;
+}
+
+/*==========================================================================*/
+/*  StartJob                                                                */
+/*!
+    Start an exec command
+
+    The StartJob function starts executing an exec command as a job of
+    an evaluation.  The command output is read by RunJobs.
+
+    @param[in,out]
+       pEval
+            pointer to the evaluation
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to start
+
+    @param[in]
+        pCmdBuf
+            pointer to the dynamically allocated command sequence with the
+            referenced values substituted, which the job takes ownership
+            of, or NULL to execute the command's own command sequence
+
+    @return none
+
+============================================================================*/
+static void StartJob( ExecEval *pEval, ExecCmd *pExecCmd, char *pCmdBuf )
+{
+    ExecJob *pJob = &pEval->pJobs[pEval->nJobs++];
+
+    pJob->pExecCmd = pExecCmd;
+    pJob->pCmdBuf = pCmdBuf;
+    pJob->start_ns = GetTimeNs();
+    pJob->result = ENOENT;
+
+    /* commands with substituted values are executed by the shell */
+    state.childPriority = pExecCmd->priority;
+    pJob->fp = popen2( ( pCmdBuf != NULL ) ? pCmdBuf : pExecCmd->pCmd,
+                       ( pCmdBuf != NULL ) ? NULL : pExecCmd->ppArgv,
+                       "r",
+                       &pJob->pid );
+    if( pJob->fp != NULL )
+    {
+        pJob->running = true;
+    }
+}
+
+/*==========================================================================*/
+/*  RunJobs                                                                 */
+/*!
+    Capture the output of concurrently running commands
+
+    The RunJobs function waits for output from all of the running
+    commands at once, and captures it until each command ends its
+    output.  Each command is reaped as soon as it ends its output.  If a
+    timeout is configured, the commands which are still running when it
+    expires are terminated.  If the client of the print session being
+    rendered goes away, the commands which are still running are
+    cancelled.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in,out]
+        pJobs
+            pointer to the array of jobs
+
+    @param[in]
+        nJobs
+            number of jobs
+
+    @return none
+
+============================================================================*/
+static void RunJobs( ExecVarsState *pState, ExecJob *pJobs, int nJobs )
+{
+    struct pollfd *pfds;
+    ExecJob **ppRunning;
+    ExecJob *pJob;
+    char buf[BUFSIZ];
+    uint64_t deadline_ms = 0;
+    uint64_t now_ms;
+    bool waiting = true;
+    bool cancelled = false;
+    int timeout_ms;
+    int nRunning;
+    int result;
+    size_t len;
+    int n;
+    int i;
+
+    if( nJobs == 0 )
+    {
+        return;
+    }
+
+    /* one extra descriptor watches for the client going away */
+    pfds = calloc( nJobs + 1, sizeof( struct pollfd ) );
+    ppRunning = calloc( nJobs, sizeof( ExecJob * ) );
+    if( ( pfds == NULL ) ||
+        ( ppRunning == NULL ) )
+    {
+        /* terminate the commands below */
+        waiting = false;
+    }
+
+    if( pState->timeout_seconds > 0 )
+    {
+        deadline_ms = GetTimeMs() + (uint64_t)pState->timeout_seconds * 1000;
+    }
+
+    while( waiting == true )
+    {
+        nRunning = 0;
+        for( i = 0; i < nJobs; i++ )
+        {
+            if( pJobs[i].running == true )
+            {
+                pfds[nRunning].fd = fileno( pJobs[i].fp );
+                pfds[nRunning].events = POLLIN;
+                ppRunning[nRunning++] = &pJobs[i];
+            }
+        }
+
+        if( nRunning == 0 )
+        {
+            break;
+        }
+
+        timeout_ms = -1;
+        if( deadline_ms > 0 )
+        {
+            now_ms = GetTimeMs();
+            if( now_ms >= deadline_ms )
+            {
+                break;
+            }
+
+            timeout_ms = (int)( deadline_ms - now_ms );
+        }
+
+        pfds[nRunning].fd = GetClientFd( ( pState->pSession != NULL )
+                                            ? pState->pSession->fd
+                                            : -1 );
+        pfds[nRunning].events = 0;
+
+        result = poll( pfds, nRunning + 1, timeout_ms );
+        if( result < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if( pfds[nRunning].revents != 0 )
+        {
+            /* the client went away, so nobody wants the output */
+            pState->pSession->failed = true;
+            cancelled = true;
+            break;
+        }
+
+        for( i = 0; i < nRunning; i++ )
+        {
+            if( pfds[i].revents == 0 )
+            {
+                continue;
+            }
+
+            pJob = ppRunning[i];
+
+            /* read a buffer of output */
+            n = read( pfds[i].fd, buf, BUFSIZ );
+            if( n > 0 )
+            {
+                /* keep the output up to the command's output limit */
+                len = LimitOutput( pJob->pExecCmd->maxOutput,
+                                   &pJob->outputBytes,
+                                   n );
+                WriteOutput( -1, buf, len, &pJob->output );
+                if( len < (size_t)n )
+                {
+                    pJob->overflowed = true;
+                }
+
+                if( ( len == (size_t)n ) ||
+                    ( pJob->pExecCmd->killOnOverflow == false ) )
+                {
+                    continue;
+                }
+            }
+
+            if( n != 0 )
+            {
+                KillCommand( pJob->pid );
+            }
+
+            /* reap the command */
+            fclose( pJob->fp );
+            pJob->fp = NULL;
+            pJob->running = false;
+            pJob->result = WaitCommand( pJob->pid, &pJob->status );
+            if( n < 0 )
+            {
+                pJob->result = EINVAL;
+            }
+            else if( n > 0 )
+            {
+                pJob->result = EFBIG;
+            }
+
+            if( pJob->overflowed == true )
+            {
+                RecordOverflow( pJob->pExecCmd );
+            }
+
+            RecordExecution( pState,
+                             pJob->pExecCmd,
+                             ( GetTimeNs() - pJob->start_ns ) / 1000,
+                             pJob->result,
+                             pJob->status );
+        }
+    }
+
+    /* terminate the commands which did not complete */
+    for( pJob = pJobs; pJob < &pJobs[nJobs]; pJob++ )
+    {
+        if( pJob->running == true )
+        {
+            if( cancelled == true )
+            {
+                pJob->result = ECANCELED;
+            }
+            else
+            {
+                syslog( LOG_ERR,
+                        "Timeout %d seconds exceeded for command %s\n",
+                        pState->timeout_seconds,
+                        pJob->pExecCmd->pCmd );
+                pJob->result = EINVAL;
+            }
+
+            KillCommand( pJob->pid );
+            fclose( pJob->fp );
+            pJob->fp = NULL;
+            pJob->running = false;
+            WaitCommand( pJob->pid, NULL );
+            RecordExecution( pState,
+                             pJob->pExecCmd,
+                             ( GetTimeNs() - pJob->start_ns ) / 1000,
+                             pJob->result,
+                             -1 );
+        }
+    }
+
+    free( pfds );
+    free( ppRunning );
+}
+
+/*==========================================================================*/
+/*  CompleteJob                                                             */
+/*!
+    Complete an exec command
+
+    The CompleteJob function makes the output of a completed job the
+    output of its command in the evaluation.  The output of a cacheable
+    command which succeeded is moved into the command's cache, together
+    with the substituted command sequence which rendered it.
+
+    @param[in,out]
+        pJob
+            pointer to the completed job
+
+    @return none
+
+============================================================================*/
+static void CompleteJob( ExecJob *pJob )
+{
+    ExecCmd *pExecCmd = pJob->pExecCmd;
+
+    if( pJob->result != EOK )
+    {
+        pExecCmd->pOutput = NULL;
+    }
+    else if( ( pExecCmd->cacheable == true ) &&
+             ( pJob->output.incomplete == false ) )
+    {
+        /* hand the captured output to the command's cache */
+        FreeOutput( &pExecCmd->cache );
+        pExecCmd->cache = pJob->output;
+        pExecCmd->cacheValid = true;
+        pExecCmd->cacheStale = false;
+        pExecCmd->expires_ms = GetTimeMs() + pExecCmd->ttl_ms;
+        memset( &pJob->output, 0, sizeof( OutputBuffer ) );
+
+        free( pExecCmd->pExpanded );
+        pExecCmd->pExpanded = pJob->pCmdBuf;
+        pJob->pCmdBuf = NULL;
+
+        pExecCmd->pOutput = &pExecCmd->cache;
+    }
+    else
+    {
+        pExecCmd->pOutput = &pJob->output;
+    }
+}
+
+/*==========================================================================*/
+/*  EndEvaluation                                                           */
+/*!
+    End an evaluation
+
+    The EndEvaluation function releases the outputs and substituted
+    command sequences of the jobs of an evaluation.  The outputs of the
+    evaluated commands are no longer available.
+
+    @param[in,out]
+       pEval
+            pointer to the evaluation
+
+    @return none
+
+============================================================================*/
+static void EndEvaluation( ExecEval *pEval )
+{
+    int i;
+
+    for( i = 0; i < pEval->nOrder; i++ )
+    {
+        pEval->ppOrder[i]->pOutput = NULL;
+    }
+
+    for( i = 0; i < pEval->nJobs; i++ )
+    {
+        FreeOutput( &pEval->pJobs[i].output );
+        free( pEval->pJobs[i].pCmdBuf );
+    }
+
+    free( pEval->pJobs );
+    free( pEval->ppOrder );
+
+    memset( pEval, 0, sizeof( ExecEval ) );
+}
+
+/*==========================================================================*/
+/*  AppendJSONString                                                        */
+/*!
+    Append a JSON string to a document
+
+    The AppendJSONString function appends a string to a document as a
+    quoted JSON string, escaping quotes, backslashes, and control
+    characters.
+
+    @param[in,out]
+        pDoc
+            pointer to the document
+
+    @param[in]
+        pData
+            pointer to the string data
+
+    @param[in]
+        len
+            length of the string data
+
+    @return none
+
+============================================================================*/
+static void AppendJSONString( OutputBuffer *pDoc,
+                              const char *pData,
+                              size_t len )
+{
+    char buf[8];
+    size_t start = 0;
+    size_t i;
+    unsigned char c;
+
+    WriteOutput( -1, "\"", 1, pDoc );
+
+    for( i = 0; i < len; i++ )
+    {
+        c = (unsigned char)pData[i];
+        if( ( c >= 0x20 ) &&
+            ( c != '"' ) &&
+            ( c != '\\' ) )
+        {
+            continue;
+        }
+
+        /* copy the unescaped characters before this one */
+        WriteOutput( -1, (char *)&pData[start], i - start, pDoc );
+        start = i + 1;
+
+        switch( c )
+        {
+            case '"':
+                WriteOutput( -1, "\\\"", 2, pDoc );
+                break;
+
+            case '\\':
+                WriteOutput( -1, "\\\\", 2, pDoc );
+                break;
+
+            case '\n':
+                WriteOutput( -1, "\\n", 2, pDoc );
+                break;
+
+            case '\r':
+                WriteOutput( -1, "\\r", 2, pDoc );
+                break;
+
+            case '\t':
+                WriteOutput( -1, "\\t", 2, pDoc );
+                break;
+
+            default:
+                snprintf( buf, sizeof( buf ), "\\u%04x", c );
+                WriteOutput( -1, buf, 6, pDoc );
+                break;
+        }
+    }
+
+    WriteOutput( -1, (char *)&pData[start], i - start, pDoc );
+    WriteOutput( -1, "\"", 1, pDoc );
+}
+
+/*==========================================================================*/
+/*  GetTimeMs                                                               */
+/*!
+    Get the monotonic time
+
+    The GetTimeMs function gets the current value of the monotonic clock
+    in milliseconds.
+
+    @retval the monotonic time in milliseconds
+
+============================================================================*/
+static uint64_t GetTimeMs( void )
+{
+    return GetTimeNs() / 1000000;
+}
+
+/*==========================================================================*/
+/*  GetTimeNs                                                               */
+/*!
+    Get the monotonic time
+
+    The GetTimeNs function gets the current value of the monotonic clock
+    in nanoseconds.
+
+    @retval the monotonic time in nanoseconds
+
+============================================================================*/
+static uint64_t GetTimeNs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*==========================================================================*/
+/*  RunCommand                                                              */
+/*!
+    Execute an exec command, retrying transient failures
+
+    The RunCommand function executes the command sequence of an exec
+    command.  If the command is configured with retries, an execution
+    which fails transiently, ie. which exits with a non-zero status, is
+    killed by a signal, or times out, is retried after a delay which
+    doubles with every retry.  No retry is started once the command's
+    retry budget would be exceeded, or once its circuit breaker opens.
+    The print request is parked in the print request queue while the
+    command backs off, so the event loop keeps serving other requests,
+    and every print request for the command waits for the pending retry.
+    A command rendered outside of a print session is not retried.
+
+    The output of a command with retries is captured, and is only written
+    to the output stream once the final execution has completed, so the
+    output of a failed execution is never mixed into it.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to execute
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to,
+            or -1 to only capture the output
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - the command failed or timed out
+    @retval EFBIG - the command was killed for exceeding its output limit
+    @retval ECANCELED - the client went away
+    @retval EINPROGRESS - the print request is parked
+
+============================================================================*/
+static int RunCommand( ExecVarsState *pState,
+                       ExecCmd *pExecCmd,
+                       int fd,
+                       OutputBuffer *pCapture )
+{
+    OutputBuffer output;
+    uint64_t now_ms;
+    int result;
+
+    if( ( pExecCmd->retries <= 0 ) ||
+        ( pState->pSession == NULL ) )
+    {
+        return RunAttempt( pState, pExecCmd, fd, pCapture );
+    }
+
+    now_ms = GetTimeMs();
+    if( pExecCmd->retryAt_ms == 0 )
+    {
+        /* start a new series of executions */
+        pExecCmd->retryAttempt = 0;
+        pExecCmd->retryStart_ms = now_ms;
+        pExecCmd->retryNext_ms = pExecCmd->retryDelay_ms;
+    }
+    else if( now_ms < pExecCmd->retryAt_ms )
+    {
+        /* wait for the pending retry */
+        DeferRequest( pState, pExecCmd->retryAt_ms );
+        return EINPROGRESS;
+    }
+
+    memset( &output, 0, sizeof( output ) );
+
+    result = RunAttempt( pState, pExecCmd, -1, &output );
+    pExecCmd->retryAt_ms = 0;
+
+    now_ms = GetTimeMs();
+    if( ( result != EOK ) &&
+        ( IsTransient( result ) == true ) &&
+        ( pExecCmd->retryAttempt < pExecCmd->retries ) &&
+        ( BreakerOpen( pExecCmd ) == false ) &&
+        ( ClientGone( fd ) == false ) &&
+        ( now_ms + pExecCmd->retryNext_ms - pExecCmd->retryStart_ms <=
+            pExecCmd->retryBudget_ms ) )
+    {
+        pExecCmd->retryAttempt++;
+        pExecCmd->retryCount++;
+
+        if( pState->verbose == true )
+        {
+            printf( "retrying %s after %" PRIu64 " ms\n",
+                    pExecCmd->pCmd,
+                    pExecCmd->retryNext_ms );
+        }
+
+        /* back off from the event loop before retrying */
+        pExecCmd->retryAt_ms = now_ms + pExecCmd->retryNext_ms;
+        pExecCmd->retryNext_ms *= 2;
+        DeferRequest( pState, pExecCmd->retryAt_ms );
+
+        FreeOutput( &output );
+        return EINPROGRESS;
+    }
+
+    SendOutput( fd, &output, pCapture );
+    FreeOutput( &output );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  RunAttempt                                                              */
+/*!
+    Execute an exec command once and record its execution
+
+    The RunAttempt function executes the command sequence of an exec
+    command once, hedging the execution if it is slow, and updates the
+    command's execution statistics.  The output of the execution is
+    limited to the command's maximum output size.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to execute
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to,
+            or -1 to only capture the output
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - the command failed or timed out
+    @retval EFBIG - the command was killed for exceeding its output limit
+    @retval ECANCELED - the client went away
+
+============================================================================*/
+static int RunAttempt( ExecVarsState *pState,
+                       ExecCmd *pExecCmd,
+                       int fd,
+                       OutputBuffer *pCapture )
+{
+    int result;
+    int status = -1;
+    uint64_t start;
+    uint64_t delay_ms;
+
+    start = GetTimeNs();
+
+    pState->childPriority = pExecCmd->priority;
+    pState->childMaxOutput = pExecCmd->maxOutput;
+    pState->childKillOnOverflow = pExecCmd->killOnOverflow;
+    pState->childOverflowed = false;
+
+    delay_ms = HedgeDelay( pExecCmd );
+    if( delay_ms > 0 )
+    {
+        /* cut the tail latency of a command with erratic run times */
+        result = ExecuteHedged( pState,
+                                pExecCmd,
+                                fd,
+                                pCapture,
+                                delay_ms,
+                                &status );
+    }
+    else
+    {
+        result = ExecuteCommand( pExecCmd->pCmd,
+                                 pExecCmd->ppArgv,
+                                 fd,
+                                 pState->timeout_seconds,
+                                 pCapture,
+                                 &status );
+    }
+
+    RecordExecution( pState,
+                     pExecCmd,
+                     ( GetTimeNs() - start ) / 1000,
+                     result,
+                     status );
+
+    if( pState->childOverflowed == true )
+    {
+        RecordOverflow( pExecCmd );
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  IsTransient                                                             */
+/*!
+    Determine if a failed execution may succeed when retried
+
+    The IsTransient function determines if the result of a failed
+    execution indicates a transient failure: a non-zero exit status, a
+    signal, or a timeout.  A command which could not be found, or whose
+    client went away, is not retried.
+
+    @param[in]
+        result
+            result of the execution
+
+    @retval true - the failure is transient
+    @retval false - the failure is not transient
+
+============================================================================*/
+static bool IsTransient( int result )
+{
+    return ( result == EIO ) || ( result == EINVAL );
+}
+
+/*==========================================================================*/
+/*  RecordOverflow                                                          */
+/*!
+    Record an execution which exceeded its output limit
+
+    The RecordOverflow function counts an execution of an exec command
+    whose output exceeded the command's maximum output size.  The first
+    such execution is logged.
+
+    @param[in,out]
+       pExecCmd
+            pointer to the executed exec command
+
+    @return none
+
+============================================================================*/
+static void RecordOverflow( ExecCmd *pExecCmd )
+{
+    if( pExecCmd->overflowCount == 0 )
+    {
+        syslog( LOG_WARNING,
+                "Output of command %s exceeded %zu bytes and was %s\n",
+                pExecCmd->pCmd,
+                pExecCmd->maxOutput,
+                ( pExecCmd->killOnOverflow == true ) ? "killed"
+                                                     : "truncated" );
+    }
+
+    pExecCmd->overflowCount++;
+}
+
+/*==========================================================================*/
+/*  RecordExecution                                                         */
+/*!
+    Record the execution of an exec command
+
+    The RecordExecution function updates the execution statistics and
+    exit status of an exec command, the running average of its execution
+    time which is used to estimate the cost of its print requests, and the
+    recent execution times of a hedged command.  Cancelled executions do not
+    contribute to the running average or recent execution times, as
+    they did not run to completion.
+
+    Consecutive failed executions are counted, and once there are enough
+    of them the command's circuit breaker is opened for the cool-down
+    period.  The first execution after the cool-down is a probe: if it
+    fails the circuit breaker is opened again, and if it succeeds the
+    circuit breaker is closed.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in,out]
+       pExecCmd
+            pointer to the executed exec command
+
+    @param[in]
+        time_us
+            execution time in microseconds
+
+    @param[in]
+        result
+            result of the execution
+
+    @param[in]
+        status
+            exit status of the execution, or -1 if it was not reaped
+
+    @return none
+
+============================================================================*/
+static void RecordExecution( ExecVarsState *pState,
+                             ExecCmd *pExecCmd,
+                             uint64_t time_us,
+                             int result,
+                             int status )
+{
+    pExecCmd->execTime_us += time_us;
+    pExecCmd->execCount++;
+
+    if( status >= 0 )
+    {
+        if( ( status != 0 ) &&
+            ( status != pExecCmd->exitStatus ) )
+        {
+            syslog( LOG_ERR,
+                    "Command %s exited with status %d\n",
+                    pExecCmd->pCmd,
+                    status );
+        }
+
+        pExecCmd->exitStatus = status;
+    }
+
+    if( result == EOK )
+    {
+        if( pExecCmd->breakerUntil_ms != 0 )
+        {
+            syslog( LOG_INFO, "Circuit closed for command %s\n", pExecCmd->pCmd );
+        }
+
+        pExecCmd->failures = 0;
+        pExecCmd->breakerUntil_ms = 0;
+    }
+    else if( result != ECANCELED )
+    {
+        pExecCmd->failures++;
+        if( ( pState->breakerFailures > 0 ) &&
+            ( pExecCmd->failures >= pState->breakerFailures ) )
+        {
+            if( pExecCmd->breakerUntil_ms == 0 )
+            {
+                syslog( LOG_ERR,
+                        "Circuit opened for command %s after %d failures\n",
+                        pExecCmd->pCmd,
+                        pExecCmd->failures );
+                pExecCmd->breakerTrips++;
+            }
+
+            pExecCmd->breakerUntil_ms = GetTimeMs() +
+                (uint64_t)pState->breakerCooldown * 1000;
+        }
+    }
+
+    if( result == ECANCELED )
+    {
+        /* the client went away before the command completed */
+        pExecCmd->cancelCount++;
+    }
+    else
+    {
+        if( pExecCmd->avgTime_us == 0 )
+        {
+            pExecCmd->avgTime_us = time_us;
+        }
+        else
+        {
+            pExecCmd->avgTime_us = pExecCmd->avgTime_us -
+                                   ( pExecCmd->avgTime_us >> EXEC_AVERAGE_SHIFT ) +
+                                   ( time_us >> EXEC_AVERAGE_SHIFT );
+        }
+
+        if( pExecCmd->pLatency != NULL )
+        {
+            pExecCmd->pLatency[pExecCmd->latencyNext] =
+                ( time_us > UINT32_MAX ) ? UINT32_MAX : (uint32_t)time_us;
+            pExecCmd->latencyNext = ( pExecCmd->latencyNext + 1 ) %
+                                    HEDGE_SAMPLES;
+            if( pExecCmd->nLatency < HEDGE_SAMPLES )
+            {
+                pExecCmd->nLatency++;
+            }
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  DumpStats                                                               */
+/*!
+    Log the execution statistics
+
+    The DumpStats function writes the execution, cache, and extraction
+    statistics of every exec variable to the system log.  It is invoked
+    when the execvars service receives a SIGUSR1 signal.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @return none
+
+============================================================================*/
+static void DumpStats( ExecVarsState *pState )
+{
+    ExecVar *pExecVar;
+    ExecCmd *pExecCmd;
+
+    syslog( LOG_INFO,
+            "requests: queued=%d high=%d normal=%d low=%d queue_depth=%d"
+            " shed=%" PRIu64 " stale_hits=%" PRIu64 "\n",
+            pState->queueCount,
+            pState->queueLength[PRIORITY_HIGH],
+            pState->queueLength[PRIORITY_NORMAL],
+            pState->queueLength[PRIORITY_LOW],
+            pState->queueDepth,
+            pState->shedCount,
+            pState->staleHits );
+
+    for( pExecVar = pState->pExecVars;
+         pExecVar != NULL;
+         pExecVar = pExecVar->pNext )
+    {
+        pExecCmd = pExecVar->pExecCmd;
+        if( pExecCmd == NULL )
+        {
+            /* group, or template instance which has not been rendered yet */
+            continue;
+        }
+
+        syslog( LOG_INFO,
+                "%s: shared_by=%d execs=%" PRIu64 " exec_avg_us=%" PRIu64
+                " exec_recent_us=%" PRIu64 " cancelled=%" PRIu64
+                " hedged=%" PRIu64 " hedge_wins=%" PRIu64
+                " exit_status=%d retries=%" PRIu64 " overflows=%" PRIu64
+                " shared_hits=%" PRIu64 " failures=%d breaker_trips=%" PRIu64
+                " breaker_hits=%" PRIu64
+                " cache_hits=%" PRIu64 " shed=%" PRIu64
+                " stale_hits=%" PRIu64 " extracts=%" PRIu64
+                " extract_failures=%" PRIu64 " extract_avg_ns=%" PRIu64 "\n",
+                pExecVar->pName,
+                pExecCmd->refCount,
+                pExecCmd->execCount,
+                ( pExecCmd->execCount > 0 )
+                    ? pExecCmd->execTime_us / pExecCmd->execCount : 0,
+                pExecCmd->avgTime_us,
+                pExecCmd->cancelCount,
+                pExecCmd->hedgeCount,
+                pExecCmd->hedgeWins,
+                pExecCmd->exitStatus,
+                pExecCmd->retryCount,
+                pExecCmd->overflowCount,
+                pExecCmd->sharedHits,
+                pExecCmd->failures,
+                pExecCmd->breakerTrips,
+                pExecCmd->breakerHits,
+                pExecVar->cacheHits,
+                pExecVar->shedCount,
+                pExecVar->staleHits,
+                pExecVar->extractCount,
+                pExecVar->extractFailures,
+                ( pExecVar->extractCount > 0 )
+                    ? pExecVar->extractTime_ns / pExecVar->extractCount : 0 );
+    }
+}
+
+/*==========================================================================*/
+/*  popen2                                                                  */
+/*!
+    This is a slightly modified version of the popen function which
+    allows the PID of the command to be returned.
+    The original can be found at:
+    https://www.cse.lehigh.edu/%7Ebrian/course/2013/cunix/notes/ch11/popen.c
+
+    The popen function opens a pipe to a command and returns a file
+    pointer to the command output stream.  If an argument vector is
+    specified, the command is executed directly rather than via /bin/sh.
+    The stream must be closed with fclose, and the command reaped
+    with waitpid.
+
+    @param[in]
+       command
+            pointer to the NUL terminated command string to execute
+
+    @param[in]
+        argv
+            pointer to the NULL terminated argument vector to execute,
+            or NULL to execute the command string with /bin/sh
+
+    @param[in]
+        mode
+            pointer to the NUL terminated mode string
+            "r" for read, "w" for write
+
+    @param[out]
+        pid
+            pointer to the process id of the command
+
+    @retval FILE * - file pointer to the command output stream
+    @retval NULL - command could not be executed
+
+============================================================================*/
+FILE *popen2( const char *command,
+              char * const *argv,
+              const char *mode,
+              pid_t *pid )
+{
+    const int READ = 0;
+    const int WRITE = 1;
+
+    int pfp[2];     /* the pipe and the process */
+    FILE *fp;       /* fdopen makes a fd a stream */
+    int parent_end, child_end;  /* of pipe */
+    sigset_t mask;
+
+    if( *mode == 'r' )
+    {
+        /* figure out direction */
+        parent_end = READ;
+        child_end = WRITE;
+    }
+    else if( *mode == 'w' )
+    {
+        parent_end = WRITE;
+        child_end = READ;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    if( pipe( pfp ) == -1 )
+    {
+        /* get a pipe */
+        return NULL;
+    }
+
+    if( ( *pid = fork() ) == -1 )
+    {
+        /* and a process */
+        close( pfp[0] ); /* or dispose of pipe */
+        close( pfp[1] );
+        return NULL;
+    }
+
+    /* --------------- parent code here ------------------- */
+    /* need to close one end and fdopen other end */
+
+    if( *pid > 0 )
+    {
+        /* the command runs in its own process group, so the whole
+           pipeline can be cancelled together */
+        setpgid( *pid, *pid );
+
+        close( pfp[child_end] );
+
+        fp = fdopen( pfp[parent_end], mode ); /* same mode */
+        if( fp == NULL )
+        {
+            close( pfp[parent_end] );
+            KillCommand( *pid );
+            waitpid( *pid, NULL, 0 );
+        }
+
+        return fp;
+    }
+
+    /* --------------- child code here --------------------- */
+    /* need to redirect stdin or stdout then exec the cmd */
+
+    /* the signals handled by the event loop are blocked in the
+       parent, so unblock them for the command */
+    sigemptyset( &mask );
+    sigprocmask( SIG_SETMASK, &mask, NULL );
+
+    /* SIGPIPE is ignored by execvars, but pipelines rely on it */
+    signal( SIGPIPE, SIG_DFL );
+    setpgid( 0, 0 );
+
+    /* run the command with the CPU and I/O priority of its class */
+    SetChildPriority( state.childPriority );
+
+    if( close( pfp[parent_end] ) == -1 )
+    {
+        /* close the other end */
+        _exit( 127 ); /* do NOT return */
+    }
+
+    if( dup2( pfp[child_end], child_end ) == -1 )
+    {
+        _exit( 127 );
+    }
+
+    if( close( pfp[child_end] ) == -1 )
+    {
+        /* done with this one */
+        _exit( 127 );
+    }
+
+    /* all set to run cmd */
+    if( argv != NULL )
+    {
+        execvp( argv[0], argv );
+    }
+    else
+    {
+        execl( "/bin/sh", "sh", "-c", command, NULL );
+    }
+
+    _exit( 127 );
+}
+
+/*==========================================================================*/
+/*  ExecuteCommandInfiniteWait                                              */
+/*!
+    Execute a command and pipe the output to the output stream
+
+    The ExecuteCommandInfiniteWait function executes the specified command
+    and redirects the command output to the specified output stream. It would
+    block indefinitely until the command completes.
+
+    @param[in]
+       cmd
+            pointer to the NUL terminated command string to execute
+
+    @param[in]
+        argv
+            pointer to the pre-tokenized argument vector of the command,
+            or NULL to execute the command string with /bin/sh
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @param[out]
+        pStatus
+            pointer to a location to store the exit status of the command,
+            or NULL if it is not required.  It is set to -1 if the command
+            was not reaped
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - invalid arguments
+    @retval ECANCELED - the client went away
+
+============================================================================*/
+static int ExecuteCommandInfiniteWait( const char *cmd,
+                                       char * const *argv,
+                                       int fd,
+                                       OutputBuffer *pCapture,
+                                       int *pStatus )
+{
+    int n;
+    int result = ENOENT;
+    char buf[BUFSIZ];
+    struct pollfd pfds[2];
+    bool cancelled = false;
+    bool overflowed = false;
+    size_t total = 0;
+    FILE *fp_in;
+    pid_t pid;
+
+    fp_in = popen2( cmd, argv, "r", &pid );
+    if( fp_in != NULL )
+    {
+        /* wait for command output, or for the client to go away */
+        pfds[0].fd = fileno( fp_in );
+        pfds[0].events = POLLIN;
+        pfds[1].fd = GetClientFd( fd );
+        pfds[1].events = 0;
+
+        while( 1 )
+        {
+            if( poll( pfds, 2, -1 ) < 0 )
+            {
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+
+                break;
+            }
+
+            if( pfds[1].revents != 0 )
+            {
+                cancelled = true;
+                break;
+            }
+
+            /* read a buffer of output */
+            n = read( pfds[0].fd, buf, BUFSIZ );
+            if( n > 0 )
+            {
+                /* send the output to the output stream */
+                if( RelayOutput( fd, buf, n, pCapture, &total ) != EOK )
+                {
+                    overflowed = true;
+                    break;
+                }
+
+                if( ClientGone( fd ) == true )
+                {
+                    cancelled = true;
+                    break;
+                }
+            }
+            else if( ( n < 0 ) && ( errno == EINTR ) )
+            {
+                continue;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if( cancelled == true )
+        {
+            /* stop the command as nobody wants its output */
+            CancelCommand( fd, pid );
+        }
+        else if( overflowed == true )
+        {
+            /* stop the command as it produces too much output */
+            KillCommand( pid );
+        }
+
+        /* close the command output data stream */
+        fclose( fp_in );
+
+        /* reap the command */
+        result = WaitCommand( pid, pStatus );
+        if( cancelled == true )
+        {
+            result = ECANCELED;
+        }
+        else if( overflowed == true )
+        {
+            result = EFBIG;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ExecuteCommandWithTimeout                                               */
+/*!
+    Execute a command and pipe the output to the output stream
+
+    The ExecuteCommandWithTimeout function executes the specified command
+    and redirects the command output to the specified output stream. It
+    will terminate the command if the timeout is exceeded.
+
+    @param[in]
+       cmd
+            pointer to the NUL terminated command string to execute
+
+    @param[in]
+        argv
+            pointer to the pre-tokenized argument vector of the command,
+            or NULL to execute the command string with /bin/sh
+
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to
+
+    @param[in]
+        timeout_seconds
+            timeout in seconds, if it is 0, the command is executed
+            in the current process, otherwise, a new process is forked
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @param[out]
+        pStatus
+            pointer to a location to store the exit status of the command,
+            or NULL if it is not required.  It is set to -1 if the command
+            was not reaped
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - invalid arguments, or the timeout was exceeded
+    @retval ECANCELED - the client went away
+
+============================================================================*/
+static int ExecuteCommandWithTimeout( const char *cmd,
+                                      char * const *argv,
+                                      int fd,
+                                      int timeout_seconds,
+                                      OutputBuffer *pCapture,
+                                      int *pStatus )
+{
+    int n;
+    int result = ENOENT;
+    int retval;
+    char buf[BUFSIZ];
+    FILE *fp_in;
+    int pipefd;
+    struct pollfd pfds[2];
+    uint64_t deadline_ms;
+    uint64_t now_ms;
+    size_t total = 0;
+    pid_t pid;
+
+    fp_in = popen2( cmd, argv, "r", &pid );
+    if( fp_in == NULL )
+    {
+        return result;
+    }
+
+    /* get the file descriptor to wait on with poll */
+    pipefd = fileno( fp_in );
+    if( pipefd >= 0 )
+    {
+        /* Set up the timeout context for poll */
+        deadline_ms = GetTimeMs() + (uint64_t)timeout_seconds * 1000;
+
+        /* also wait for the client to go away */
+        pfds[0].fd = pipefd;
+        pfds[0].events = POLLIN;
+        pfds[1].fd = GetClientFd( fd );
+        pfds[1].events = 0;
+
+        do
+        {
+            now_ms = GetTimeMs();
+            retval = ( now_ms < deadline_ms )
+                        ? poll( pfds, 2, (int)( deadline_ms - now_ms ) )
+                        : 0;
+            if( ( retval < 0 ) && ( errno == EINTR ) )
+            {
+                retval = 1;
+                continue;
+            }
+
+            if( retval < 0 )
+            {
+                /* poll error */
+                result = EINVAL;
+                KillCommand( pid );
+            }
+            else if( retval == 0 )
+            {
+                /* timeout occurred, kill the process */
+                result = EINVAL;
+                KillCommand( pid );
+                syslog( LOG_ERR, "Timeout %d seconds exceeded for command %s\n", timeout_seconds, cmd );
+            }
+            else if( pfds[1].revents != 0 )
+            {
+                /* the client went away, so nobody wants the output */
+                retval = 0;
+                result = ECANCELED;
+                CancelCommand( fd, pid );
+            }
+            else
+            {
+                /* read a buffer of output */
+                n = read( pipefd, buf, BUFSIZ );
+                if( n > 0 )
+                {
+                    /* send the output to the output stream */
+                    if( RelayOutput( fd, buf, n, pCapture, &total ) != EOK )
+                    {
+                        /* too much output, kill the process */
+                        retval = 0;
+                        result = EFBIG;
+                        KillCommand( pid );
+                    }
+                    else if( ClientGone( fd ) == true )
+                    {
+                        retval = 0;
+                        result = ECANCELED;
+                        CancelCommand( fd, pid );
+                    }
+                }
+                else if( n == 0 )
+                {
+                    /* end of data, exit now */
+                    retval = 0;
+                    result = EOK;
+                }
+                else if( errno != EINTR )
+                {
+                    /* error reading data */
+                    retval = 0;
+                    result = EINVAL;
+                    KillCommand( pid );
+                }
+            }
+        } while( retval > 0 );
+    }
+    else
+    {
+        /* error getting file descriptor */
+        result = EINVAL;
+        KillCommand( pid );
+    }
+
+    /* close the command output data stream in any case */
+    fclose( fp_in );
+
+    /* reap the command */
+    retval = WaitCommand( pid, pStatus );
+    if( result == EOK )
+    {
+        result = retval;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  WaitCommand                                                             */
+/*!
+    Wait for a command to terminate
+
+    The WaitCommand function reaps a command process started by popen2,
+    and gets its exit status.  A command which was killed by a signal
+    has an exit status of 128 plus the signal number, as in the shell.
+
+    @param[in]
+       pid
+            process identifier of the command
+
+    @param[out]
+        pStatus
+            pointer to a location to store the exit status of the command,
+            or NULL if it is not required.  It is set to -1 if the command
+            could not be reaped
+
+    @retval EOK - the command exited with a zero status
+    @retval ENOENT - the command could not be executed
+    @retval EIO - the command exited with a non-zero status, or was
+                  killed by a signal
+
+============================================================================*/
+static int WaitCommand( pid_t pid, int *pStatus )
+{
+    int status;
+    int exitStatus = -1;
+    int result = EOK;
+
+    while( waitpid( pid, &status, 0 ) == -1 )
+    {
+        if( errno != EINTR )
+        {
+            /* the exit status is unknown */
+            if( pStatus != NULL )
+            {
+                *pStatus = -1;
+            }
+
+            return EOK;
+        }
+    }
+
+    if( WIFEXITED( status ) )
+    {
+        exitStatus = WEXITSTATUS( status );
+        if( exitStatus == 127 )
+        {
+            /* the command (or the shell) could not be executed */
+            result = ENOENT;
+        }
+        else if( exitStatus != 0 )
+        {
+            /* the command failed, so its output cannot be trusted */
+            result = EIO;
+        }
+    }
+    else if( WIFSIGNALED( status ) )
+    {
+        exitStatus = 128 + WTERMSIG( status );
+        result = EIO;
+    }
+
+    if( pStatus != NULL )
+    {
+        *pStatus = exitStatus;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  KillCommand                                                             */
+/*!
+    Terminate a command
+
+    The KillCommand function kills the process group of a command started
+    by popen2, so every process of a pipeline is terminated.  The command
+    must still be reaped with WaitCommand.
+
+    @param[in]
+       pid
+            process identifier of the command
+
+    @return none
+
+============================================================================*/
+static void KillCommand( pid_t pid )
+{
+    if( kill( -pid, SIGKILL ) != 0 )
+    {
+        /* the process group may not have been created yet */
+        kill( pid, SIGKILL );
+    }
+}
+
+/*==========================================================================*/
+/*  CancelCommand                                                           */
+/*!
+    Cancel a command whose client went away
+
+    The CancelCommand function marks the print session of an output stream
+    as failed, so no more output is sent to it, and terminates the
+    command which was rendering into it.
+
+    @param[in]
+        fd
+            output file descriptor of the client
+
+    @param[in]
+       pid
+            process identifier of the command
+
+    @return none
+
+============================================================================*/
+static void CancelCommand( int fd, pid_t pid )
+{
+    if( ( state.pSession != NULL ) &&
+        ( state.pSession->fd == fd ) )
+    {
+        state.pSession->failed = true;
+    }
+
+    if( state.verbose == true )
+    {
+        printf( "client went away: cancelling command %d\n", (int)pid );
+    }
+
+    KillCommand( pid );
+}
+
+/*==========================================================================*/
+/*  GetClientFd                                                             */
+/*!
+    Get the descriptor to watch for the client going away
+
+    The GetClientFd function gets the output file descriptor of the print
+    session being rendered, so that it can be polled for the error which
+    indicates that the client has closed its end of the output stream.
+
+    @param[in]
+        fd
+            output file descriptor the command output is sent to
+
+    @retval the output file descriptor of the print session
+    @retval -1 - the output is not sent to a print session
+
+============================================================================*/
+static int GetClientFd( int fd )
+{
+    return ( ( fd >= 0 ) &&
+             ( state.pSession != NULL ) &&
+             ( state.pSession->fd == fd ) &&
+             ( state.pSession->failed == false ) ) ? fd : -1;
+}
+
+/*==========================================================================*/
+/*  ClientGone                                                              */
+/*!
+    Check if the client of a print session went away
+
+    The ClientGone function checks if output to the print session being
+    rendered has failed, for example with EPIPE because the client closed
+    its end of the output stream.
+
+    @param[in]
+        fd
+            output file descriptor the command output is sent to
+
+    @retval true - the client of the print session went away
+    @retval false - the client is still there, or there is no client
+
+============================================================================*/
+static bool ClientGone( int fd )
+{
+    return ( fd >= 0 ) &&
+           ( state.pSession != NULL ) &&
+           ( state.pSession->fd == fd ) &&
+           ( state.pSession->failed == true );
+}
+
+/*==========================================================================*/
+/*  SetChildPriority                                                        */
+/*!
+    Set the CPU and I/O priority of a command
+
+    The SetChildPriority function is called in a command's process before
+    the command is executed, to lower the nice level and I/O priority of
+    commands in the low priority class so they yield to other work, and
+    to raise the I/O priority of commands in the high priority class.
+    Failures are ignored, and the command runs at the service's priority.
+
+    @param[in]
+        priority
+            priority class of the command
+
+    @return none
+
+============================================================================*/
+static void SetChildPriority( PriorityClass priority )
+{
+    const PriorityInfo *pInfo = &priorities[priority];
+
+    if( pInfo->nice != 0 )
+    {
+        setpriority( PRIO_PROCESS,
+                     0,
+                     getpriority( PRIO_PROCESS, 0 ) + pInfo->nice );
+    }
+
+    if( pInfo->ioLevel >= 0 )
+    {
+        syscall( SYS_ioprio_set,
+                 IOPRIO_WHO_PROCESS,
+                 0,
+                 ( IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT ) | pInfo->ioLevel );
+    }
+}
+
+/*==========================================================================*/
+/*  BreakerOpen                                                             */
+/*!
+    Check if the circuit breaker of an exec command is open
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command
+
+    @retval true - the command must not be executed until the
+                   circuit breaker's cool-down period has passed
+    @retval false - the command may be executed
+
+============================================================================*/
+static bool BreakerOpen( ExecCmd *pExecCmd )
+{
+    return ( pExecCmd->breakerUntil_ms != 0 ) &&
+           ( GetTimeMs() < pExecCmd->breakerUntil_ms );
+}
+
+/*==========================================================================*/
+/*  HedgeDelay                                                              */
+/*!
+    Get the delay after which a command execution is hedged
+
+    The HedgeDelay function gets the 95th percentile of the recent
+    execution times of a hedged exec command.  An execution which has not
+    produced any output by then is hedged with a second execution.
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command
+
+    @retval delay in milliseconds before the execution is hedged
+    @retval 0 - the command is not hedged, or not enough of its
+                executions have been observed yet
+
+============================================================================*/
+static uint64_t HedgeDelay( ExecCmd *pExecCmd )
+{
+    uint32_t samples[HEDGE_SAMPLES];
+    int n = pExecCmd->nLatency;
+
+    if( ( pExecCmd->pLatency == NULL ) ||
+        ( n < HEDGE_MIN_SAMPLES ) )
+    {
+        return 0;
+    }
+
+    memcpy( samples, pExecCmd->pLatency, n * sizeof( uint32_t ) );
+    qsort( samples, n, sizeof( uint32_t ), CompareSamples );
+
+    /* round up to a whole millisecond, so the delay is never 0 */
+    return ( samples[( n * 95 + 99 ) / 100 - 1] / 1000 ) + 1;
+}
+
+/*==========================================================================*/
+/*  CompareSamples                                                          */
+/*!
+    Compare two execution time samples
+
+    The CompareSamples function is a qsort comparison function which
+    orders execution time samples in ascending order.
+
+    @param[in]
+       p1
+            pointer to the first sample
+
+    @param[in]
+       p2
+            pointer to the second sample
+
+    @retval <0 - the first sample is shorter
+    @retval 0 - the samples are the same
+    @retval >0 - the first sample is longer
+
+============================================================================*/
+static int CompareSamples( const void *p1, const void *p2 )
+{
+    uint32_t s1 = *(const uint32_t *)p1;
+    uint32_t s2 = *(const uint32_t *)p2;
+
+    return ( s1 > s2 ) - ( s1 < s2 );
+}
+
+/*==========================================================================*/
+/*  ExecuteHedged                                                           */
+/*!
+    Execute a command with a hedged second execution
+
+    The ExecuteHedged function executes a command and captures its
+    output.  If the command has not produced any output after the
+    specified delay, a second execution of the command is started, and
+    the output of whichever execution completes first is used.  The
+    other execution's process group is killed.  The output is written
+    to the output stream once the winning execution has completed.
+
+    @param[in]
+       pState
+            pointer to the ExecVars state object
+
+    @param[in]
+       pExecCmd
+            pointer to the exec command to execute
+
+    @param[in]
+        fd
+            output file descriptor to write the command output to
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @param[in]
+        delay_ms
+            time in milliseconds after which the execution is hedged
+
+    @param[out]
+        pStatus
+            pointer to a location to store the exit status of the winning
+            execution, or of the last execution to fail.  It is set to -1
+            if no execution was reaped
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - the command failed or timed out
+    @retval ECANCELED - the client went away
+
+============================================================================*/
+static int ExecuteHedged( ExecVarsState *pState,
+                          ExecCmd *pExecCmd,
+                          int fd,
+                          OutputBuffer *pCapture,
+                          uint64_t delay_ms,
+                          int *pStatus )
+{
+    ExecJob jobs[2];
+    ExecJob *pJob;
+    ExecJob *pWinner = NULL;
+    struct pollfd pfds[3];
+    char buf[BUFSIZ];
+    uint64_t start_ms;
+    uint64_t hedge_ms;
+    uint64_t deadline_ms = 0;
+    uint64_t now_ms;
+    bool cancelled = false;
+    int result = ENOENT;
+    int timeout_ms;
+    int nJobs = 0;
+    int nRunning;
+    int i;
+    ssize_t n;
+
+    memset( jobs, 0, sizeof( jobs ) );
+    *pStatus = -1;
+
+    start_ms = GetTimeMs();
+    hedge_ms = start_ms + delay_ms;
+    if( pState->timeout_seconds > 0 )
+    {
+        deadline_ms = start_ms + (uint64_t)pState->timeout_seconds * 1000;
+    }
+
+    do
+    {
+        now_ms = GetTimeMs();
+
+        if( ( nJobs == 0 ) ||
+            ( ( nJobs == 1 ) &&
+              ( jobs[0].running == true ) &&
+              ( jobs[0].output.len == 0 ) &&
+              ( now_ms >= hedge_ms ) ) )
+        {
+            /* start the first execution, or hedge it */
+            pJob = &jobs[nJobs++];
+            pJob->fp = popen2( pExecCmd->pCmd,
+                               pExecCmd->ppArgv,
+                               "r",
+                               &pJob->pid );
+            pJob->running = ( pJob->fp != NULL );
+            pJob->result = ENOENT;
+
+            if( nJobs == 2 )
+            {
+                pExecCmd->hedgeCount++;
+                if( pState->verbose == true )
+                {
+                    printf( "hedging %s after %" PRIu64 " ms\n",
+                            pExecCmd->pCmd,
+                            delay_ms );
+                }
+            }
+        }
+
+        if( ( deadline_ms != 0 ) &&
+            ( now_ms >= deadline_ms ) )
+        {
+            syslog( LOG_ERR,
+                    "Timeout %d seconds exceeded for command %s\n",
+                    pState->timeout_seconds,
+                    pExecCmd->pCmd );
+            result = EINVAL;
+            break;
+        }
+
+        /* wait for the hedge delay, then only for the timeout */
+        timeout_ms = -1;
+        if( ( nJobs == 1 ) &&
+            ( jobs[0].output.len == 0 ) )
+        {
+            timeout_ms = (int)( hedge_ms - now_ms );
+        }
+
+        if( ( deadline_ms != 0 ) &&
+            ( ( timeout_ms < 0 ) ||
+              ( deadline_ms - now_ms < (uint64_t)timeout_ms ) ) )
+        {
+            timeout_ms = (int)( deadline_ms - now_ms );
+        }
+
+        nRunning = 0;
+        for( i = 0; i < 2; i++ )
+        {
+            pfds[i].fd = ( jobs[i].running == true ) ? fileno( jobs[i].fp )
+                                                     : -1;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+            nRunning += ( jobs[i].running == true ) ? 1 : 0;
+        }
+
+        if( nRunning == 0 )
+        {
+            break;
+        }
 
-    /*! pointer to the next exec variable */
-    struct execVar *pNext;
+        /* also wait for the client to go away */
+        pfds[2].fd = GetClientFd( fd );
+        pfds[2].events = 0;
+        pfds[2].revents = 0;
 
-} ExecVar;
+        if( poll( pfds, 3, timeout_ms ) < 0 )
+        {
+            if( errno == EINTR )
+            {
+                continue;
+            }
 
+            result = EINVAL;
+            break;
+        }
 
-/*! ExecVars state */
-typedef struct execVarsState
-{
-    /*! variable server handle */
-    VARSERVER_HANDLE hVarServer;
+        if( pfds[2].revents != 0 )
+        {
+            cancelled = true;
+            break;
+        }
 
-    /*! verbose flag */
-    bool verbose;
+        for( i = 0; ( i < 2 ) && ( pWinner == NULL ); i++ )
+        {
+            pJob = &jobs[i];
+            if( pfds[i].revents == 0 )
+            {
+                continue;
+            }
 
-    /*! timeout in seconds */
-    int timeout_seconds;
+            n = read( pfds[i].fd, buf, sizeof( buf ) );
+            if( ( n > 0 ) &&
+                ( RelayOutput( -1,
+                               buf,
+                               n,
+                               &pJob->output,
+                               &pJob->outputBytes ) == EOK ) )
+            {
+                continue;
+            }
+            else if( ( n < 0 ) && ( errno == EINTR ) )
+            {
+                continue;
+            }
+            else
+            {
+                if( n != 0 )
+                {
+                    /* read error, or too much output */
+                    KillCommand( pJob->pid );
+                }
 
-    /*! name of the ExecVars definition file */
-    char *pFileName;
+                /* reap the execution */
+                fclose( pJob->fp );
+                pJob->fp = NULL;
+                pJob->running = false;
+                pJob->result = WaitCommand( pJob->pid, pStatus );
+                if( n < 0 )
+                {
+                    pJob->result = EINVAL;
+                }
+                else if( n > 0 )
+                {
+                    pJob->result = EFBIG;
+                }
 
-    /*! pointer to the exec vars list */
-    ExecVar *pExecVars;
-} ExecVarsState;
+                result = pJob->result;
+                if( result == EOK )
+                {
+                    /* the first execution to complete wins */
+                    pWinner = pJob;
+                }
+            }
+        }
+    } while( pWinner == NULL );
 
-/*============================================================================
-        Private file scoped variables
-============================================================================*/
+    /* kill the executions which did not win */
+    for( pJob = jobs; pJob < &jobs[nJobs]; pJob++ )
+    {
+        if( pJob->running == true )
+        {
+            if( cancelled == true )
+            {
+                CancelCommand( fd, pJob->pid );
+            }
+            else
+            {
+                KillCommand( pJob->pid );
+            }
 
-/*! ExecVars State object */
-ExecVarsState state;
+            fclose( pJob->fp );
+            pJob->fp = NULL;
+            pJob->running = false;
+            WaitCommand( pJob->pid, NULL );
+        }
+    }
 
-/*============================================================================
-        Private function declarations
-============================================================================*/
+    if( cancelled == true )
+    {
+        result = ECANCELED;
+    }
+    else if( pWinner != NULL )
+    {
+        if( pWinner == &jobs[1] )
+        {
+            pExecCmd->hedgeWins++;
+        }
 
-void main(int argc, char **argv);
-static int ProcessOptions( int argC, char *argV[], ExecVarsState *pState );
-static void usage( char *cmdname );
-static int SetupExecVar( JNode *pNode, void *arg );
-static int ExecuteVar( ExecVarsState *pState,
-                       VAR_HANDLE hVar,
-                       int sig,
-                       int fd );
-static int ExecuteCommand( char *cmd, int fd, int timeout_seconds );
-static int ExecuteCommandInfiniteWait( char *cmd, int fd );
-static int ExecuteCommandWithTimeout( char *cmd, int fd, int timeout_seconds );
-static void SetupTerminationHandler( void );
-static void TerminationHandler( int signum, siginfo_t *info, void *ptr );
+        SendOutput( fd, &pWinner->output, pCapture );
+    }
 
-/*============================================================================
-        Private function definitions
-============================================================================*/
+    FreeOutput( &jobs[0].output );
+    FreeOutput( &jobs[1].output );
+
+    return result;
+}
 
 /*==========================================================================*/
-/*  main                                                                    */
+/*  ExecuteCommand                                                          */
 /*!
-    Main entry point for the execvars application
+    Execute a command and pipe the output to the output stream
 
-    The main function starts the execvars application
+    The ExecuteCommand function executes the specified command
+    and redirects the command output to the specified output stream
 
     @param[in]
-        argc
-            number of arguments on the command line
-            (including the command itself)
+       cmd
+            pointer to the NUL terminated command string to execute
 
     @param[in]
         argv
-            array of pointers to the command line arguments
+            pointer to the pre-tokenized argument vector of the command,
+            or NULL to execute the command string with /bin/sh
 
-    @return none
+    @param[in]
+        fd
+            output file descriptor to pipe the command output to
+
+    @param[in]
+        timeout_seconds
+            timeout in seconds, if it is 0, the command is executed
+            in the current process, otherwise, a new process is forked
+
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the command output into,
+            or NULL if the output is not captured
+
+    @param[out]
+        pStatus
+            pointer to a location to store the exit status of the command,
+            or NULL if it is not required.  It is set to -1 if the command
+            was not reaped
+
+    @retval EOK - command executed successfully
+    @retval ENOENT - the command was not found
+    @retval EIO - the command exited with a non-zero status
+    @retval EINVAL - invalid arguments
+    @retval ECANCELED - the client went away
 
 ============================================================================*/
-void main(int argc, char **argv)
+static int ExecuteCommand( const char *cmd,
+                           char * const *argv,
+                           int fd,
+                           int timeout_seconds,
+                           OutputBuffer *pCapture,
+                           int *pStatus )
 {
-    VARSERVER_HANDLE hVarServer = NULL;
-    VAR_HANDLE hVar;
-    int result;
-    JNode *config;
-    JArray *cmds;
-    int sigval;
-    int fd;
-    int sig;
-    char buf[BUFSIZ];
+    int result = EINVAL;
 
-    /* clear the execvars state object */
-    memset( &state, 0, sizeof( state ) );
+    if( pStatus != NULL )
+    {
+        *pStatus = -1;
+    }
 
-    if( argc < 3 )
+    if( cmd != NULL )
     {
-        usage( argv[0] );
-        exit( 1 );
+        if( timeout_seconds > 0 )
+        {
+            /* execute the command and wait for the specified timeout */
+            result = ExecuteCommandWithTimeout( cmd,
+                                                argv,
+                                                fd,
+                                                timeout_seconds,
+                                                pCapture,
+                                                pStatus );
+        }
+        else
+        {
+            /* execute the command and wait indefinitely */
+            result = ExecuteCommandInfiniteWait( cmd,
+                                                 argv,
+                                                 fd,
+                                                 pCapture,
+                                                 pStatus );
+        }
     }
 
-    /* set up an abnormal termination handler */
-    SetupTerminationHandler();
+    return result;
+}
 
-    /* process the command line options */
-    ProcessOptions( argc, argv, &state );
+/*==========================================================================*/
+/*  WriteOutput                                                             */
+/*!
+    Write command output to the output stream
 
-    /* process the input file */
-    config = JSON_Process( state.pFileName );
+    The WriteOutput function sends a block of command output to the
+    specified output stream, and optionally appends it to a capture
+    buffer so it can be cached.  Output to the print session being
+    rendered is queued if its client cannot accept it yet.  If the
+    capture buffer cannot be grown, the capture is marked as incomplete
+    so it is not cached.
 
-    /* get the configuration array */
-    cmds = (JArray *)JSON_Find( config, "commands" );
+    @param[in]
+        fd
+            output file descriptor, or -1 to only capture the output
 
-    /* get a handle to the VAR server */
-    state.hVarServer = VARSERVER_Open();
-    if( state.hVarServer != NULL )
-    {
-        /* set up the exec vars by iterating through the configuration array */
-        JSON_Iterate( cmds, SetupExecVar, (void *)&state );
+    @param[in]
+        buf
+            pointer to the output data
 
-        while( 1 )
-        {
-            /* wait for a signal from the variable server */
-            sig = VARSERVER_WaitSignal( &sigval );
-            if( sig == SIG_VAR_PRINT )
-            {
-                /* open a print session */
-                VAR_OpenPrintSession( state.hVarServer,
-                                      sigval,
-                                      &hVar,
-                                      &fd );
+    @param[in]
+        len
+            number of bytes of output data
 
-                /* execute the variable */
-                ExecuteVar( &state, hVar, sig, fd );
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the output into, or NULL
 
-                /* Close the print session */
-                VAR_ClosePrintSession( state.hVarServer,
-                                       sigval,
-                                       fd );
-            }
+    @return none
+
+============================================================================*/
+static void WriteOutput( int fd,
+                         char *buf,
+                         size_t len,
+                         OutputBuffer *pCapture )
+{
+    if( ( buf != NULL ) && ( len > 0 ) )
+    {
+        if( ( fd >= 0 ) &&
+            ( state.pSession != NULL ) &&
+            ( state.pSession->fd == fd ) )
+        {
+            /* send the output to the print session, which queues the
+               output its client cannot accept yet */
+            QueueOutput( state.pSession, buf, len );
+        }
+        else if( fd >= 0 )
+        {
+            /* send the output to the output stream */
+            WriteFully( fd, buf, len );
         }
 
-        /* close the variable server */
-        if ( VARSERVER_Close( state.hVarServer ) == EOK )
+        if( pCapture != NULL )
         {
-            state.hVarServer = NULL;
+            if( GrowOutput( pCapture, pCapture->len + len ) == true )
+            {
+                memcpy( &pCapture->pData[pCapture->len], buf, len );
+                pCapture->len += len;
+            }
+            else
+            {
+                pCapture->incomplete = true;
+            }
         }
     }
 }
 
 /*==========================================================================*/
-/*  SetupExecVar                                                            */
+/*  WriteFully                                                              */
 /*!
-    Set up an execvar object
+    Write all of a block of output to an output stream
 
-    The SetupExecVar function is a callback function for the JSON_Iterate
-    function which sets up an exec variable from the JSON configuration.
-    The exec variable definition object is expected to look as follows:
+    The WriteFully function writes a block of output to an output stream
+    which is not served by a print session, such as the stream of a print
+    request rendered when a print session could not be allocated.  Partial
+    writes are continued, and a stream which cannot accept more output is
+    waited on for at most DIRECT_WRITE_TIMEOUT_MS at a time.
 
-    { "var": "varname", "exec": "<command sequence>" }
+    @param[in]
+        fd
+            output file descriptor
 
     @param[in]
-       pNode
-            pointer to the ExecVar node
+        buf
+            pointer to the output data
 
     @param[in]
-        arg
-            opaque pointer argument used for the execvar state object
+        len
+            number of bytes of output data
 
-    @retval EOK - the exec variable was set up successfully
-    @retval EINVAL - the exec variable could not be set up
+    @retval EOK - all of the output was written
+    @retval ETIMEDOUT - the stream did not accept more output in time
+    @retval other - error code from write
 
 ============================================================================*/
-static int SetupExecVar( JNode *pNode, void *arg )
+static int WriteFully( int fd, const char *buf, size_t len )
 {
-    ExecVarsState *pState = (ExecVarsState *)arg;
-    JVar *pName;
-    JVar *pCommandString;
-    char *varname = NULL;
-    char *cmd = NULL;
-    VARSERVER_HANDLE hVarServer;
-    ExecVar *pExecvar;
-    int result = EINVAL;
+    struct pollfd pfd;
+    ssize_t n;
 
-    if( pState != NULL )
+    while( len > 0 )
     {
-        /* get a handle to the VarServer */
-        hVarServer = pState->hVarServer;
-        pName = (JVar *)JSON_Find( pNode, "var" );
-        if( pName != NULL )
+        n = write( fd, buf, len );
+        if( n > 0 )
         {
-            varname = pName->var.val.str;
+            buf += n;
+            len -= (size_t)n;
         }
-
-        pCommandString = (JVar *)JSON_Find( pNode, "exec" );
-        if( pCommandString != NULL )
+        else if( ( n < 0 ) && ( errno == EINTR ) )
         {
-            cmd = pCommandString->var.val.str;
+            continue;
         }
-
-        if( ( varname != NULL ) &&
-            ( cmd != NULL ) )
+        else if( ( n < 0 ) &&
+                 ( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) ) )
         {
-            /* allocate memory for the exec variable */
-            pExecvar = malloc( sizeof( ExecVar ) );
-            if( pExecvar != NULL )
+            /* wait for the stream to accept more output */
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            if( poll( &pfd, 1, DIRECT_WRITE_TIMEOUT_MS ) == 0 )
             {
-                /* get a handle to the exec var */
-                pExecvar->hVar = VAR_FindByName( hVarServer, varname );
-
-                /* set the command associated with the exec var */
-                pExecvar->pCmd = strdup( cmd );
-
-                /* tell the variable server that we will be responsible
-                   for fulfilling print requests for this exec var */
-                result = VAR_Notify( hVarServer,
-                                     pExecvar->hVar,
-                                     NOTIFY_PRINT );
-
-                /* store the execvar into the execvar list */
-                pExecvar->pNext = pState->pExecVars;
-                pState->pExecVars = pExecvar;
+                return ETIMEDOUT;
             }
         }
+        else
+        {
+            return ( n < 0 ) ? errno : EIO;
+        }
     }
 
-    return result;
+    return EOK;
 }
 
 /*==========================================================================*/
-/*  ExecuteVar                                                              */
+/*  RelayOutput                                                             */
 /*!
-    Execute an execvar
+    Relay command output up to the output limit
 
-    The ExecuteVar function iterates through all the registered execvars
-    looking for the specified variable handle.  If found, the command
-    string associated with it is executed, and the output piped to the
-    specified output stream.
+    The RelayOutput function writes a block of output of the command
+    being executed to the output stream and capture buffer, as the
+    WriteOutput function does, but only up to the command's output
+    limit.  Output beyond the limit is discarded, and if the command is
+    killed for exceeding its limit, EFBIG is returned so the caller can
+    kill it.
 
     @param[in]
-       pState
-            pointer to the ExecVars state object
+        fd
+            output file descriptor, or -1 to only capture the output
 
     @param[in]
-        hVar
-            handle of the variable to execute
+        buf
+            pointer to the output data
 
     @param[in]
-        sig
-            type of signal:  one of:
-                SIG_VAR_PRINT
-                SIG_VAR_MODIFIED
+        len
+            number of bytes of output data
 
-    @param[in]
-        fd
-            output file descriptor to pipe the command output to
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the output into, or NULL
 
-    @retval EOK - variable executed successfully
-    @retval ENOENT - variable was not found
-    @retval EINVAL - invalid arguments
+    @param[in,out]
+        pTotal
+            pointer to the number of bytes of output of the execution
+            kept so far
+
+    @retval EOK - the output was relayed
+    @retval EFBIG - the output limit was exceeded and the command must be
+                    killed
 
 ============================================================================*/
-static int ExecuteVar( ExecVarsState *pState,
-                       VAR_HANDLE hVar,
-                       int sig,
-                       int fd )
+static int RelayOutput( int fd,
+                        char *buf,
+                        size_t len,
+                        OutputBuffer *pCapture,
+                        size_t *pTotal )
 {
-    int result = EINVAL;
-    ExecVar *pExecVar;
-    FILE *fp_in;
-    char buf[BUFSIZ];
+    int result = EOK;
+    size_t n;
 
-    if( ( pState != NULL ) &&
-        ( hVar != VAR_INVALID ) )
-    {
-        result = ENOENT;
+    n = LimitOutput( state.childMaxOutput, pTotal, len );
+    WriteOutput( fd, buf, n, pCapture );
 
-        pExecVar = pState->pExecVars;
-        while( pExecVar != NULL )
+    if( n < len )
+    {
+        state.childOverflowed = true;
+        if( state.childKillOnOverflow == true )
         {
-            if( pExecVar->hVar == hVar )
-            {
-                if( pExecVar->pCmd != NULL )
-                {
-                    if ( sig == SIG_VAR_PRINT )
-                    {
-                        result = ExecuteCommand( pExecVar->pCmd, fd, pState->timeout_seconds );
-                    }
-                    else
-                    {
-                        result = ENOTSUP;
-                    }
-                }
-                else
-                {
-                    result = ENOTSUP;
-                }
-                break;
-            }
+            result = EFBIG;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  LimitOutput                                                             */
+/*!
+    Apply an output limit to a block of command output
+
+    The LimitOutput function gets how much of a block of command output
+    can be kept without exceeding an output limit, and adds it to the
+    number of bytes kept so far.
+
+    @param[in]
+        maxOutput
+            maximum number of bytes of output to keep, or 0 for no limit
 
-            pExecVar = pExecVar->pNext;
+    @param[in,out]
+        pTotal
+            pointer to the number of bytes of output kept so far
+
+    @param[in]
+        len
+            number of bytes in the block of output
+
+    @retval number of bytes of the block to keep
+
+============================================================================*/
+static size_t LimitOutput( size_t maxOutput, size_t *pTotal, size_t len )
+{
+    size_t room;
+
+    if( maxOutput > 0 )
+    {
+        room = ( *pTotal < maxOutput ) ? maxOutput - *pTotal : 0;
+        if( len > room )
+        {
+            len = room;
         }
     }
 
-    return result;
+    *pTotal += len;
+
+    return len;
 }
 
 /*==========================================================================*/
-/*  popen2                                                                  */
+/*  SendOutput                                                              */
 /*!
-    This is a slightly modified version of the popen function which
-    allows the PID of the command to be returned.
-    The original can be found at:
-    https://www.cse.lehigh.edu/%7Ebrian/course/2013/cunix/notes/ch11/popen.c
+    Write a captured output buffer to the output stream
 
-    The popen function opens a pipe to a command and returns a file
-    pointer to the command output stream.
+    The SendOutput function writes the content of an output buffer to
+    the output stream, and to a capture buffer.  A print session which
+    cannot accept the output, and an empty capture buffer, keep a
+    reference to the output buffer's data instead of copying it.
 
     @param[in]
-       command
-            pointer to the NUL terminated command string to execute
+        fd
+            output file descriptor, or -1 to only capture the output
 
     @param[in]
-        mode
-            pointer to the NUL terminated mode string
-            "r" for read, "w" for write
+        pOutput
+            pointer to the output buffer to write
 
-    @param[out]
-        pid
-            pointer to the process id of the command
+    @param[in,out]
+        pCapture
+            pointer to a buffer to capture the output into, or NULL
 
-    @retval FILE * - file pointer to the command output stream
-    @retval NULL - command could not be executed
+    @return none
 
 ============================================================================*/
-FILE *popen2( const char *command, const char *mode, pid_t *pid )
+static void SendOutput( int fd,
+                        OutputBuffer *pOutput,
+                        OutputBuffer *pCapture )
 {
-    const int READ = 0;
-    const int WRITE = 1;
+    OutputBuffer *pShared = state.pShared;
 
-    int pfp[2];     /* the pipe and the process */
-    FILE *fp;       /* fdopen makes a fd a stream */
-    int parent_end, child_end;  /* of pipe */
+    state.pShared = pOutput;
+    WriteOutput( fd, pOutput->pData, pOutput->len, NULL );
+    state.pShared = pShared;
 
-    if( *mode == 'r' )
-    {
-        /* figure out direction */
-        parent_end = READ;
-        child_end = WRITE;
-    }
-    else if( *mode == 'w' )
+    if( pCapture != NULL )
     {
-        parent_end = WRITE;
-        child_end = READ;
+        if( ( pCapture->len == 0 ) &&
+            ( pCapture->incomplete == false ) )
+        {
+            ShareOutput( pCapture, pOutput );
+        }
+        else
+        {
+            WriteOutput( -1, pOutput->pData, pOutput->len, pCapture );
+            if( pOutput->incomplete == true )
+            {
+                pCapture->incomplete = true;
+            }
+        }
     }
-    else
+}
+
+/*==========================================================================*/
+/*  GrowOutput                                                              */
+/*!
+    Make room in an output buffer
+
+    The GrowOutput function ensures an output buffer can hold the
+    specified number of bytes, and that its data is not shared with any
+    other output buffer, so it can be written to.  Shared data is copied
+    before it is written to.
+
+    Output chunks up to the largest size class are taken from the output
+    chunk pool of the smallest class which fits, so capturing the output
+    of a command does not allocate memory once the pools have warmed up.
+    Larger chunks are allocated from the heap, doubling in size as they
+    grow.
+
+    @param[in,out]
+        pBuffer
+            pointer to the output buffer
+
+    @param[in]
+        size
+            number of bytes the buffer must hold
+
+    @retval true - the buffer can hold the specified number of bytes
+    @retval false - memory allocation failed
+
+============================================================================*/
+static bool GrowOutput( OutputBuffer *pBuffer, size_t size )
+{
+    OutputBuffer old = *pBuffer;
+    OutputChunk *pChunk;
+    size_t newsize;
+    int i;
+
+    if( ( size <= pBuffer->size ) &&
+        ( OutputShared( pBuffer ) == false ) )
     {
-        return NULL;
+        return true;
     }
 
-    if( pipe( pfp ) == -1 )
+    if( size < pBuffer->len )
     {
-        /* get a pipe */
-        return NULL;
+        size = pBuffer->len;
     }
 
-    if( ( *pid = fork() ) == -1 )
+    i = OutputClass( size );
+    if( i >= 0 )
     {
-        /* and a process */
-        close( pfp[0] ); /* or dispose of pipe */
-        close( pfp[1] );
-        return NULL;
+        newsize = (size_t)OUTPUT_CLASS_MIN << ( 2 * i );
+        /* only the chunk header is initialized, not the whole class */
+        pChunk = POOL_AllocRaw( state.pOutputPool[i] );
     }
-
-    /* --------------- parent code here ------------------- */
-    /* need to close one end and fdopen other end */
-
-    if( *pid > 0 )
+    else
     {
-        if( close( pfp[child_end] ) == -1 )
+        newsize = (size_t)OUTPUT_CLASS_MIN << ( 2 * ( OUTPUT_CLASSES - 1 ) );
+        while( newsize < size )
         {
-            return NULL;
+            newsize *= 2;
         }
-        return fdopen( pfp[parent_end], mode ); /* same mode */
-    }
-
-    /* --------------- child code here --------------------- */
-    /* need to redirect stdin or stdout then exec the cmd */
 
-    if( close( pfp[parent_end] ) == -1 )
-    {
-        /* close the other end */
-        exit( 1 ); /* do NOT return */
+        pChunk = malloc( sizeof( OutputChunk ) + newsize );
     }
 
-    if( dup2( pfp[child_end], child_end ) == -1 )
+    if( pChunk == NULL )
     {
-        exit( 1 );
+        return false;
     }
 
-    if( close( pfp[child_end] ) == -1 )
+    pChunk->refCount = 1;
+    if( old.len > 0 )
     {
-        /* done with this one */
-        exit( 1 );
+        memcpy( pChunk->data, old.pData, old.len );
     }
 
-    /* all set to run cmd */
-    execl( "/bin/sh", "sh", "-c", command, NULL );
-    exit( 1 );
+    FreeOutput( &old );
+    pBuffer->pData = pChunk->data;
+    pBuffer->size = newsize;
+
+    return true;
 }
 
 /*==========================================================================*/
-/*  ExecuteCommandInfiniteWait                                              */
+/*  ShareOutput                                                             */
 /*!
-    Execute a command and pipe the output to the output stream
+    Share the data of an output buffer
 
-    The ExecuteCommandInfiniteWait function executes the specified command
-    and redirects the command output to the specified output stream. It would
-    block indefinitely until the command completes.
+    The ShareOutput function makes an output buffer reference the data
+    of another output buffer without copying it.  The data is freed once
+    neither of them references it any more.  An output buffer with
+    shared data is copied before it is written to.
 
-    @param[in]
-       cmd
-            pointer to the NUL terminated command string to execute
+    @param[in,out]
+        pDst
+            pointer to the output buffer to share the data with.  Its
+            previous data is released
 
     @param[in]
-        fd
-            output file descriptor to pipe the command output to
+        pSrc
+            pointer to the output buffer whose data is shared
 
-    @retval EOK - command executed successfully
-    @retval ENOENT - the command was not found
-    @retval EINVAL - invalid arguments
+    @return none
 
 ============================================================================*/
-static int ExecuteCommandInfiniteWait( char *cmd, int fd )
+static void ShareOutput( OutputBuffer *pDst, OutputBuffer *pSrc )
 {
-    int n;
-    int result = ENOENT;
-    char buf[BUFSIZ];
-    FILE *fp_in;
-
-    fp_in = popen( cmd, "r" );
-    if( fp_in != NULL )
+    if( pSrc->pData != NULL )
     {
-        do
-        {
-            /* read a buffer of output */
-            n = fread( buf, 1, BUFSIZ, fp_in );
-            if( n > 0 )
-            {
-                if( fd >= 0 )
-                {
-                    /* set the output to the output stream */
-                    write( fd, buf, n );
-                }
-            }
-        } while( n > 0 );
-
-        /* close the command output data stream */
-        pclose( fp_in );
-
-        /* indicate success */
-        result = EOK;
+        GetChunk( pSrc->pData )->refCount++;
     }
 
-    return result;
+    FreeOutput( pDst );
+    *pDst = *pSrc;
 }
 
 /*==========================================================================*/
-/*  ExecuteCommandWithTimeout                                               */
+/*  OutputShared                                                            */
 /*!
-    Execute a command and pipe the output to the output stream
+    Determine if the data of an output buffer is shared
 
-    The ExecuteCommandWithTimeout function executes the specified command
-    and redirects the command output to the specified output stream. It
-    will terminate the command if the timeout is exceeded.
+    The OutputShared function determines if the data of an output buffer
+    is referenced by any other output buffer.
 
     @param[in]
-       cmd
-            pointer to the NUL terminated command string to execute
+        pBuffer
+            pointer to the output buffer
 
-    @param[in]
-        fd
-            output file descriptor to pipe the command output to
+    @retval true - the data is shared
+    @retval false - the data is not shared
+
+============================================================================*/
+static bool OutputShared( OutputBuffer *pBuffer )
+{
+    return ( pBuffer->pData != NULL ) &&
+           ( GetChunk( pBuffer->pData )->refCount > 1 );
+}
+
+/*==========================================================================*/
+/*  GetChunk                                                                */
+/*!
+    Get the output chunk holding output data
+
+    The GetChunk function gets the output chunk whose data is referenced
+    by an output buffer.
 
     @param[in]
-        timeout_seconds
-            timeout in seconds, if it is 0, the command is executed
-            in the current process, otherwise, a new process is forked
+        pData
+            pointer to the data of an output buffer
 
-    @retval EOK - command executed successfully
-    @retval ENOENT - the command was not found
-    @retval EINVAL - invalid arguments
+    @retval pointer to the output chunk
 
 ============================================================================*/
-static int ExecuteCommandWithTimeout( char *cmd, int fd, int timeout_seconds )
+static OutputChunk *GetChunk( char *pData )
 {
-    int n;
-    int result = ENOENT;
-    int retval;
-    char buf[BUFSIZ];
-    FILE *fp_in;
-    int pipefd;
-    fd_set readfds;
-    struct timeval timeout;
-    int pid;
+    return (OutputChunk *)( pData - offsetof( OutputChunk, data ) );
+}
 
-    fp_in = popen2( cmd, "r", &pid );
-    if( fp_in != NULL )
+/*==========================================================================*/
+/*  FreeOutput                                                              */
+/*!
+    Release the data of an output buffer
+
+    The FreeOutput function releases an output buffer's reference to its
+    data, and empties the buffer.  Once the data is not referenced by any
+    output buffer, its chunk is returned to the output chunk pool it was
+    taken from, or to the heap.
+
+    @param[in,out]
+        pBuffer
+            pointer to the output buffer
+
+    @return none
+
+============================================================================*/
+static void FreeOutput( OutputBuffer *pBuffer )
+{
+    OutputChunk *pChunk;
+    int i;
+
+    if( pBuffer->pData != NULL )
     {
-        /* get the file descriptor to use later with kill */
-        pipefd = fileno( fp_in );
-        if( pipefd >= 0 )
+        pChunk = GetChunk( pBuffer->pData );
+        if( --pChunk->refCount == 0 )
         {
-            /* Set up the timeout context for select */
-            FD_ZERO( &readfds );
-            FD_SET( pipefd, &readfds );
-            timeout.tv_sec = timeout_seconds;
-            timeout.tv_usec = 0;
-
-            do
+            /* pooled chunks are exactly the size of their class, and
+               heap chunks are larger than the largest class */
+            i = OutputClass( pBuffer->size );
+            if( i >= 0 )
             {
-                retval = select( pipefd + 1, &readfds, NULL, NULL, &timeout );
-                if( retval < 0 )
-                {
-                    /* select error */
-                    result = EINVAL;
-                }
-                else
-                {
-                    if( retval == 0 )
-                    {
-                        /* timeout occurred, kill the process */
-                        result = EINVAL;
-                        kill( pid, SIGKILL );
-                        syslog( LOG_ERR, "Timeout %d seconds exceeded for command %s\n", timeout_seconds, cmd );
-                    }
-                    else
-                    {
-                        /* read a buffer of output */
-                        n = fread( buf, 1, BUFSIZ, fp_in );
-                        if( n > 0 )
-                        {
-                            if( fd >= 0 )
-                            {
-                                /* set the output to the output stream */
-                                write( fd, buf, n );
-                            }
-                        }
-                        else
-                        {
-                            if( n == 0 )
-                            {
-                                /* end of data, exit now */
-                                retval = 0;
-                                result = EOK;
-                            }
-                            else
-                            {
-                                /* error reading data */
-                                result = EINVAL;
-                            }
-                        }
-                    }
-                }
-            } while( retval > 0 );
-        }
-        else
-        {
-            /* error getting file descriptor */
-            result = EINVAL;
+                POOL_Free( state.pOutputPool[i], pChunk );
+            }
+            else
+            {
+                free( pChunk );
+            }
         }
     }
 
-    /* close the command output data stream in any case */
-    pclose( fp_in );
-
-    return result;
+    memset( pBuffer, 0, sizeof( OutputBuffer ) );
 }
 
 /*==========================================================================*/
-/*  ExecuteCommand                                                          */
+/*  OutputClass                                                             */
 /*!
-    Execute a command and pipe the output to the output stream
-
-    The ExecuteCommand function executes the specified command
-    and redirects the command output to the specified output stream
-
-    @param[in]
-       cmd
-            pointer to the NUL terminated command string to execute
+    Get the size class of an output buffer
 
-    @param[in]
-        fd
-            output file descriptor to pipe the command output to
+    The OutputClass function gets the smallest output buffer size class
+    which can hold the specified number of bytes.
 
     @param[in]
-        timeout_seconds
-            timeout in seconds, if it is 0, the command is executed
-            in the current process, otherwise, a new process is forked
+        size
+            number of bytes
 
-    @retval EOK - command executed successfully
-    @retval ENOENT - the command was not found
-    @retval EINVAL - invalid arguments
+    @retval index of the output buffer size class
+    @retval -1 - the size is larger than the largest size class
 
 ============================================================================*/
-static int ExecuteCommand( char *cmd, int fd, int timeout_seconds )
+static int OutputClass( size_t size )
 {
-    int n;
-    int result = EINVAL;
-    int retval;
-    char buf[BUFSIZ];
-    FILE *fp_in;
-    int pipefd;
-    fd_set readfds;
-    struct timeval timeout;
-    int pid;
+    size_t classSize = OUTPUT_CLASS_MIN;
+    int i;
 
-    if( cmd != NULL )
+    for( i = 0; i < OUTPUT_CLASSES; i++ )
     {
-        if( timeout_seconds > 0 )
-        {
-            /* execute the command and wait for the specified timeout */
-            result = ExecuteCommandWithTimeout( cmd, fd, timeout_seconds );
-        }
-        else
+        if( size <= classSize )
         {
-            /* execute the command and wait indefinitely */
-            result = ExecuteCommandInfiniteWait( cmd, fd );
+            return i;
         }
+
+        classSize <<= 2;
     }
 
-    return result;
+    return -1;
 }
 
 /*==========================================================================*/
@@ -735,11 +9019,27 @@ static void usage( char *cmdname )
     if( cmdname != NULL )
     {
         fprintf(stderr,
-                "usage: %s [-v] [-h] [-t <timeout>] -f <filename>\n"
+                "usage: %s [-v] [-h] [-s] [-t <timeout>] [-q <depth>] [-m <clients>]\n"
+                "       [-b <failures>] [-r <seconds>] [-l <bytes>] [-f <filename>]\n"
+                "       [-d <dirname>] [-n <name>] [-p <filename>] [-i <seconds>]\n"
+                "       %s --compile <filename> -o <outfile>\n"
                 " [-h] : display this help\n"
                 " [-v] : verbose output\n"
                 " [-t] : timeout in seconds (will create a new process for every exec call)\n"
-                " -f <filename> : configuration file\n",
+                " [-q] : maximum number of queued print requests (default 64)\n"
+                " [-m] : maximum number of print requests per variable (default 16)\n"
+                " [-s] : serve the queued request with the shortest expected execution time first\n"
+                " [-b] : consecutive failures which open a command's circuit breaker (default 5, 0 to disable)\n"
+                " [-r] : seconds before a command with an open circuit breaker is retried (default 30)\n"
+                " [-l] : maximum bytes of output kept from a command (default 1048576, 0 for no limit)\n"
+                " -f <filename> : JSON or compiled configuration file\n"
+                " -d <dirname> : directory of configuration fragments\n"
+                " [-n] : shared result cache name, eg. /execvars, to share command output with other instances\n"
+                " [-p] : cache snapshot file, to keep cached output across restarts\n"
+                " [-i] : seconds between cache snapshots (default 60, 0 to only write on shutdown)\n"
+                " --compile <filename> : compile a JSON configuration file\n"
+                " -o <outfile> : compiled configuration output file\n",
+                cmdname,
                 cmdname );
     }
 }
@@ -771,16 +9071,31 @@ static void usage( char *cmdname )
 static int ProcessOptions( int argC, char *argV[], ExecVarsState *pState )
 {
     int c;
+    int n;
     int result = EINVAL;
-    const char *options = "hvt:f:";
+    const char *options = "hvst:f:d:o:q:m:b:r:l:n:p:i:";
+    static const struct option longopts[] =
+    {
+        { "compile", required_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 }
+    };
 
     if( ( pState != NULL ) &&
         ( argV != NULL ) )
     {
-        while( ( c = getopt( argC, argV, options ) ) != -1 )
+        while( ( c = getopt_long( argC, argV, options, longopts, NULL ) ) != -1 )
         {
             switch( c )
             {
+                case 'c':
+                    pState->compile = true;
+                    pState->pFileName = strdup(optarg);
+                    break;
+
+                case 'o':
+                    pState->pOutFileName = strdup(optarg);
+                    break;
+
                 case 'v':
                     pState->verbose = true;
                     break;
@@ -793,10 +9108,74 @@ static int ProcessOptions( int argC, char *argV[], ExecVarsState *pState )
                     pState->pFileName = strdup(optarg);
                     break;
 
+                case 'd':
+                    pState->pDirName = strdup(optarg);
+                    break;
+
                 case 't':
                     pState->timeout_seconds = atoi(optarg);
                     break;
 
+                case 'q':
+                    n = atoi(optarg);
+                    if( n > 0 )
+                    {
+                        pState->queueDepth = n;
+                    }
+                    break;
+
+                case 's':
+                    pState->shortestFirst = true;
+                    break;
+
+                case 'b':
+                    n = atoi(optarg);
+                    if( n >= 0 )
+                    {
+                        pState->breakerFailures = n;
+                    }
+                    break;
+
+                case 'r':
+                    n = atoi(optarg);
+                    if( n > 0 )
+                    {
+                        pState->breakerCooldown = n;
+                    }
+                    break;
+
+                case 'm':
+                    n = atoi(optarg);
+                    if( n > 0 )
+                    {
+                        pState->maxClients = n;
+                    }
+                    break;
+
+                case 'l':
+                    n = atoi(optarg);
+                    if( n >= 0 )
+                    {
+                        pState->maxOutput = n;
+                    }
+                    break;
+
+                case 'n':
+                    pState->pShmName = strdup(optarg);
+                    break;
+
+                case 'p':
+                    pState->pSnapshotName = strdup(optarg);
+                    break;
+
+                case 'i':
+                    n = atoi(optarg);
+                    if( n >= 0 )
+                    {
+                        pState->snapshotInterval = n;
+                    }
+                    break;
+
                 default:
                     break;
 
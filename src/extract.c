@@ -0,0 +1,681 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup extract extract
+ * @brief Extract values from command output
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file extract.c
+
+    Output Extraction
+
+    The extract module compiles extraction rules from their
+    definitions, and applies them in-process to captured command output
+    to select the value rendered for a variable.  Rules are defined
+    as follows:
+
+    { "regex" : "inet ([0-9.]+)", "group" : 1 }
+        extract a capture group of a POSIX extended regular expression.
+        The group defaults to 1 if the expression has a capture group,
+        otherwise the whole match is extracted.
+
+    { "line" : 2, "field" : 3, "separator" : "," }
+        extract a one-based line of output, and optionally a one-based
+        field within that line.  Fields are separated by runs of white
+        space unless a set of separator characters is specified.
+
+    { "key" : "VERSION_ID", "separator" : "=" }
+        extract the value of the first key/value pair with the specified
+        key.  The separator defaults to "=".  White space and enclosing
+        double quotes are removed from the value.
+
+    Extracted values are returned as a pointer and length into the
+    captured output, so no memory is allocated when a rule is applied.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <syslog.h>
+#include <regex.h>
+#include <varserver/varserver.h>
+#include "extract.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! maximum supported regular expression capture group */
+#define EXTRACT_MAX_GROUP 9
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static int ApplyRegex( ExtractRule *pRule,
+                       const char *pData,
+                       size_t len,
+                       const char **ppValue,
+                       size_t *pValueLen );
+static int ApplyLine( ExtractRule *pRule,
+                      const char *pData,
+                      size_t len,
+                      const char **ppValue,
+                      size_t *pValueLen );
+static int ApplyKey( ExtractRule *pRule,
+                     const char *pData,
+                     size_t len,
+                     const char **ppValue,
+                     size_t *pValueLen );
+static const char *GetLine( const char *pData,
+                            const char *pEnd,
+                            const char **ppNext );
+static void Trim( const char **ppStart, const char **ppEnd );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  EXTRACT_Create                                                          */
+/*!
+    Create an extraction rule
+
+    The EXTRACT_Create function creates an extraction rule from its
+    definition.  Regular expressions are compiled once here so
+    applying the rule does not need to compile them again.
+
+    @param[in]
+        pDef
+            pointer to the extraction rule definition
+
+    @retval pointer to the new extraction rule
+    @retval NULL - the extraction rule is invalid or not required
+
+============================================================================*/
+ExtractRule *EXTRACT_Create( const ExtractDef *pDef )
+{
+    ExtractRule *pRule = NULL;
+    bool ok = false;
+
+    if( ( pDef != NULL ) &&
+        ( pDef->type != EXTRACT_NONE ) )
+    {
+        pRule = calloc( 1, sizeof( ExtractRule ) );
+    }
+
+    if( pRule != NULL )
+    {
+        pRule->type = pDef->type;
+
+        if( pDef->pSeparator != NULL )
+        {
+            pRule->pSeparator = strdup( pDef->pSeparator );
+        }
+
+        switch( pDef->type )
+        {
+            case EXTRACT_REGEX:
+                if( ( pDef->pPattern != NULL ) &&
+                    ( regcomp( &pRule->regex,
+                               pDef->pPattern,
+                               REG_EXTENDED | REG_NEWLINE ) == 0 ) )
+                {
+                    pRule->group = pDef->group;
+                    if( pRule->group < 0 )
+                    {
+                        pRule->group = ( pRule->regex.re_nsub > 0 ) ? 1 : 0;
+                    }
+
+                    ok = ( pRule->group <= EXTRACT_MAX_GROUP ) &&
+                         ( (size_t)pRule->group <= pRule->regex.re_nsub );
+                    if( ok == false )
+                    {
+                        regfree( &pRule->regex );
+                        syslog( LOG_ERR,
+                                "Invalid capture group %d for %s\n",
+                                pRule->group,
+                                pDef->pPattern );
+                    }
+                }
+                else
+                {
+                    syslog( LOG_ERR,
+                            "Invalid regular expression %s\n",
+                            ( pDef->pPattern != NULL ) ? pDef->pPattern : "" );
+                }
+                break;
+
+            case EXTRACT_LINE:
+                pRule->line = pDef->line;
+                pRule->field = pDef->field;
+                ok = ( pRule->line > 0 ) && ( pRule->field >= 0 );
+                break;
+
+            case EXTRACT_KEY:
+                if( pDef->pKey != NULL )
+                {
+                    pRule->pKey = strdup( pDef->pKey );
+                    ok = ( pRule->pKey != NULL );
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if( ok == false )
+        {
+            syslog( LOG_ERR, "Invalid extraction rule\n" );
+            free( pRule->pKey );
+            free( pRule->pSeparator );
+            free( pRule );
+            pRule = NULL;
+        }
+    }
+
+    return pRule;
+}
+
+/*==========================================================================*/
+/*  EXTRACT_Apply                                                           */
+/*!
+    Apply an extraction rule to command output
+
+    The EXTRACT_Apply function applies an extraction rule to a
+    block of captured command output, and returns the location of
+    the extracted value within the output.
+
+    @param[in]
+        pRule
+            pointer to the extraction rule
+
+    @param[in]
+        pData
+            pointer to the captured command output
+
+    @param[in]
+        len
+            length of the captured command output
+
+    @param[out]
+        ppValue
+            location to store a pointer to the extracted value
+
+    @param[out]
+        pValueLen
+            location to store the length of the extracted value
+
+    @retval EOK - the value was extracted
+    @retval ENOENT - the output does not contain the value
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int EXTRACT_Apply( ExtractRule *pRule,
+                   const char *pData,
+                   size_t len,
+                   const char **ppValue,
+                   size_t *pValueLen )
+{
+    int result = EINVAL;
+
+    if( ( pRule != NULL ) &&
+        ( ( pData != NULL ) || ( len == 0 ) ) &&
+        ( ppValue != NULL ) &&
+        ( pValueLen != NULL ) )
+    {
+        if( pData == NULL )
+        {
+            pData = "";
+        }
+
+        switch( pRule->type )
+        {
+            case EXTRACT_REGEX:
+                result = ApplyRegex( pRule, pData, len, ppValue, pValueLen );
+                break;
+
+            case EXTRACT_LINE:
+                result = ApplyLine( pRule, pData, len, ppValue, pValueLen );
+                break;
+
+            case EXTRACT_KEY:
+                result = ApplyKey( pRule, pData, len, ppValue, pValueLen );
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  EXTRACT_Free                                                            */
+/*!
+    Free an extraction rule
+
+    The EXTRACT_Free function releases all the resources held by
+    an extraction rule.
+
+    @param[in]
+        pRule
+            pointer to the extraction rule to free
+
+    @return none
+
+============================================================================*/
+void EXTRACT_Free( ExtractRule *pRule )
+{
+    if( pRule != NULL )
+    {
+        if( pRule->type == EXTRACT_REGEX )
+        {
+            regfree( &pRule->regex );
+        }
+
+        free( pRule->pKey );
+        free( pRule->pSeparator );
+        free( pRule );
+    }
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  ApplyRegex                                                              */
+/*!
+    Apply a regular expression extraction rule
+
+    The ApplyRegex function matches the compiled regular expression
+    against the command output and returns the selected capture group.
+    REG_STARTEND is used so the output does not need to be NUL terminated.
+
+    @param[in]
+        pRule
+            pointer to the extraction rule
+
+    @param[in]
+        pData
+            pointer to the captured command output
+
+    @param[in]
+        len
+            length of the captured command output
+
+    @param[out]
+        ppValue
+            location to store a pointer to the extracted value
+
+    @param[out]
+        pValueLen
+            location to store the length of the extracted value
+
+    @retval EOK - the value was extracted
+    @retval ENOENT - the expression did not match
+
+============================================================================*/
+static int ApplyRegex( ExtractRule *pRule,
+                       const char *pData,
+                       size_t len,
+                       const char **ppValue,
+                       size_t *pValueLen )
+{
+    int result = ENOENT;
+    regmatch_t match[EXTRACT_MAX_GROUP + 1];
+
+    match[0].rm_so = 0;
+    match[0].rm_eo = len;
+
+    if( regexec( &pRule->regex,
+                 pData,
+                 pRule->group + 1,
+                 match,
+                 REG_STARTEND ) == 0 )
+    {
+        if( match[pRule->group].rm_so != -1 )
+        {
+            *ppValue = &pData[match[pRule->group].rm_so];
+            *pValueLen = match[pRule->group].rm_eo - match[pRule->group].rm_so;
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ApplyLine                                                               */
+/*!
+    Apply a line/field extraction rule
+
+    The ApplyLine function selects a line of the command output and,
+    if a field is specified, a field within that line.
+
+    @param[in]
+        pRule
+            pointer to the extraction rule
+
+    @param[in]
+        pData
+            pointer to the captured command output
+
+    @param[in]
+        len
+            length of the captured command output
+
+    @param[out]
+        ppValue
+            location to store a pointer to the extracted value
+
+    @param[out]
+        pValueLen
+            location to store the length of the extracted value
+
+    @retval EOK - the value was extracted
+    @retval ENOENT - the output does not have the line or field
+
+============================================================================*/
+static int ApplyLine( ExtractRule *pRule,
+                      const char *pData,
+                      size_t len,
+                      const char **ppValue,
+                      size_t *pValueLen )
+{
+    int result = ENOENT;
+    const char *pEnd = pData + len;
+    const char *pLine = pData;
+    const char *pLineEnd = NULL;
+    const char *p;
+    const char *pField = NULL;
+    int n;
+
+    /* find the requested line */
+    for( n = 0; ( n < pRule->line ) && ( pLine < pEnd ); n++ )
+    {
+        pLineEnd = GetLine( pLine, pEnd, &p );
+        if( n + 1 < pRule->line )
+        {
+            pLine = p;
+        }
+    }
+
+    if( ( n == pRule->line ) && ( pLineEnd != NULL ) )
+    {
+        if( pRule->field == 0 )
+        {
+            *ppValue = pLine;
+            *pValueLen = pLineEnd - pLine;
+            result = EOK;
+        }
+        else if( pRule->pSeparator == NULL )
+        {
+            /* fields are separated by runs of white space */
+            p = pLine;
+            for( n = 0; n < pRule->field; n++ )
+            {
+                while( ( p < pLineEnd ) && isspace( (unsigned char)*p ) )
+                {
+                    p++;
+                }
+
+                pField = p;
+                while( ( p < pLineEnd ) && !isspace( (unsigned char)*p ) )
+                {
+                    p++;
+                }
+            }
+
+            if( p > pField )
+            {
+                *ppValue = pField;
+                *pValueLen = p - pField;
+                result = EOK;
+            }
+        }
+        else
+        {
+            /* every separator character delimits a field */
+            p = pLine;
+            for( n = 1; ( n < pRule->field ) && ( p < pLineEnd ); p++ )
+            {
+                if( strchr( pRule->pSeparator, *p ) != NULL )
+                {
+                    n++;
+                }
+            }
+
+            if( n == pRule->field )
+            {
+                pField = p;
+                while( ( p < pLineEnd ) &&
+                       ( strchr( pRule->pSeparator, *p ) == NULL ) )
+                {
+                    p++;
+                }
+
+                *ppValue = pField;
+                *pValueLen = p - pField;
+                result = EOK;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  ApplyKey                                                                */
+/*!
+    Apply a key/value extraction rule
+
+    The ApplyKey function searches the command output for the first line
+    of the form <key><separator><value> and returns the value, with
+    surrounding white space and double quotes removed.
+
+    @param[in]
+        pRule
+            pointer to the extraction rule
+
+    @param[in]
+        pData
+            pointer to the captured command output
+
+    @param[in]
+        len
+            length of the captured command output
+
+    @param[out]
+        ppValue
+            location to store a pointer to the extracted value
+
+    @param[out]
+        pValueLen
+            location to store the length of the extracted value
+
+    @retval EOK - the value was extracted
+    @retval ENOENT - the output does not contain the key
+
+============================================================================*/
+static int ApplyKey( ExtractRule *pRule,
+                     const char *pData,
+                     size_t len,
+                     const char **ppValue,
+                     size_t *pValueLen )
+{
+    int result = ENOENT;
+    const char *pEnd = pData + len;
+    const char *pSep = ( pRule->pSeparator != NULL ) ? pRule->pSeparator : "=";
+    size_t keylen = strlen( pRule->pKey );
+    size_t seplen = strlen( pSep );
+    const char *pLine = pData;
+    const char *pLineEnd;
+    const char *pNext;
+    const char *p;
+
+    while( ( result == ENOENT ) && ( pLine < pEnd ) )
+    {
+        pLineEnd = GetLine( pLine, pEnd, &pNext );
+
+        /* skip leading white space */
+        p = pLine;
+        while( ( p < pLineEnd ) && isspace( (unsigned char)*p ) )
+        {
+            p++;
+        }
+
+        if( ( (size_t)( pLineEnd - p ) >= keylen ) &&
+            ( strncmp( p, pRule->pKey, keylen ) == 0 ) )
+        {
+            /* allow white space between the key and the separator */
+            p += keylen;
+            while( ( p < pLineEnd ) && ( *p == ' ' || *p == '\t' ) )
+            {
+                p++;
+            }
+
+            if( ( (size_t)( pLineEnd - p ) >= seplen ) &&
+                ( strncmp( p, pSep, seplen ) == 0 ) )
+            {
+                p += seplen;
+                Trim( &p, &pLineEnd );
+
+                if( ( pLineEnd - p >= 2 ) &&
+                    ( *p == '"' ) &&
+                    ( pLineEnd[-1] == '"' ) )
+                {
+                    p++;
+                    pLineEnd--;
+                }
+
+                *ppValue = p;
+                *pValueLen = pLineEnd - p;
+                result = EOK;
+            }
+        }
+
+        pLine = pNext;
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  GetLine                                                                 */
+/*!
+    Get the extent of a line of output
+
+    The GetLine function finds the end of the line starting at pData,
+    excluding any line terminator, and the start of the following line.
+
+    @param[in]
+        pData
+            pointer to the start of the line
+
+    @param[in]
+        pEnd
+            pointer to the end of the output
+
+    @param[out]
+        ppNext
+            location to store a pointer to the start of the next line
+
+    @retval pointer to the end of the line
+
+============================================================================*/
+static const char *GetLine( const char *pData,
+                            const char *pEnd,
+                            const char **ppNext )
+{
+    const char *p = memchr( pData, '\n', pEnd - pData );
+    const char *pLineEnd;
+
+    if( p != NULL )
+    {
+        *ppNext = p + 1;
+        pLineEnd = p;
+    }
+    else
+    {
+        *ppNext = pEnd;
+        pLineEnd = pEnd;
+    }
+
+    if( ( pLineEnd > pData ) && ( pLineEnd[-1] == '\r' ) )
+    {
+        pLineEnd--;
+    }
+
+    return pLineEnd;
+}
+
+/*==========================================================================*/
+/*  Trim                                                                    */
+/*!
+    Remove surrounding white space
+
+    The Trim function adjusts the start and end of a range of characters
+    to exclude leading and trailing white space.
+
+    @param[in,out]
+        ppStart
+            pointer to the start of the range
+
+    @param[in,out]
+        ppEnd
+            pointer to the end of the range
+
+    @return none
+
+============================================================================*/
+static void Trim( const char **ppStart, const char **ppEnd )
+{
+    while( ( *ppStart < *ppEnd ) && isspace( (unsigned char)**ppStart ) )
+    {
+        (*ppStart)++;
+    }
+
+    while( ( *ppEnd > *ppStart ) && isspace( (unsigned char)(*ppEnd)[-1] ) )
+    {
+        (*ppEnd)--;
+    }
+}
+
+/*! @}
+ * end of extract group */
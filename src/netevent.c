@@ -0,0 +1,324 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+
+/*!
+ * @defgroup netevent netevent
+ * @brief Network interface change events
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file netevent.c
+
+    Network Event Source
+
+    The netevent module subscribes to the rtnetlink link and address
+    multicast groups and reports the name of every network interface
+    whose link state or addresses change.  It allows network related
+    execvars to be refreshed only when the network actually changes.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <varserver/varserver.h>
+#include "netevent.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! rtnetlink multicast groups carrying link and address changes */
+#define NETEVENT_GROUPS ( RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR )
+
+/*============================================================================
+        Private file scoped variables
+============================================================================*/
+
+/*! rtnetlink socket */
+static int netfd = -1;
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static const char *GetLinkName( struct nlmsghdr *nlh );
+static const char *GetAddrName( struct nlmsghdr *nlh, char *buf );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  NETEVENT_Init                                                           */
+/*!
+    Initialize the network event source
+
+    The NETEVENT_Init function opens a non-blocking rtnetlink socket
+    subscribed to link and address change notifications.
+    It is safe to call it more than once.
+
+    @retval EOK - the event source was initialized
+    @retval other - error code from socket or bind
+
+============================================================================*/
+int NETEVENT_Init( void )
+{
+    int result = EOK;
+    struct sockaddr_nl addr;
+
+    if( netfd == -1 )
+    {
+        netfd = socket( AF_NETLINK,
+                        SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        NETLINK_ROUTE );
+        if( netfd == -1 )
+        {
+            result = errno;
+        }
+        else
+        {
+            memset( &addr, 0, sizeof( addr ) );
+            addr.nl_family = AF_NETLINK;
+            addr.nl_groups = NETEVENT_GROUPS;
+
+            if( bind( netfd, (struct sockaddr *)&addr, sizeof( addr ) ) != 0 )
+            {
+                result = errno;
+                close( netfd );
+                netfd = -1;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  NETEVENT_GetFd                                                          */
+/*!
+    Get the network event file descriptor
+
+    The NETEVENT_GetFd function returns the rtnetlink socket so it
+    can be added to an event loop.
+
+    @retval the rtnetlink socket, or -1 if not initialized
+
+============================================================================*/
+int NETEVENT_GetFd( void )
+{
+    return netfd;
+}
+
+/*==========================================================================*/
+/*  NETEVENT_Process                                                        */
+/*!
+    Process pending network events
+
+    The NETEVENT_Process function drains all pending rtnetlink messages
+    without blocking, and invokes the callback with the name of the
+    interface affected by each RTM_NEWLINK, RTM_DELLINK, RTM_NEWADDR,
+    and RTM_DELADDR message.  If messages were lost because the socket
+    receive buffer overflowed, the callback is invoked with a NULL
+    interface name.
+
+    @param[in]
+        cb
+            callback to invoke for each changed interface
+
+    @param[in]
+        arg
+            opaque argument passed to the callback
+
+    @retval EOK - pending events were processed
+    @retval EINVAL - invalid arguments or event source not initialized
+
+============================================================================*/
+int NETEVENT_Process( NetEventCallback cb, void *arg )
+{
+    int result = EINVAL;
+    char buf[8192] __attribute__(( aligned( NLMSG_ALIGNTO ) ));
+    char ifname[IF_NAMESIZE];
+    struct nlmsghdr *nlh;
+    const char *name;
+    ssize_t len;
+
+    if( ( netfd != -1 ) &&
+        ( cb != NULL ) )
+    {
+        result = EOK;
+
+        while( 1 )
+        {
+            len = recv( netfd, buf, sizeof( buf ), 0 );
+            if( len < 0 )
+            {
+                if( errno == ENOBUFS )
+                {
+                    /* events were dropped, so any interface may have changed */
+                    cb( NULL, arg );
+                    continue;
+                }
+
+                break;
+            }
+
+            for( nlh = (struct nlmsghdr *)buf;
+                 NLMSG_OK( nlh, len );
+                 nlh = NLMSG_NEXT( nlh, len ) )
+            {
+                switch( nlh->nlmsg_type )
+                {
+                    case RTM_NEWLINK:
+                    case RTM_DELLINK:
+                        name = GetLinkName( nlh );
+                        cb( name, arg );
+                        break;
+
+                    case RTM_NEWADDR:
+                    case RTM_DELADDR:
+                        name = GetAddrName( nlh, ifname );
+                        cb( name, arg );
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  GetLinkName                                                             */
+/*!
+    Get the interface name from a link message
+
+    The GetLinkName function searches the attributes of an RTM_NEWLINK
+    or RTM_DELLINK message for the interface name.
+
+    @param[in]
+        nlh
+            pointer to the netlink message header
+
+    @retval pointer to the interface name
+    @retval NULL - the interface name was not found
+
+============================================================================*/
+static const char *GetLinkName( struct nlmsghdr *nlh )
+{
+    struct ifinfomsg *ifi = NLMSG_DATA( nlh );
+    struct rtattr *rta;
+    int len = IFLA_PAYLOAD( nlh );
+
+    for( rta = IFLA_RTA( ifi ); RTA_OK( rta, len ); rta = RTA_NEXT( rta, len ) )
+    {
+        if( rta->rta_type == IFLA_IFNAME )
+        {
+            return (const char *)RTA_DATA( rta );
+        }
+    }
+
+    return NULL;
+}
+
+/*==========================================================================*/
+/*  GetAddrName                                                             */
+/*!
+    Get the interface name from an address message
+
+    The GetAddrName function gets the name of the interface an
+    RTM_NEWADDR or RTM_DELADDR message refers to.  The name is looked
+    up from the interface index, since the IFA_LABEL attribute of an
+    IPv4 address holds its alias label, eg. "eth0:1".  If the interface
+    no longer exists, the label is used with any alias suffix removed.
+
+    @param[in]
+        nlh
+            pointer to the netlink message header
+
+    @param[in]
+        buf
+            pointer to a buffer of at least IF_NAMESIZE bytes
+
+    @retval pointer to the interface name
+    @retval NULL - the interface name was not found
+
+============================================================================*/
+static const char *GetAddrName( struct nlmsghdr *nlh, char *buf )
+{
+    struct ifaddrmsg *ifa = NLMSG_DATA( nlh );
+    struct rtattr *rta;
+    int len = IFA_PAYLOAD( nlh );
+    char *p;
+
+    if( if_indextoname( ifa->ifa_index, buf ) != NULL )
+    {
+        return buf;
+    }
+
+    for( rta = IFA_RTA( ifa ); RTA_OK( rta, len ); rta = RTA_NEXT( rta, len ) )
+    {
+        if( rta->rta_type == IFA_LABEL )
+        {
+            strncpy( buf, (const char *)RTA_DATA( rta ), IF_NAMESIZE - 1 );
+            buf[IF_NAMESIZE - 1] = '\0';
+
+            /* strip the alias suffix */
+            p = strchr( buf, ':' );
+            if( p != NULL )
+            {
+                *p = '\0';
+            }
+
+            return buf;
+        }
+    }
+
+    return NULL;
+}
+
+/*! @}
+ * end of netevent group */
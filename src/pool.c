@@ -0,0 +1,370 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup pool pool
+ * @brief Fixed size object pool
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file pool.c
+
+    Fixed Size Object Pool
+
+    The pool module allocates fixed size objects from large contiguous
+    chunks, so the registry entries created while a configuration is
+    loaded are laid out next to each other in memory in the order they
+    are defined, instead of being scattered across the heap by one
+    malloc per entry.  Freed objects are kept on a free list and reused
+    by later allocations, so reloads do not grow the pool.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdalign.h>
+#include <varserver/varserver.h>
+#include "pool.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! a contiguous chunk of pooled objects */
+typedef struct poolChunk
+{
+    /*! pointer to the next chunk */
+    struct poolChunk *pNext;
+
+    /*! number of objects in the chunk */
+    size_t count;
+
+    /*! number of objects handed out from the chunk */
+    size_t used;
+
+    /*! object storage */
+    alignas( max_align_t ) unsigned char data[];
+
+} PoolChunk;
+
+/*! a freed object */
+typedef struct poolFree
+{
+    /*! pointer to the next freed object */
+    struct poolFree *pNext;
+
+} PoolFree;
+
+/*! fixed size object pool */
+struct pool
+{
+    /*! size of each object, rounded up to the maximum alignment */
+    size_t objsize;
+
+    /*! default number of objects per chunk */
+    size_t count;
+
+    /*! list of chunks, the first of which objects are allocated from */
+    PoolChunk *pChunks;
+
+    /*! list of freed objects */
+    PoolFree *pFree;
+};
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static int AddChunk( Pool *pPool, size_t count );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  POOL_Create                                                             */
+/*!
+    Create an object pool
+
+    The POOL_Create function creates a pool of fixed size objects.
+    No memory is allocated for the objects until they are needed.
+
+    @param[in]
+        objsize
+            size of each object in bytes
+
+    @param[in]
+        count
+            number of objects to allocate in each chunk
+
+    @retval pointer to the object pool
+    @retval NULL - the pool could not be created
+
+============================================================================*/
+Pool *POOL_Create( size_t objsize, size_t count )
+{
+    Pool *pPool = NULL;
+
+    if( ( objsize > 0 ) &&
+        ( count > 0 ) )
+    {
+        pPool = calloc( 1, sizeof( Pool ) );
+        if( pPool != NULL )
+        {
+            if( objsize < sizeof( PoolFree ) )
+            {
+                objsize = sizeof( PoolFree );
+            }
+
+            pPool->objsize = ( objsize + alignof( max_align_t ) - 1 ) &
+                             ~( alignof( max_align_t ) - 1 );
+            pPool->count = count;
+        }
+    }
+
+    return pPool;
+}
+
+/*==========================================================================*/
+/*  POOL_Reserve                                                            */
+/*!
+    Reserve space for objects
+
+    The POOL_Reserve function ensures that the specified number of objects
+    can be allocated from one contiguous chunk.  It is used when the number
+    of objects to be allocated is known in advance, such as when a
+    configuration is first loaded.
+
+    @param[in]
+        pPool
+            pointer to the object pool
+
+    @param[in]
+        count
+            number of objects to reserve space for
+
+    @retval EOK - the space was reserved
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+int POOL_Reserve( Pool *pPool, size_t count )
+{
+    int result = EINVAL;
+    PoolChunk *pChunk;
+
+    if( pPool != NULL )
+    {
+        result = EOK;
+
+        pChunk = pPool->pChunks;
+        if( ( pChunk == NULL ) ||
+            ( pChunk->count - pChunk->used < count ) )
+        {
+            result = AddChunk( pPool, count );
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  POOL_Alloc                                                              */
+/*!
+    Allocate an object
+
+    The POOL_Alloc function allocates a zeroed object from the pool.
+
+    @param[in]
+        pPool
+            pointer to the object pool
+
+    @retval pointer to the zeroed object
+    @retval NULL - memory allocation failed
+
+============================================================================*/
+void *POOL_Alloc( Pool *pPool )
+{
+    void *p;
+
+    p = POOL_AllocRaw( pPool );
+    if( p != NULL )
+    {
+        memset( p, 0, pPool->objsize );
+    }
+
+    return p;
+}
+
+/*==========================================================================*/
+/*  POOL_AllocRaw                                                           */
+/*!
+    Allocate an object without clearing it
+
+    The POOL_AllocRaw function allocates an object from the pool without
+    zeroing it, for large objects which the caller initializes itself.
+    Objects are taken from the current chunk in order so objects allocated
+    together are adjacent in memory.  Once the chunk is full, freed objects
+    are reused, and a new chunk is added when there are none.
+
+    @param[in]
+        pPool
+            pointer to the object pool
+
+    @retval pointer to the uninitialized object
+    @retval NULL - memory allocation failed
+
+============================================================================*/
+void *POOL_AllocRaw( Pool *pPool )
+{
+    void *p = NULL;
+    PoolChunk *pChunk;
+
+    if( pPool != NULL )
+    {
+        pChunk = pPool->pChunks;
+        if( ( pChunk != NULL ) &&
+            ( pChunk->used < pChunk->count ) )
+        {
+            /* take the next object from the current chunk */
+            p = &pChunk->data[pChunk->used * pPool->objsize];
+            pChunk->used++;
+        }
+        else if( pPool->pFree != NULL )
+        {
+            /* reuse a freed object */
+            p = pPool->pFree;
+            pPool->pFree = pPool->pFree->pNext;
+        }
+        else if( AddChunk( pPool, pPool->count ) == EOK )
+        {
+            pChunk = pPool->pChunks;
+            p = &pChunk->data[0];
+            pChunk->used++;
+        }
+    }
+
+    return p;
+}
+
+/*==========================================================================*/
+/*  POOL_Free                                                               */
+/*!
+    Free an object
+
+    The POOL_Free function returns an object to the pool's free list.
+    The memory is not returned to the system.
+
+    @param[in]
+        pPool
+            pointer to the object pool
+
+    @param[in]
+        p
+            pointer to the object to free, or NULL
+
+    @return none
+
+============================================================================*/
+void POOL_Free( Pool *pPool, void *p )
+{
+    PoolFree *pFree = (PoolFree *)p;
+
+    if( ( pPool != NULL ) &&
+        ( pFree != NULL ) )
+    {
+        pFree->pNext = pPool->pFree;
+        pPool->pFree = pFree;
+    }
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  AddChunk                                                                */
+/*!
+    Add a chunk to an object pool
+
+    The AddChunk function allocates a new chunk of objects and makes it
+    the chunk which objects are allocated from.  Objects remaining in
+    the previous chunk are moved to the free list.
+
+    @param[in]
+        pPool
+            pointer to the object pool
+
+    @param[in]
+        count
+            number of objects in the chunk
+
+    @retval EOK - the chunk was added
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int AddChunk( Pool *pPool, size_t count )
+{
+    int result = ENOMEM;
+    PoolChunk *pChunk;
+    PoolChunk *pPrev;
+
+    if( count <= ( SIZE_MAX - sizeof( PoolChunk ) ) / pPool->objsize )
+    {
+        pChunk = malloc( sizeof( PoolChunk ) + count * pPool->objsize );
+        if( pChunk != NULL )
+        {
+            /* don't lose the unused objects of the previous chunk */
+            pPrev = pPool->pChunks;
+            while( ( pPrev != NULL ) &&
+                   ( pPrev->used < pPrev->count ) )
+            {
+                POOL_Free( pPool, &pPrev->data[pPrev->used * pPool->objsize] );
+                pPrev->used++;
+            }
+
+            pChunk->count = count;
+            pChunk->used = 0;
+            pChunk->pNext = pPool->pChunks;
+            pPool->pChunks = pChunk;
+
+            result = EOK;
+        }
+    }
+
+    return result;
+}
+
+/*! @}
+ * end of pool group */
@@ -0,0 +1,354 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup reference reference
+ * @brief References to execvar values in commands
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file reference.c
+
+    Execvar References
+
+    The reference module supports commands which use the values of other
+    execvars, such as:
+
+    { "var" : "/sys/network/gateway",
+      "exec" : "ip route show dev ${/sys/network/iface} | awk '/default/ {print $3}'" }
+
+    A reference is a variable name, which must start with '/', enclosed
+    in "${" and "}".  Shell parameter expansions such as "${HOME}" are
+    not references, and are left for the shell.
+
+    Each reference is replaced by the value of the referenced execvar,
+    enclosed in single quotes as a single shell word.  Single quotes
+    only protect the value where the reference is not already quoted:
+    within double quotes the shell would still expand "$(...)" in the
+    value, and within single quotes the value would end up unquoted.
+    A command with a reference inside quotes is therefore invalid, so a
+    value can never inject shell syntax into the command.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <varserver/varserver.h>
+#include "reference.h"
+#include "strbuf.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! maximum length of a referenced variable name */
+#define REFERENCE_MAX_NAME 256
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static size_t GetReference( const char *p );
+static size_t SkipChar( const char *p, char *pQuote );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  REFERENCE_Iterate                                                       */
+/*!
+    Iterate through the execvar references in a command
+
+    The REFERENCE_Iterate function invokes a callback with the name of
+    each execvar referenced by a command, in the order the references
+    appear in the command.  A variable referenced several times is
+    passed to the callback once per reference.  A reference inside
+    single or double quotes makes the command invalid.
+
+    @param[in]
+        pCmd
+            pointer to the NUL terminated command sequence
+
+    @param[in]
+        cb
+            callback invoked with each referenced variable name
+
+    @param[in]
+        arg
+            opaque argument passed to the callback
+
+    @retval number of references in the command
+    @retval -1 - a referenced variable name is too long, or a reference
+                 is inside quotes
+
+============================================================================*/
+int REFERENCE_Iterate( const char *pCmd, ReferenceCallback cb, void *arg )
+{
+    char name[REFERENCE_MAX_NAME];
+    const char *p;
+    char quote = '\0';
+    size_t n;
+    int count = 0;
+
+    if( pCmd == NULL )
+    {
+        return 0;
+    }
+
+    for( p = pCmd; *p != '\0'; )
+    {
+        n = GetReference( p );
+        if( n == 0 )
+        {
+            p += SkipChar( p, &quote );
+            continue;
+        }
+
+        if( ( n >= sizeof( name ) ) ||
+            ( quote != '\0' ) )
+        {
+            return -1;
+        }
+
+        memcpy( name, p + 2, n );
+        name[n] = '\0';
+
+        if( cb != NULL )
+        {
+            cb( name, arg );
+        }
+
+        count++;
+        p += n + 3;
+    }
+
+    return count;
+}
+
+/*==========================================================================*/
+/*  REFERENCE_Expand                                                        */
+/*!
+    Substitute the referenced execvar values into a command
+
+    The REFERENCE_Expand function replaces each execvar reference in a
+    command with its value.  Each value is enclosed in single quotes, with
+    any single quotes in the value escaped, so it is passed to the shell
+    as a single word.  References inside quotes are not expanded, since
+    the value would not be protected there.
+
+    @param[in]
+        pCmd
+            pointer to the NUL terminated command sequence
+
+    @param[in]
+        ppValues
+            array of pointers to the values of the references, in the
+            order the references appear in the command
+
+    @param[in]
+        pLens
+            array of the lengths of the values
+
+    @param[in]
+        n
+            number of values
+
+    @retval pointer to the dynamically allocated command
+    @retval NULL - the command has more references than values, has
+                   a reference inside quotes, or memory allocation failed
+
+============================================================================*/
+char *REFERENCE_Expand( const char *pCmd,
+                        const char * const *ppValues,
+                        const size_t *pLens,
+                        int n )
+{
+    StringBuffer cmd;
+    const char *p;
+    char quote = '\0';
+    size_t len;
+    size_t i;
+    int idx = 0;
+
+    if( pCmd == NULL )
+    {
+        return NULL;
+    }
+
+    memset( &cmd, 0, sizeof( cmd ) );
+
+    for( p = pCmd; *p != '\0'; )
+    {
+        len = GetReference( p );
+        if( len == 0 )
+        {
+            len = SkipChar( p, &quote );
+            STRBUF_Append( &cmd, p, len );
+            p += len;
+            continue;
+        }
+
+        if( ( idx >= n ) ||
+            ( quote != '\0' ) )
+        {
+            free( cmd.pData );
+            return NULL;
+        }
+
+        /* substitute the quoted value */
+        STRBUF_Append( &cmd, "'", 1 );
+        for( i = 0; i < pLens[idx]; i++ )
+        {
+            if( ppValues[idx][i] == '\'' )
+            {
+                STRBUF_Append( &cmd, "'\\''", 4 );
+            }
+            else
+            {
+                STRBUF_Append( &cmd, &ppValues[idx][i], 1 );
+            }
+        }
+
+        STRBUF_Append( &cmd, "'", 1 );
+
+        idx++;
+        p += len + 3;
+    }
+
+    STRBUF_Append( &cmd, "", 1 );
+
+    if( cmd.error == true )
+    {
+        free( cmd.pData );
+        cmd.pData = NULL;
+    }
+
+    return cmd.pData;
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  GetReference                                                            */
+/*!
+    Get the length of an execvar reference
+
+    The GetReference function checks if the text at a dollar sign is a
+    "${/name}" execvar reference, where the name starts with '/' and
+    does not contain white space.
+
+    @param[in]
+        p
+            pointer to the dollar sign
+
+    @retval length of the referenced variable name
+    @retval 0 - the text is not an execvar reference
+
+============================================================================*/
+static size_t GetReference( const char *p )
+{
+    size_t n = 0;
+
+    if( ( p[0] == '$' ) &&
+        ( p[1] == '{' ) &&
+        ( p[2] == '/' ) )
+    {
+        p += 2;
+        while( ( p[n] != '}' ) &&
+               ( p[n] != '\0' ) &&
+               ( p[n] != ' ' ) &&
+               ( p[n] != '\t' ) &&
+               ( p[n] != '\n' ) )
+        {
+            n++;
+        }
+
+        if( p[n] != '}' )
+        {
+            n = 0;
+        }
+    }
+
+    return n;
+}
+
+/*==========================================================================*/
+/*  SkipChar                                                                */
+/*!
+    Skip a character of a command, tracking the shell quoting
+
+    The SkipChar function gets the length of the character of a command
+    at the specified position, which is two for a character escaped with
+    a backslash outside single quotes, and updates the quoting state
+    with any quote it opens or closes.
+
+    @param[in]
+        p
+            pointer to the character
+
+    @param[in,out]
+        pQuote
+            pointer to the quote character of the enclosing quotes,
+            or NUL if the character is not quoted
+
+    @retval number of characters to skip
+
+============================================================================*/
+static size_t SkipChar( const char *p, char *pQuote )
+{
+    if( ( p[0] == '\\' ) &&
+        ( p[1] != '\0' ) &&
+        ( *pQuote != '\'' ) )
+    {
+        return 2;
+    }
+
+    if( ( *pQuote == '\0' ) &&
+        ( ( p[0] == '\'' ) || ( p[0] == '"' ) ) )
+    {
+        *pQuote = p[0];
+    }
+    else if( *pQuote == p[0] )
+    {
+        *pQuote = '\0';
+    }
+
+    return 1;
+}
+
+/*! @}
+ * end of reference group */
@@ -0,0 +1,649 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup shmcache shmcache
+ * @brief Shared memory result cache
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file shmcache.c
+
+    Shared Memory Result Cache
+
+    The shmcache module maintains a cache of command output in a POSIX
+    shared memory object, so several execvars instances on the same
+    host can share the output of identical commands instead of each
+    executing them.
+
+    The cache is a direct mapped table of fixed size entries keyed by
+    a hash of the command.  Each entry is protected by a sequence lock:
+    a writer makes the entry's sequence number odd while it updates the
+    entry, and a reader retries if the sequence number was odd or
+    changed while it copied the entry, so readers never block writers
+    and no lock is held across processes.
+
+    An instance which is about to execute a command for an entry can
+    claim the entry with a lease, so other instances wait for its
+    output rather than executing the command at the same time.  Leases
+    expire, so an instance which fails or exits while holding a lease
+    does not stop the others from executing the command.
+
+    Entries expire according to the monotonic clock, which is shared by
+    every process on the host.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include "shmcache.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! identifies an initialized shared memory result cache */
+#define SHMCACHE_MAGIC 0x53484d43
+
+/*! version of the shared memory layout */
+#define SHMCACHE_VERSION 1
+
+/*! number of times a reader retries an entry being written */
+#define SHMCACHE_READ_RETRIES 4
+
+/*! time in milliseconds to wait for another instance to initialize
+    the shared memory object */
+#define SHMCACHE_INIT_WAIT_MS 100
+
+/*! header at the start of the shared memory object */
+typedef struct shmHeader
+{
+    /*! SHMCACHE_MAGIC once the shared memory has been initialized */
+    _Atomic uint32_t magic;
+
+    /*! version of the shared memory layout */
+    uint32_t version;
+
+    /*! number of entries in the table */
+    uint32_t nEntries;
+
+    /*! maximum number of bytes of output held by an entry */
+    uint32_t valueSize;
+
+    /*! padding to the size of a cache line */
+    uint8_t reserved[48];
+
+} ShmHeader;
+
+/*! shared cache entry */
+typedef struct shmEntry
+{
+    /*! sequence number, which is odd while the entry is being written */
+    _Atomic uint32_t seq;
+
+    /*! number of bytes of output */
+    uint32_t len;
+
+    /*! key of the command whose output is held, or 0 */
+    uint64_t key;
+
+    /*! monotonic time in milliseconds at which the output expires */
+    uint64_t expires_ms;
+
+    /*! monotonic time in milliseconds until which an instance is
+        executing the command for this entry, or 0 */
+    _Atomic uint64_t lease_ms;
+
+    /*! key of the command the lease was taken for */
+    _Atomic uint64_t leaseKey;
+
+    /*! command output */
+    char data[SHMCACHE_VALUE_SIZE];
+
+} ShmEntry;
+
+/*! shared memory result cache */
+struct shmCache
+{
+    /*! pointer to the mapped shared memory */
+    ShmHeader *pHeader;
+
+    /*! pointer to the entry table in the shared memory */
+    ShmEntry *pEntries;
+
+    /*! number of entries in the table */
+    uint32_t nEntries;
+
+    /*! size of the mapped shared memory in bytes */
+    size_t size;
+};
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static ShmEntry *GetEntry( ShmCache *pCache, uint64_t key );
+static uint64_t GetTimeMs( void );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  SHMCACHE_Open                                                           */
+/*!
+    Open a shared memory result cache
+
+    The SHMCACHE_Open function opens the named shared memory result
+    cache, creating and initializing it if no other instance has done
+    so yet.  Every instance sharing the cache must use the same number
+    of entries.
+
+    @param[in]
+        name
+            name of the POSIX shared memory object, eg. "/execvars"
+
+    @param[in]
+        nEntries
+            number of entries in the cache
+
+    @retval pointer to the shared memory result cache
+    @retval NULL - the cache could not be opened
+
+============================================================================*/
+ShmCache *SHMCACHE_Open( const char *name, uint32_t nEntries )
+{
+    ShmCache *pCache;
+    ShmHeader *pHeader;
+    struct stat st;
+    size_t size;
+    bool created = true;
+    int fd;
+    int i;
+
+    if( ( name == NULL ) ||
+        ( nEntries == 0 ) )
+    {
+        return NULL;
+    }
+
+    size = sizeof( ShmHeader ) + (size_t)nEntries * sizeof( ShmEntry );
+
+    fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    if( ( fd == -1 ) && ( errno == EEXIST ) )
+    {
+        /* another instance created the cache */
+        created = false;
+        fd = shm_open( name, O_RDWR, 0600 );
+    }
+
+    if( fd == -1 )
+    {
+        syslog( LOG_ERR,
+                "Unable to open shared cache %s: %s\n",
+                name,
+                strerror( errno ) );
+        return NULL;
+    }
+
+    /* size the object if its creator has not done so yet */
+    if( ( fstat( fd, &st ) != 0 ) ||
+        ( ( st.st_size == 0 ) && ( ftruncate( fd, size ) != 0 ) ) ||
+        ( ( st.st_size != 0 ) && ( (size_t)st.st_size != size ) ) )
+    {
+        syslog( LOG_ERR, "Shared cache %s has the wrong size\n", name );
+        close( fd );
+        return NULL;
+    }
+
+    pHeader = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( pHeader == MAP_FAILED )
+    {
+        syslog( LOG_ERR,
+                "Unable to map shared cache %s: %s\n",
+                name,
+                strerror( errno ) );
+        return NULL;
+    }
+
+    if( created == true )
+    {
+        /* the object is zero filled, so only the header is set up */
+        pHeader->version = SHMCACHE_VERSION;
+        pHeader->nEntries = nEntries;
+        pHeader->valueSize = SHMCACHE_VALUE_SIZE;
+        atomic_store_explicit( &pHeader->magic,
+                               SHMCACHE_MAGIC,
+                               memory_order_release );
+    }
+    else
+    {
+        /* wait for the creator to set up the header */
+        for( i = 0;
+             ( i < SHMCACHE_INIT_WAIT_MS ) &&
+             ( atomic_load_explicit( &pHeader->magic,
+                                     memory_order_acquire ) != SHMCACHE_MAGIC );
+             i++ )
+        {
+            poll( NULL, 0, 1 );
+        }
+    }
+
+    if( ( atomic_load_explicit( &pHeader->magic,
+                                memory_order_acquire ) != SHMCACHE_MAGIC ) ||
+        ( pHeader->version != SHMCACHE_VERSION ) ||
+        ( pHeader->nEntries != nEntries ) ||
+        ( pHeader->valueSize != SHMCACHE_VALUE_SIZE ) )
+    {
+        syslog( LOG_ERR, "Shared cache %s is incompatible\n", name );
+        munmap( pHeader, size );
+        return NULL;
+    }
+
+    pCache = calloc( 1, sizeof( ShmCache ) );
+    if( pCache == NULL )
+    {
+        munmap( pHeader, size );
+        return NULL;
+    }
+
+    pCache->pHeader = pHeader;
+    pCache->pEntries = (ShmEntry *)&pHeader[1];
+    pCache->nEntries = nEntries;
+    pCache->size = size;
+
+    return pCache;
+}
+
+/*==========================================================================*/
+/*  SHMCACHE_Close                                                          */
+/*!
+    Close a shared memory result cache
+
+    The SHMCACHE_Close function unmaps a shared memory result cache.
+    The shared memory object itself is kept for the other instances.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache, or NULL
+
+    @return none
+
+============================================================================*/
+void SHMCACHE_Close( ShmCache *pCache )
+{
+    if( pCache != NULL )
+    {
+        munmap( pCache->pHeader, pCache->size );
+        free( pCache );
+    }
+}
+
+/*==========================================================================*/
+/*  SHMCACHE_Get                                                            */
+/*!
+    Get a command's output from a shared memory result cache
+
+    The SHMCACHE_Get function copies the output of a command from the
+    shared memory result cache, if the cache holds output for the command
+    which has not expired.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache
+
+    @param[in]
+        key
+            key of the command
+
+    @param[out]
+        buf
+            pointer to a buffer of SHMCACHE_VALUE_SIZE bytes to copy the
+            output into
+
+    @param[out]
+        pLen
+            pointer to a location to store the number of bytes of output
+
+    @param[out]
+        pExpires_ms
+            pointer to a location to store the monotonic time in
+            milliseconds at which the output expires
+
+    @retval EOK - the output was copied
+    @retval EINPROGRESS - another instance has claimed the entry to
+                          execute the command
+    @retval ENOENT - the cache does not hold output for the command
+
+============================================================================*/
+int SHMCACHE_Get( ShmCache *pCache,
+                  uint64_t key,
+                  char *buf,
+                  size_t *pLen,
+                  uint64_t *pExpires_ms )
+{
+    ShmEntry *pEntry;
+    uint64_t now_ms = GetTimeMs();
+    uint64_t expires_ms;
+    uint32_t seq;
+    uint32_t len;
+    int i;
+
+    pEntry = GetEntry( pCache, key );
+    if( pEntry == NULL )
+    {
+        return ENOENT;
+    }
+
+    for( i = 0; i < SHMCACHE_READ_RETRIES; i++ )
+    {
+        seq = atomic_load_explicit( &pEntry->seq, memory_order_acquire );
+        if( ( seq & 1 ) != 0 )
+        {
+            /* the entry is being written */
+            continue;
+        }
+
+        len = pEntry->len;
+        expires_ms = pEntry->expires_ms;
+        if( ( pEntry->key != key ) ||
+            ( expires_ms <= now_ms ) ||
+            ( len > SHMCACHE_VALUE_SIZE ) )
+        {
+            break;
+        }
+
+        memcpy( buf, pEntry->data, len );
+
+        /* the copy is only valid if the entry did not change meanwhile */
+        atomic_thread_fence( memory_order_acquire );
+        if( atomic_load_explicit( &pEntry->seq,
+                                  memory_order_relaxed ) == seq )
+        {
+            *pLen = len;
+            *pExpires_ms = expires_ms;
+            return EOK;
+        }
+    }
+
+    /* only a claim for this command is waited for */
+    return ( ( atomic_load_explicit( &pEntry->lease_ms,
+                                     memory_order_relaxed ) > now_ms ) &&
+             ( atomic_load( &pEntry->leaseKey ) == key ) )
+           ? EINPROGRESS
+           : ENOENT;
+}
+
+/*==========================================================================*/
+/*  SHMCACHE_Claim                                                          */
+/*!
+    Claim a shared memory result cache entry
+
+    The SHMCACHE_Claim function takes a lease on the entry for a command
+    which is about to be executed, so other instances wait for its
+    output instead of executing it too.  The lease ends when the output
+    is stored, when it is released, or when it expires.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache
+
+    @param[in]
+        key
+            key of the command
+
+    @param[in]
+        lease_ms
+            duration of the lease in milliseconds
+
+    @retval EOK - the entry was claimed
+    @retval EBUSY - another instance holds a lease on the entry
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int SHMCACHE_Claim( ShmCache *pCache, uint64_t key, uint64_t lease_ms )
+{
+    ShmEntry *pEntry;
+    uint64_t now_ms = GetTimeMs();
+    uint64_t lease;
+
+    pEntry = GetEntry( pCache, key );
+    if( pEntry == NULL )
+    {
+        return EINVAL;
+    }
+
+    lease = atomic_load_explicit( &pEntry->lease_ms, memory_order_relaxed );
+    if( ( lease > now_ms ) ||
+        ( atomic_compare_exchange_strong( &pEntry->lease_ms,
+                                          &lease,
+                                          now_ms + lease_ms ) == false ) )
+    {
+        return EBUSY;
+    }
+
+    atomic_store( &pEntry->leaseKey, key );
+
+    return EOK;
+}
+
+/*==========================================================================*/
+/*  SHMCACHE_Release                                                        */
+/*!
+    Release a claim on a shared memory result cache entry
+
+    The SHMCACHE_Release function ends the lease taken on the entry for
+    a command whose execution did not produce any output to store, so
+    other instances stop waiting for it.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache
+
+    @param[in]
+        key
+            key of the command
+
+    @return none
+
+============================================================================*/
+void SHMCACHE_Release( ShmCache *pCache, uint64_t key )
+{
+    ShmEntry *pEntry;
+
+    pEntry = GetEntry( pCache, key );
+    if( ( pEntry != NULL ) &&
+        ( atomic_load( &pEntry->leaseKey ) == key ) )
+    {
+        atomic_store( &pEntry->lease_ms, 0 );
+    }
+}
+
+/*==========================================================================*/
+/*  SHMCACHE_Put                                                            */
+/*!
+    Store a command's output in a shared memory result cache
+
+    The SHMCACHE_Put function stores the output of a command in the
+    shared memory result cache, replacing whatever the entry held, and
+    ends any lease taken on the entry for the command.  The output is
+    not stored if another instance is writing the entry at the same
+    time.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache
+
+    @param[in]
+        key
+            key of the command
+
+    @param[in]
+        pData
+            pointer to the command output
+
+    @param[in]
+        len
+            number of bytes of command output
+
+    @param[in]
+        expires_ms
+            monotonic time in milliseconds at which the output expires
+
+    @retval EOK - the output was stored
+    @retval E2BIG - the output does not fit in an entry
+    @retval EBUSY - the entry is being written by another instance
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int SHMCACHE_Put( ShmCache *pCache,
+                  uint64_t key,
+                  const char *pData,
+                  size_t len,
+                  uint64_t expires_ms )
+{
+    ShmEntry *pEntry;
+    uint32_t seq;
+
+    pEntry = GetEntry( pCache, key );
+    if( ( pEntry == NULL ) ||
+        ( ( pData == NULL ) && ( len > 0 ) ) )
+    {
+        return EINVAL;
+    }
+
+    if( len > SHMCACHE_VALUE_SIZE )
+    {
+        SHMCACHE_Release( pCache, key );
+        return E2BIG;
+    }
+
+    /* take the entry's write lock by making its sequence number odd */
+    seq = atomic_load_explicit( &pEntry->seq, memory_order_relaxed );
+    if( ( ( seq & 1 ) != 0 ) ||
+        ( atomic_compare_exchange_strong_explicit( &pEntry->seq,
+                                                   &seq,
+                                                   seq + 1,
+                                                   memory_order_acquire,
+                                                   memory_order_relaxed )
+            == false ) )
+    {
+        return EBUSY;
+    }
+
+    atomic_thread_fence( memory_order_release );
+
+    pEntry->key = key;
+    pEntry->len = (uint32_t)len;
+    pEntry->expires_ms = expires_ms;
+    if( len > 0 )
+    {
+        memcpy( pEntry->data, pData, len );
+    }
+
+    /* end the claim on the entry for this command */
+    if( atomic_load( &pEntry->leaseKey ) == key )
+    {
+        atomic_store_explicit( &pEntry->lease_ms, 0, memory_order_relaxed );
+    }
+
+    /* publish the entry */
+    atomic_store_explicit( &pEntry->seq, seq + 2, memory_order_release );
+
+    return EOK;
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  GetEntry                                                                */
+/*!
+    Get the shared memory result cache entry for a command
+
+    The GetEntry function gets the entry of the direct mapped table which
+    holds the output of a command.
+
+    @param[in]
+        pCache
+            pointer to the shared memory result cache
+
+    @param[in]
+        key
+            key of the command
+
+    @retval pointer to the entry
+    @retval NULL - invalid arguments
+
+============================================================================*/
+static ShmEntry *GetEntry( ShmCache *pCache, uint64_t key )
+{
+    return ( pCache != NULL ) ? &pCache->pEntries[key % pCache->nEntries]
+                              : NULL;
+}
+
+/*==========================================================================*/
+/*  GetTimeMs                                                               */
+/*!
+    Get the monotonic time in milliseconds
+
+    The GetTimeMs function gets the current monotonic clock time
+    in milliseconds.
+
+    @retval the monotonic time in milliseconds
+
+============================================================================*/
+static uint64_t GetTimeMs( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! @}
+ * end of shmcache group */
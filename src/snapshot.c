@@ -0,0 +1,579 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup snapshot snapshot
+ * @brief Cache snapshot file
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file snapshot.c
+
+    Cache Snapshot File
+
+    The snapshot module writes cached command output to a compact
+    snapshot file, and loads it back, so a restarted execvars service
+    starts with the output which is still valid instead of executing
+    every command at once.
+
+    A snapshot is written to a temporary file which is renamed over the
+    snapshot file once it is complete, so a snapshot file is never
+    partially written.  It is loaded by mapping it into memory.
+
+    Expiry times are stored in wall clock time, since the monotonic clock
+    does not survive a reboot, and are converted back to monotonic time
+    when the snapshot is loaded.  An entry is never given longer to live
+    than its time to live, so a wall clock step cannot extend it.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include "snapshot.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! identifies a snapshot file */
+#define SNAPSHOT_MAGIC 0x45565353
+
+/*! version of the snapshot file format */
+#define SNAPSHOT_VERSION 1
+
+/*! suffix of the temporary file a snapshot is written to */
+#define SNAPSHOT_TMP_SUFFIX ".tmp"
+
+/*! alignment of the records in a snapshot file */
+#define SNAPSHOT_ALIGN 8
+
+/*! snapshot file header */
+typedef struct snapshotHeader
+{
+    /*! SNAPSHOT_MAGIC */
+    uint32_t magic;
+
+    /*! version of the snapshot file format */
+    uint32_t version;
+
+    /*! number of records following the header */
+    uint32_t count;
+
+    /*! reserved */
+    uint32_t reserved;
+
+} SnapshotHeader;
+
+/*! snapshot file record header, followed by the command output padded
+    to SNAPSHOT_ALIGN bytes */
+typedef struct snapshotRecord
+{
+    /*! key identifying the command */
+    uint64_t key;
+
+    /*! time to live of the command's output in milliseconds */
+    uint64_t ttl_ms;
+
+    /*! wall clock time in milliseconds at which the output expires */
+    uint64_t expires_ms;
+
+    /*! number of bytes of command output */
+    uint32_t len;
+
+    /*! reserved */
+    uint32_t reserved;
+
+} SnapshotRecord;
+
+/*! snapshot being written */
+struct snapshot
+{
+    /*! temporary file the snapshot is written to */
+    FILE *fp;
+
+    /*! name of the snapshot file */
+    char *pFileName;
+
+    /*! name of the temporary file */
+    char *pTmpName;
+
+    /*! number of records written */
+    uint32_t count;
+
+    /*! EOK, or the first error writing the snapshot */
+    int result;
+};
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static int WriteRecord( Snapshot *pSnapshot, const SnapshotEntry *pEntry );
+static void FreeSnapshot( Snapshot *pSnapshot );
+static uint64_t GetClockMs( clockid_t clock );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  SNAPSHOT_Create                                                         */
+/*!
+    Start writing a snapshot
+
+    The SNAPSHOT_Create function creates the temporary file which a new
+    snapshot is written to.  The snapshot replaces the snapshot file
+    when it is committed.
+
+    @param[in]
+        pFileName
+            pointer to the name of the snapshot file
+
+    @retval pointer to the snapshot
+    @retval NULL - the snapshot could not be created
+
+============================================================================*/
+Snapshot *SNAPSHOT_Create( const char *pFileName )
+{
+    Snapshot *pSnapshot;
+    SnapshotHeader header;
+    size_t len;
+    int fd;
+
+    if( pFileName == NULL )
+    {
+        return NULL;
+    }
+
+    pSnapshot = calloc( 1, sizeof( Snapshot ) );
+    if( pSnapshot == NULL )
+    {
+        return NULL;
+    }
+
+    len = strlen( pFileName );
+    pSnapshot->pFileName = strdup( pFileName );
+    pSnapshot->pTmpName = malloc( len + sizeof( SNAPSHOT_TMP_SUFFIX ) );
+    if( ( pSnapshot->pFileName == NULL ) ||
+        ( pSnapshot->pTmpName == NULL ) )
+    {
+        FreeSnapshot( pSnapshot );
+        return NULL;
+    }
+
+    memcpy( pSnapshot->pTmpName, pFileName, len );
+    memcpy( &pSnapshot->pTmpName[len],
+            SNAPSHOT_TMP_SUFFIX,
+            sizeof( SNAPSHOT_TMP_SUFFIX ) );
+
+    fd = open( pSnapshot->pTmpName,
+               O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+               0600 );
+    if( fd != -1 )
+    {
+        pSnapshot->fp = fdopen( fd, "w" );
+        if( pSnapshot->fp == NULL )
+        {
+            close( fd );
+        }
+    }
+
+    if( pSnapshot->fp == NULL )
+    {
+        pSnapshot->result = EIO;
+        FreeSnapshot( pSnapshot );
+        return NULL;
+    }
+
+    /* the record count is filled in when the snapshot is committed */
+    memset( &header, 0, sizeof( header ) );
+    if( fwrite( &header, sizeof( header ), 1, pSnapshot->fp ) != 1 )
+    {
+        pSnapshot->result = EIO;
+    }
+
+    return pSnapshot;
+}
+
+/*==========================================================================*/
+/*  SNAPSHOT_Add                                                            */
+/*!
+    Add cached command output to a snapshot
+
+    The SNAPSHOT_Add function writes the cached output of a command to
+    a snapshot.  Output which has already expired is left out.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        pEntry
+            pointer to the cached command output
+
+    @retval EOK - the output was added
+    @retval EIO - the snapshot could not be written
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int SNAPSHOT_Add( Snapshot *pSnapshot, const SnapshotEntry *pEntry )
+{
+    if( ( pSnapshot == NULL ) ||
+        ( pEntry == NULL ) ||
+        ( ( pEntry->pData == NULL ) && ( pEntry->len > 0 ) ) ||
+        ( pEntry->len > UINT32_MAX ) )
+    {
+        return EINVAL;
+    }
+
+    if( ( pSnapshot->result == EOK ) &&
+        ( pEntry->expires_ms > GetClockMs( CLOCK_MONOTONIC ) ) )
+    {
+        pSnapshot->result = WriteRecord( pSnapshot, pEntry );
+    }
+
+    return pSnapshot->result;
+}
+
+/*==========================================================================*/
+/*  SNAPSHOT_Commit                                                         */
+/*!
+    Complete a snapshot
+
+    The SNAPSHOT_Commit function completes a snapshot, flushes it to
+    storage, and replaces the snapshot file with it.  If the snapshot
+    could not be written, the snapshot file is left unchanged.  The
+    snapshot is freed in either case.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @retval EOK - the snapshot file was replaced
+    @retval EIO - the snapshot could not be written
+    @retval EINVAL - invalid arguments
+
+============================================================================*/
+int SNAPSHOT_Commit( Snapshot *pSnapshot )
+{
+    SnapshotHeader header;
+    int result;
+
+    if( pSnapshot == NULL )
+    {
+        return EINVAL;
+    }
+
+    memset( &header, 0, sizeof( header ) );
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.count = pSnapshot->count;
+
+    if( ( pSnapshot->result == EOK ) &&
+        ( ( fseek( pSnapshot->fp, 0, SEEK_SET ) != 0 ) ||
+          ( fwrite( &header, sizeof( header ), 1, pSnapshot->fp ) != 1 ) ||
+          ( fflush( pSnapshot->fp ) != 0 ) ||
+          ( fsync( fileno( pSnapshot->fp ) ) != 0 ) ) )
+    {
+        pSnapshot->result = EIO;
+    }
+
+    if( fclose( pSnapshot->fp ) != 0 )
+    {
+        pSnapshot->result = EIO;
+    }
+
+    pSnapshot->fp = NULL;
+
+    if( ( pSnapshot->result == EOK ) &&
+        ( rename( pSnapshot->pTmpName, pSnapshot->pFileName ) != 0 ) )
+    {
+        pSnapshot->result = EIO;
+    }
+
+    result = pSnapshot->result;
+    FreeSnapshot( pSnapshot );
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  SNAPSHOT_Load                                                           */
+/*!
+    Load a snapshot
+
+    The SNAPSHOT_Load function maps a snapshot file into memory and
+    invokes a function for each of its entries which has not expired yet.
+    The entry's output points into the mapped snapshot file, and is only
+    valid until the function returns.
+
+    @param[in]
+        pFileName
+            pointer to the name of the snapshot file
+
+    @param[in]
+        fn
+            function to invoke for each unexpired entry
+
+    @param[in]
+        arg
+            opaque argument passed to the function
+
+    @retval EOK - the snapshot was loaded
+    @retval ENOENT - there is no snapshot file
+    @retval EINVAL - the snapshot file is not valid
+
+============================================================================*/
+int SNAPSHOT_Load( const char *pFileName, SnapshotFn fn, void *arg )
+{
+    SnapshotHeader *pHeader;
+    SnapshotRecord *pRecord;
+    SnapshotEntry entry;
+    struct stat st;
+    const char *pData;
+    size_t size;
+    size_t offset;
+    uint64_t mono_ms;
+    uint64_t wall_ms;
+    uint64_t remaining_ms;
+    uint32_t i;
+    int result = EOK;
+    int fd;
+
+    if( ( pFileName == NULL ) ||
+        ( fn == NULL ) )
+    {
+        return EINVAL;
+    }
+
+    fd = open( pFileName, O_RDONLY | O_CLOEXEC );
+    if( fd == -1 )
+    {
+        return ENOENT;
+    }
+
+    if( ( fstat( fd, &st ) != 0 ) ||
+        ( (size_t)st.st_size < sizeof( SnapshotHeader ) ) )
+    {
+        close( fd );
+        return EINVAL;
+    }
+
+    size = (size_t)st.st_size;
+    pData = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( pData == MAP_FAILED )
+    {
+        return EINVAL;
+    }
+
+    pHeader = (SnapshotHeader *)pData;
+    if( ( pHeader->magic != SNAPSHOT_MAGIC ) ||
+        ( pHeader->version != SNAPSHOT_VERSION ) )
+    {
+        munmap( (void *)pData, size );
+        return EINVAL;
+    }
+
+    mono_ms = GetClockMs( CLOCK_MONOTONIC );
+    wall_ms = GetClockMs( CLOCK_REALTIME );
+
+    offset = sizeof( SnapshotHeader );
+    for( i = 0; i < pHeader->count; i++ )
+    {
+        if( size - offset < sizeof( SnapshotRecord ) )
+        {
+            result = EINVAL;
+            break;
+        }
+
+        pRecord = (SnapshotRecord *)&pData[offset];
+        offset += sizeof( SnapshotRecord );
+        if( size - offset < pRecord->len )
+        {
+            result = EINVAL;
+            break;
+        }
+
+        if( pRecord->expires_ms > wall_ms )
+        {
+            /* never extend an entry beyond its time to live */
+            remaining_ms = pRecord->expires_ms - wall_ms;
+            if( remaining_ms > pRecord->ttl_ms )
+            {
+                remaining_ms = pRecord->ttl_ms;
+            }
+
+            entry.key = pRecord->key;
+            entry.ttl_ms = pRecord->ttl_ms;
+            entry.expires_ms = mono_ms + remaining_ms;
+            entry.pData = &pData[offset];
+            entry.len = pRecord->len;
+
+            fn( &entry, arg );
+        }
+
+        /* skip the output and its padding */
+        offset += pRecord->len;
+        offset += ( SNAPSHOT_ALIGN - ( offset % SNAPSHOT_ALIGN ) ) %
+                  SNAPSHOT_ALIGN;
+        if( offset > size )
+        {
+            offset = size;
+        }
+    }
+
+    munmap( (void *)pData, size );
+
+    return result;
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  WriteRecord                                                             */
+/*!
+    Write a snapshot record
+
+    The WriteRecord function writes a record holding cached command
+    output, and its padding, to a snapshot's temporary file.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @param[in]
+        pEntry
+            pointer to the cached command output
+
+    @retval EOK - the record was written
+    @retval EIO - the record could not be written
+
+============================================================================*/
+static int WriteRecord( Snapshot *pSnapshot, const SnapshotEntry *pEntry )
+{
+    static const char padding[SNAPSHOT_ALIGN];
+    SnapshotRecord record;
+    size_t pad;
+
+    memset( &record, 0, sizeof( record ) );
+    record.key = pEntry->key;
+    record.ttl_ms = pEntry->ttl_ms;
+    record.expires_ms = GetClockMs( CLOCK_REALTIME ) +
+                        ( pEntry->expires_ms - GetClockMs( CLOCK_MONOTONIC ) );
+    record.len = (uint32_t)pEntry->len;
+
+    pad = ( SNAPSHOT_ALIGN - ( pEntry->len % SNAPSHOT_ALIGN ) ) %
+          SNAPSHOT_ALIGN;
+
+    if( ( fwrite( &record, sizeof( record ), 1, pSnapshot->fp ) != 1 ) ||
+        ( fwrite( pEntry->pData, 1, pEntry->len, pSnapshot->fp )
+            != pEntry->len ) ||
+        ( fwrite( padding, 1, pad, pSnapshot->fp ) != pad ) )
+    {
+        return EIO;
+    }
+
+    pSnapshot->count++;
+
+    return EOK;
+}
+
+/*==========================================================================*/
+/*  FreeSnapshot                                                            */
+/*!
+    Free a snapshot
+
+    The FreeSnapshot function frees a snapshot, removing its temporary
+    file if it was not committed.
+
+    @param[in]
+        pSnapshot
+            pointer to the snapshot
+
+    @return none
+
+============================================================================*/
+static void FreeSnapshot( Snapshot *pSnapshot )
+{
+    if( pSnapshot->fp != NULL )
+    {
+        fclose( pSnapshot->fp );
+    }
+
+    if( ( pSnapshot->result != EOK ) &&
+        ( pSnapshot->pTmpName != NULL ) )
+    {
+        unlink( pSnapshot->pTmpName );
+    }
+
+    free( pSnapshot->pFileName );
+    free( pSnapshot->pTmpName );
+    free( pSnapshot );
+}
+
+/*==========================================================================*/
+/*  GetClockMs                                                              */
+/*!
+    Get the time of a clock in milliseconds
+
+    The GetClockMs function gets the current time of the specified clock
+    in milliseconds.
+
+    @param[in]
+        clock
+            clock to read: CLOCK_MONOTONIC or CLOCK_REALTIME
+
+    @retval the time in milliseconds
+
+============================================================================*/
+static uint64_t GetClockMs( clockid_t clock )
+{
+    struct timespec ts;
+
+    clock_gettime( clock, &ts );
+
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*! @}
+ * end of snapshot group */
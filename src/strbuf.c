@@ -0,0 +1,122 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup strbuf strbuf
+ * @brief Growable strings
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file strbuf.c
+
+    Growable Strings
+
+    The strbuf module builds strings of unknown length, such as expanded
+    command sequences.  A string buffer which could not be grown is
+    marked as failed, and ignores anything appended to it afterwards, so
+    the caller only needs to check for failure once the string is built.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <string.h>
+#include <stdlib.h>
+#include "strbuf.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! initial size of a string buffer */
+#define STRBUF_INITIAL_SIZE 64
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  STRBUF_Append                                                           */
+/*!
+    Append data to a growable string
+
+    The STRBUF_Append function appends data to a string buffer.  If the
+    buffer cannot be grown, the buffer is marked as failed.  Nothing is
+    appended to a failed buffer.
+
+    @param[in,out]
+        pBuf
+            pointer to the string buffer
+
+    @param[in]
+        pData
+            pointer to the data to append
+
+    @param[in]
+        len
+            number of bytes to append
+
+    @return none
+
+============================================================================*/
+void STRBUF_Append( StringBuffer *pBuf, const char *pData, size_t len )
+{
+    size_t size;
+    char *p;
+
+    if( pBuf->error == true )
+    {
+        return;
+    }
+
+    if( pBuf->len + len > pBuf->size )
+    {
+        size = ( pBuf->size > 0 ) ? pBuf->size : STRBUF_INITIAL_SIZE;
+        while( size < pBuf->len + len )
+        {
+            size *= 2;
+        }
+
+        p = realloc( pBuf->pData, size );
+        if( p == NULL )
+        {
+            pBuf->error = true;
+            return;
+        }
+
+        pBuf->pData = p;
+        pBuf->size = size;
+    }
+
+    memcpy( &pBuf->pData[pBuf->len], pData, len );
+    pBuf->len += len;
+}
+
+/*! @}
+ * end of strbuf group */
@@ -0,0 +1,583 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup template template
+ * @brief Parameterized execvar templates
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file template.c
+
+    Execvar Templates
+
+    The template module supports execvar definitions whose variable
+    names contain parameters, such as:
+
+    { "var" : "/sys/network/{if}/mac",
+      "exec" : "cat /sys/class/net/{if}/address" }
+
+    A template is compiled into a regular expression which matches the
+    concrete variable names, and each parameter captures one path
+    component.  When a concrete variable is rendered, its parameter
+    values are bound from its name and substituted into the command.
+
+    Variable names are matched without regard to case, as the variable
+    server does, and parameter values are taken from the variable names
+    as they are stored in the variable server.
+
+    Parameter values may only contain letters, digits, and the characters
+    "_.:@-", so they cannot carry shell syntax into the command.  A
+    variable name whose parameter value is "." or "..", which would
+    traverse a path, or starts with "-", which would be taken as a
+    command option, does not match the template.
+    Braces in the command which do not name a parameter are left as-is.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <regex.h>
+#include <syslog.h>
+#include <varserver/varserver.h>
+#include "template.h"
+#include "strbuf.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! regular expression which matches a parameter value */
+#define PARAM_REGEX "([A-Za-z0-9_.:@-]+)"
+
+/*! characters which must be escaped in the literal parts of a template */
+#define REGEX_SPECIAL ".[]()*+?^$|\\{}"
+
+/*! compiled execvar template */
+struct template
+{
+    /*! compiled regular expression matching the concrete variable names */
+    regex_t regex;
+
+    /*! literal prefix of the variable names, used to query the variables */
+    char *pPrefix;
+
+    /*! command sequence containing parameter references */
+    char *pCmd;
+
+    /*! parameter names */
+    char *params[TEMPLATE_MAX_PARAMS];
+
+    /*! number of parameters */
+    int nParams;
+};
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static bool BindParams( Template *pTemplate,
+                        const char *varname,
+                        regmatch_t *pMatch );
+static size_t GetParamName( const char *p );
+static int FindParam( Template *pTemplate, const char *name, size_t len );
+static int AddParam( Template *pTemplate, const char *name, size_t len );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  TEMPLATE_IsTemplate                                                     */
+/*!
+    Check if a variable name is a template
+
+    The TEMPLATE_IsTemplate function checks if a variable name contains
+    at least one "{name}" parameter.
+
+    @param[in]
+        name
+            pointer to the NUL terminated variable name
+
+    @retval true - the variable name is a template
+    @retval false - the variable name is not a template
+
+============================================================================*/
+bool TEMPLATE_IsTemplate( const char *name )
+{
+    const char *p;
+
+    if( name != NULL )
+    {
+        for( p = strchr( name, '{' ); p != NULL; p = strchr( p + 1, '{' ) )
+        {
+            if( GetParamName( p ) > 0 )
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/*==========================================================================*/
+/*  TEMPLATE_Create                                                         */
+/*!
+    Compile an execvar template
+
+    The TEMPLATE_Create function compiles a variable name template into
+    a regular expression with one capture group per parameter, and
+    stores the command which the parameters are substituted into.
+    Each parameter may appear only once in the variable name.
+
+    @param[in]
+        pVarPattern
+            pointer to the NUL terminated variable name template
+
+    @param[in]
+        pCmdPattern
+            pointer to the NUL terminated command sequence template
+
+    @retval pointer to the compiled template
+    @retval NULL - the template is invalid
+
+============================================================================*/
+Template *TEMPLATE_Create( const char *pVarPattern, const char *pCmdPattern )
+{
+    Template *pTemplate;
+    StringBuffer regex;
+    size_t n;
+    const char *p;
+    bool ok = true;
+
+    if( ( pVarPattern == NULL ) ||
+        ( pCmdPattern == NULL ) )
+    {
+        return NULL;
+    }
+
+    pTemplate = calloc( 1, sizeof( Template ) );
+    if( pTemplate == NULL )
+    {
+        return NULL;
+    }
+
+    memset( &regex, 0, sizeof( regex ) );
+    STRBUF_Append( &regex, "^", 1 );
+
+    for( p = pVarPattern; ( *p != '\0' ) && ( ok == true ); p++ )
+    {
+        n = ( *p == '{' ) ? GetParamName( p ) : 0;
+        if( n > 0 )
+        {
+            if( pTemplate->pPrefix == NULL )
+            {
+                pTemplate->pPrefix = strndup( pVarPattern, p - pVarPattern );
+            }
+
+            /* each parameter becomes a capture group */
+            ok = ( AddParam( pTemplate, p + 1, n ) == EOK );
+            STRBUF_Append( &regex, PARAM_REGEX, strlen( PARAM_REGEX ) );
+            p += n + 1;
+        }
+        else
+        {
+            if( strchr( REGEX_SPECIAL, *p ) != NULL )
+            {
+                STRBUF_Append( &regex, "\\", 1 );
+            }
+
+            STRBUF_Append( &regex, p, 1 );
+        }
+    }
+
+    /* terminate the expression */
+    STRBUF_Append( &regex, "$", 2 );
+
+    pTemplate->pCmd = strdup( pCmdPattern );
+
+    if( ( ok == true ) &&
+        ( regex.error == false ) &&
+        ( pTemplate->pPrefix != NULL ) &&
+        ( pTemplate->pCmd != NULL ) &&
+        ( regcomp( &pTemplate->regex,
+                      regex.pData,
+                      REG_EXTENDED | REG_ICASE ) == 0 ) )
+    {
+        free( regex.pData );
+        return pTemplate;
+    }
+
+    free( regex.pData );
+    free( pTemplate->pPrefix );
+    free( pTemplate->pCmd );
+    while( pTemplate->nParams > 0 )
+    {
+        free( pTemplate->params[--pTemplate->nParams] );
+    }
+
+    free( pTemplate );
+
+    return NULL;
+}
+
+/*==========================================================================*/
+/*  TEMPLATE_GetPrefix                                                      */
+/*!
+    Get the literal prefix of a template
+
+    The TEMPLATE_GetPrefix function gets the part of the variable name
+    template before its first parameter.  It is used to narrow the
+    variable server query for the concrete variables.
+
+    @param[in]
+        pTemplate
+            pointer to the compiled template
+
+    @retval pointer to the NUL terminated prefix
+    @retval NULL - invalid template
+
+============================================================================*/
+const char *TEMPLATE_GetPrefix( Template *pTemplate )
+{
+    return ( pTemplate != NULL ) ? pTemplate->pPrefix : NULL;
+}
+
+/*==========================================================================*/
+/*  TEMPLATE_Match                                                          */
+/*!
+    Check if a variable name matches a template
+
+    @param[in]
+        pTemplate
+            pointer to the compiled template
+
+    @param[in]
+        varname
+            pointer to the NUL terminated variable name
+
+    @retval true - the variable name matches the template
+    @retval false - the variable name does not match the template
+
+============================================================================*/
+bool TEMPLATE_Match( Template *pTemplate, const char *varname )
+{
+    regmatch_t match[TEMPLATE_MAX_PARAMS + 1];
+
+    return BindParams( pTemplate, varname, match );
+}
+
+/*==========================================================================*/
+/*  TEMPLATE_Expand                                                         */
+/*!
+    Expand the command of a template for a variable
+
+    The TEMPLATE_Expand function binds the parameter values of a template
+    from a concrete variable name, and substitutes them into the command.
+
+    @param[in]
+        pTemplate
+            pointer to the compiled template
+
+    @param[in]
+        varname
+            pointer to the NUL terminated variable name
+
+    @retval pointer to the dynamically allocated command
+    @retval NULL - the variable name does not match the template
+
+============================================================================*/
+char *TEMPLATE_Expand( Template *pTemplate, const char *varname )
+{
+    regmatch_t match[TEMPLATE_MAX_PARAMS + 1];
+    StringBuffer cmd;
+    size_t n;
+    const char *p;
+    int idx;
+
+    if( BindParams( pTemplate, varname, match ) == false )
+    {
+        return NULL;
+    }
+
+    memset( &cmd, 0, sizeof( cmd ) );
+
+    for( p = pTemplate->pCmd; *p != '\0'; p++ )
+    {
+        n = ( *p == '{' ) ? GetParamName( p ) : 0;
+        idx = ( n > 0 ) ? FindParam( pTemplate, p + 1, n ) : -1;
+        if( idx >= 0 )
+        {
+            /* substitute the parameter value */
+            STRBUF_Append( &cmd,
+                           &varname[match[idx + 1].rm_so],
+                           match[idx + 1].rm_eo - match[idx + 1].rm_so );
+            p += n + 1;
+        }
+        else
+        {
+            STRBUF_Append( &cmd, p, 1 );
+        }
+    }
+
+    STRBUF_Append( &cmd, "", 1 );
+
+    if( cmd.error == true )
+    {
+        free( cmd.pData );
+        cmd.pData = NULL;
+    }
+
+    return cmd.pData;
+}
+
+/*==========================================================================*/
+/*  TEMPLATE_Free                                                           */
+/*!
+    Free a compiled template
+
+    @param[in]
+        pTemplate
+            pointer to the compiled template, or NULL
+
+    @return none
+
+============================================================================*/
+void TEMPLATE_Free( Template *pTemplate )
+{
+    if( pTemplate != NULL )
+    {
+        regfree( &pTemplate->regex );
+        free( pTemplate->pPrefix );
+        free( pTemplate->pCmd );
+
+        while( pTemplate->nParams > 0 )
+        {
+            free( pTemplate->params[--pTemplate->nParams] );
+        }
+
+        free( pTemplate );
+    }
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  BindParams                                                              */
+/*!
+    Bind the parameter values of a template from a variable name
+
+    The BindParams function matches a variable name against a template,
+    and checks that none of the parameter values is "." or "..", or
+    starts with "-", so a value cannot traverse a path or inject an
+    option when it is substituted into the command.
+
+    @param[in]
+        pTemplate
+            pointer to the compiled template
+
+    @param[in]
+        varname
+            pointer to the NUL terminated variable name
+
+    @param[out]
+        pMatch
+            pointer to TEMPLATE_MAX_PARAMS + 1 matches to receive the
+            parameter values
+
+    @retval true - the parameter values were bound
+    @retval false - the variable name does not match the template
+
+============================================================================*/
+static bool BindParams( Template *pTemplate,
+                        const char *varname,
+                        regmatch_t *pMatch )
+{
+    const char *pValue;
+    size_t len;
+    int i;
+
+    if( ( pTemplate == NULL ) ||
+        ( varname == NULL ) ||
+        ( regexec( &pTemplate->regex,
+                   varname,
+                   pTemplate->nParams + 1,
+                   pMatch,
+                   0 ) != 0 ) )
+    {
+        return false;
+    }
+
+    for( i = 1; i <= pTemplate->nParams; i++ )
+    {
+        pValue = &varname[pMatch[i].rm_so];
+        len = pMatch[i].rm_eo - pMatch[i].rm_so;
+
+        if( ( pValue[0] == '-' ) ||
+            ( ( len == 1 ) && ( pValue[0] == '.' ) ) ||
+            ( ( len == 2 ) && ( strncmp( pValue, "..", 2 ) == 0 ) ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*==========================================================================*/
+/*  GetParamName                                                            */
+/*!
+    Get the length of a parameter reference
+
+    The GetParamName function checks if the text at an opening brace is
+    a "{name}" parameter reference, where the name consists of letters,
+    digits and underscores.
+
+    @param[in]
+        p
+            pointer to the opening brace
+
+    @retval length of the parameter name
+    @retval 0 - the text is not a parameter reference
+
+============================================================================*/
+static size_t GetParamName( const char *p )
+{
+    size_t n = 0;
+
+    if( *p == '{' )
+    {
+        p++;
+        while( isalnum( (unsigned char)p[n] ) || ( p[n] == '_' ) )
+        {
+            n++;
+        }
+
+        if( p[n] != '}' )
+        {
+            n = 0;
+        }
+    }
+
+    return n;
+}
+
+/*==========================================================================*/
+/*  FindParam                                                               */
+/*!
+    Find a template parameter
+
+    @param[in]
+        pTemplate
+            pointer to the template
+
+    @param[in]
+        name
+            pointer to the parameter name (not NUL terminated)
+
+    @param[in]
+        len
+            length of the parameter name
+
+    @retval index of the parameter
+    @retval -1 - the template has no such parameter
+
+============================================================================*/
+static int FindParam( Template *pTemplate, const char *name, size_t len )
+{
+    int i;
+
+    for( i = 0; i < pTemplate->nParams; i++ )
+    {
+        if( ( strlen( pTemplate->params[i] ) == len ) &&
+            ( strncmp( pTemplate->params[i], name, len ) == 0 ) )
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*==========================================================================*/
+/*  AddParam                                                                */
+/*!
+    Add a parameter to a template
+
+    @param[in]
+        pTemplate
+            pointer to the template
+
+    @param[in]
+        name
+            pointer to the parameter name (not NUL terminated)
+
+    @param[in]
+        len
+            length of the parameter name
+
+    @retval EOK - the parameter was added
+    @retval EEXIST - the parameter is already used in the template
+    @retval E2BIG - the template has too many parameters
+    @retval ENOMEM - memory allocation failed
+
+============================================================================*/
+static int AddParam( Template *pTemplate, const char *name, size_t len )
+{
+    if( FindParam( pTemplate, name, len ) >= 0 )
+    {
+        return EEXIST;
+    }
+
+    if( pTemplate->nParams >= TEMPLATE_MAX_PARAMS )
+    {
+        return E2BIG;
+    }
+
+    pTemplate->params[pTemplate->nParams] = strndup( name, len );
+    if( pTemplate->params[pTemplate->nParams] == NULL )
+    {
+        return ENOMEM;
+    }
+
+    pTemplate->nParams++;
+
+    return EOK;
+}
+
+/*! @}
+ * end of template group */
@@ -0,0 +1,477 @@
+/*============================================================================
+MIT License
+
+Copyright (c) 2023 Trevor Monk
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+============================================================================*/
+
+/*!
+ * @defgroup watch watch
+ * @brief File dependency watcher
+ * @{
+ */
+
+/*==========================================================================*/
+/*!
+@file watch.c
+
+    File Dependency Watcher
+
+    The watch module uses inotify to track changes to the files
+    that an execvar's output depends on.  A callback is invoked
+    for every registered dependency which has changed.
+
+    The parent directory of each file is watched rather than the
+    file itself, so files which are replaced via rename (as most
+    editors and configuration managers do) are still detected.
+
+    A directory can also be watched, in which case its callback is
+    invoked for any change to the files it contains.
+
+    If a watched directory is deleted or moved away, the kernel drops
+    its watch.  The watch is added again once the directory exists
+    again, and until then the callbacks of its dependencies are invoked
+    every time events are processed, so their output is never cached
+    while changes to it cannot be seen.
+
+    Note that pseudo-filesystems such as /proc and /sys do not
+    generate inotify events, so only regular files should be
+    listed as dependencies.
+
+*/
+/*==========================================================================*/
+
+/*============================================================================
+        Includes
+============================================================================*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <limits.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <varserver/varserver.h>
+#include "watch.h"
+
+/*============================================================================
+        Private definitions
+============================================================================*/
+
+/*! inotify events which indicate a change to a file in a directory */
+#define WATCH_EVENTS ( IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | \
+                       IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                       IN_DELETE_SELF | IN_MOVE_SELF )
+
+/*! a single file dependency */
+typedef struct watchEntry
+{
+    /*! inotify watch descriptor of the parent directory, or -1 if the
+        directory's watch was lost */
+    int wd;
+
+    /*! path of the watched directory */
+    char *pDir;
+
+    /*! full path of the watched file */
+    char *pPath;
+
+    /*! pointer to the file name within pPath, or NULL if the entry
+        watches a whole directory */
+    char *pName;
+
+    /*! callback to invoke when the file changes */
+    WatchCallback cb;
+
+    /*! opaque callback argument */
+    void *arg;
+
+    /*! pointer to the next watch entry */
+    struct watchEntry *pNext;
+
+} WatchEntry;
+
+/*============================================================================
+        Private file scoped variables
+============================================================================*/
+
+/*! inotify file descriptor */
+static int watchfd = -1;
+
+/*! list of watched files */
+static WatchEntry *pWatchList = NULL;
+
+/*============================================================================
+        Private function declarations
+============================================================================*/
+
+static void LoseWatch( int wd );
+static void RestoreWatches( void );
+
+/*============================================================================
+        Public function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  WATCH_Init                                                              */
+/*!
+    Initialize the file dependency watcher
+
+    The WATCH_Init function creates the non-blocking inotify instance
+    used to track file dependencies.  It is safe to call it more than once.
+
+    @retval EOK - the watcher was initialized
+    @retval other - error code from inotify_init1
+
+============================================================================*/
+int WATCH_Init( void )
+{
+    int result = EOK;
+
+    if( watchfd == -1 )
+    {
+        watchfd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( watchfd == -1 )
+        {
+            result = errno;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  WATCH_GetFd                                                             */
+/*!
+    Get the watcher file descriptor
+
+    The WATCH_GetFd function returns the inotify file descriptor so it
+    can be added to an event loop.
+
+    @retval the inotify file descriptor, or -1 if not initialized
+
+============================================================================*/
+int WATCH_GetFd( void )
+{
+    return watchfd;
+}
+
+/*==========================================================================*/
+/*  WATCH_Add                                                               */
+/*!
+    Add a file dependency
+
+    The WATCH_Add function registers a callback to be invoked whenever
+    the specified file is created, modified, replaced, or deleted.
+    If the path is a directory, the callback is invoked whenever any
+    file in the directory changes.
+
+    @param[in]
+        path
+            pointer to the NUL terminated absolute path of the file
+
+    @param[in]
+        cb
+            callback to invoke when the file changes
+
+    @param[in]
+        arg
+            opaque argument passed to the callback
+
+    @retval EOK - the dependency was registered
+    @retval EINVAL - invalid arguments
+    @retval ENOMEM - memory allocation failed
+    @retval other - error code from inotify_add_watch
+
+============================================================================*/
+int WATCH_Add( const char *path, WatchCallback cb, void *arg )
+{
+    int result = EINVAL;
+    WatchEntry *pEntry;
+    char dir[PATH_MAX];
+    char *pDir;
+    struct stat sb;
+    bool isdir;
+    int wd;
+
+    if( ( path != NULL ) &&
+        ( cb != NULL ) &&
+        ( watchfd != -1 ) &&
+        ( strlen( path ) < sizeof( dir ) ) )
+    {
+        /* dirname may modify its argument so work on a copy */
+        strcpy( dir, path );
+
+        isdir = ( stat( path, &sb ) == 0 ) && S_ISDIR( sb.st_mode );
+
+        /* inotify returns the existing descriptor if the directory
+           is already being watched */
+        pDir = isdir ? dir : dirname( dir );
+        wd = inotify_add_watch( watchfd, pDir, WATCH_EVENTS );
+        if( wd == -1 )
+        {
+            result = errno;
+            syslog( LOG_ERR, "Unable to watch %s: %s\n", path, strerror( result ) );
+        }
+        else
+        {
+            result = ENOMEM;
+
+            pEntry = calloc( 1, sizeof( WatchEntry ) );
+            if( pEntry != NULL )
+            {
+                pEntry->pPath = strdup( path );
+                pEntry->pDir = strdup( pDir );
+                if( ( pEntry->pPath != NULL ) &&
+                    ( pEntry->pDir != NULL ) )
+                {
+                    pEntry->pName = strrchr( pEntry->pPath, '/' );
+                    pEntry->pName = ( pEntry->pName != NULL ) ? pEntry->pName + 1
+                                                              : pEntry->pPath;
+                    if( isdir == true )
+                    {
+                        pEntry->pName = NULL;
+                    }
+                    pEntry->wd = wd;
+                    pEntry->cb = cb;
+                    pEntry->arg = arg;
+
+                    pEntry->pNext = pWatchList;
+                    pWatchList = pEntry;
+
+                    result = EOK;
+                }
+                else
+                {
+                    free( pEntry->pPath );
+                    free( pEntry->pDir );
+                    free( pEntry );
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  WATCH_Remove                                                            */
+/*!
+    Remove file dependencies
+
+    The WATCH_Remove function removes every file dependency which was
+    registered with the specified callback argument.  A directory watch
+    is removed once no remaining dependency uses it.
+
+    @param[in]
+        arg
+            opaque argument the dependencies were registered with
+
+    @retval EOK - the dependencies were removed
+    @retval ENOENT - no dependency was registered with the argument
+
+============================================================================*/
+int WATCH_Remove( void *arg )
+{
+    int result = ENOENT;
+    WatchEntry **ppEntry = &pWatchList;
+    WatchEntry *pEntry;
+    WatchEntry *p;
+    bool inuse;
+
+    while( *ppEntry != NULL )
+    {
+        pEntry = *ppEntry;
+        if( pEntry->arg == arg )
+        {
+            /* unlink the entry */
+            *ppEntry = pEntry->pNext;
+
+            /* check if another entry is watching the same directory */
+            inuse = ( pEntry->wd == -1 );
+            for( p = pWatchList; p != NULL; p = p->pNext )
+            {
+                if( p->wd == pEntry->wd )
+                {
+                    inuse = true;
+                    break;
+                }
+            }
+
+            if( inuse == false )
+            {
+                inotify_rm_watch( watchfd, pEntry->wd );
+            }
+
+            free( pEntry->pPath );
+            free( pEntry->pDir );
+            free( pEntry );
+            result = EOK;
+        }
+        else
+        {
+            ppEntry = &pEntry->pNext;
+        }
+    }
+
+    return result;
+}
+
+/*==========================================================================*/
+/*  WATCH_Process                                                           */
+/*!
+    Process pending file change events
+
+    The WATCH_Process function drains all pending inotify events without
+    blocking, and invokes the callback of every dependency affected by them.
+    Events on the watched directory itself (deletion, move, or an inotify
+    queue overflow) invoke every callback on that directory.  Watches
+    which the kernel dropped are added again once their directories
+    exist, and the callbacks of their dependencies are invoked until
+    then.
+
+    @retval EOK - pending events were processed
+    @retval EINVAL - the watcher is not initialized
+
+============================================================================*/
+int WATCH_Process( void )
+{
+    int result = EINVAL;
+    char buf[4096] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+    const struct inotify_event *event;
+    WatchEntry *pEntry;
+    ssize_t len;
+    char *p;
+    bool all;
+
+    if( watchfd != -1 )
+    {
+        result = EOK;
+
+        while( ( len = read( watchfd, buf, sizeof( buf ) ) ) > 0 )
+        {
+            for( p = buf; p < buf + len; p += sizeof( *event ) + event->len )
+            {
+                event = (const struct inotify_event *)p;
+
+                all = ( event->len == 0 ) ||
+                      ( event->mask & IN_Q_OVERFLOW );
+
+                for( pEntry = pWatchList; pEntry != NULL; pEntry = pEntry->pNext )
+                {
+                    if( ( event->mask & IN_Q_OVERFLOW ) ||
+                        ( ( pEntry->wd == event->wd ) &&
+                          ( all ||
+                            ( pEntry->pName == NULL ) ||
+                            ( strcmp( pEntry->pName, event->name ) == 0 ) ) ) )
+                    {
+                        pEntry->cb( pEntry->pPath, pEntry->arg );
+                    }
+                }
+
+                if( event->mask & IN_MOVE_SELF )
+                {
+                    /* the watch follows the directory to its new name */
+                    inotify_rm_watch( watchfd, event->wd );
+                    LoseWatch( event->wd );
+                }
+                else if( event->mask & IN_IGNORED )
+                {
+                    /* the kernel dropped the watch */
+                    LoseWatch( event->wd );
+                }
+            }
+        }
+
+        RestoreWatches();
+    }
+
+    return result;
+}
+
+/*============================================================================
+        Private function definitions
+============================================================================*/
+
+/*==========================================================================*/
+/*  LoseWatch                                                               */
+/*!
+    Mark a directory watch as lost
+
+    The LoseWatch function marks the dependencies which use a directory
+    watch that no longer exists, so the watch is added again later.
+
+    @param[in]
+        wd
+            inotify watch descriptor which was lost
+
+    @return none
+
+============================================================================*/
+static void LoseWatch( int wd )
+{
+    WatchEntry *pEntry;
+
+    for( pEntry = pWatchList; pEntry != NULL; pEntry = pEntry->pNext )
+    {
+        if( pEntry->wd == wd )
+        {
+            pEntry->wd = -1;
+        }
+    }
+}
+
+/*==========================================================================*/
+/*  RestoreWatches                                                          */
+/*!
+    Add lost directory watches again
+
+    The RestoreWatches function adds the watches of the dependencies
+    whose directory watch was lost, if their directories exist again.
+    The callback of each such dependency is invoked, since its file may
+    have changed while it was not watched.
+
+    @return none
+
+============================================================================*/
+static void RestoreWatches( void )
+{
+    WatchEntry *pEntry;
+
+    for( pEntry = pWatchList; pEntry != NULL; pEntry = pEntry->pNext )
+    {
+        if( pEntry->wd == -1 )
+        {
+            /* inotify returns the existing descriptor if another lost
+               dependency on the directory was restored already */
+            pEntry->wd = inotify_add_watch( watchfd,
+                                            pEntry->pDir,
+                                            WATCH_EVENTS );
+            pEntry->cb( pEntry->pPath, pEntry->arg );
+        }
+    }
+}
+
+/*! @}
+ * end of watch group */